@@ -19,6 +19,8 @@
 
 #include "request-config.h"
 #include "request-window.h"
+#include "request-runner.h"
+#include "request-cache.h"
 
 static void on_activate (GtkApplication * app) {
     GtkWindow * window;
@@ -42,9 +44,19 @@ int main (int argc, char * argv[]) {
     bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
     textdomain (GETTEXT_PACKAGE);
 
+    // Headless mode, GTK must not be initialized
+    if (request_runner_is_requested (argc, argv)) {
+        ret = request_runner_main (argc, argv);
+        request_cache_flush ();
+
+        return ret;
+    }
+
     app = gtk_application_new ("com.github.guillotjulien.request", G_APPLICATION_FLAGS_NONE);
     g_signal_connect (app, "activate", G_CALLBACK (on_activate), NULL);
     ret = g_application_run (G_APPLICATION (app), argc, argv);
 
+    request_cache_flush ();
+
     return ret;
 }
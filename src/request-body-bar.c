@@ -0,0 +1,196 @@
+/* request-body-bar.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtk-4.0/gtk/gtk.h>
+#include <libsoup/soup.h>
+
+#include "request-body-bar.h"
+#include "request-format.h"
+#include "request-upload.h"
+
+/**
+ * Chooses where the request body comes from: the text typed in the request
+ * view, a file sent as is, which is never loaded in the view, or form fields.
+ */
+struct _RequestBodyBar {
+    GtkBox parent_instance;
+
+    /* Template widgets */
+    GtkComboBoxText * source_selector;
+    GtkButton * file_button;
+    GtkLabel * file_label;
+    GtkComboBoxText * framing_selector;
+
+    gchar * path;
+    GtkFileChooserNative * chooser;
+};
+
+G_DEFINE_TYPE (RequestBodyBar, request_body_bar, GTK_TYPE_BOX);
+
+static void request_body_bar_set_path (RequestBodyBar * self, gchar * path) {
+    g_free (self->path);
+    self->path = path;
+
+    GFile * file = g_file_new_for_path (path);
+    GFileInfo * info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    gchar * basename = g_file_get_basename (file);
+
+    if (info != NULL) {
+        gchar * size = request_format_size (g_file_info_get_size (info));
+        gchar * text = g_strdup_printf ("%s (%s)", basename, size);
+
+        gtk_label_set_text (self->file_label, text);
+
+        g_free (text);
+        g_free (size);
+        g_object_unref (info);
+    } else {
+        gtk_label_set_text (self->file_label, basename);
+    }
+
+    gtk_widget_set_tooltip_text (GTK_WIDGET (self->file_label), path);
+
+    g_free (basename);
+    g_object_unref (file);
+}
+
+static void request_body_bar_on_file_chosen (GtkNativeDialog * dialog, gint response, gpointer data) {
+    RequestBodyBar * self = data;
+    g_return_if_fail (self != NULL);
+
+    if (response == GTK_RESPONSE_ACCEPT) {
+        GFile * file = gtk_file_chooser_get_file (GTK_FILE_CHOOSER (dialog));
+        gchar * path = g_file_get_path (file);
+
+        if (path != NULL) {
+            request_body_bar_set_path (self, path);
+        }
+
+        g_object_unref (file);
+    }
+
+    g_clear_object (&self->chooser);
+}
+
+static void request_body_bar_on_choose_file (GtkButton * button, gpointer data) {
+    (void) button;
+    RequestBodyBar * self = data;
+    g_return_if_fail (self != NULL);
+
+    if (self->chooser != NULL) {
+        return;
+    }
+
+    GtkRoot * root = gtk_widget_get_root (GTK_WIDGET (self));
+
+    // FIXME: Handle translations
+    self->chooser = gtk_file_chooser_native_new ("Request body", GTK_IS_WINDOW (root) ? GTK_WINDOW (root) : NULL, GTK_FILE_CHOOSER_ACTION_OPEN, "_Open", "_Cancel");
+    g_signal_connect (self->chooser, "response", G_CALLBACK (request_body_bar_on_file_chosen), self);
+
+    gtk_native_dialog_show (GTK_NATIVE_DIALOG (self->chooser));
+}
+
+static void request_body_bar_on_source_changed (GtkComboBox * widget, gpointer data) {
+    (void) widget;
+    RequestBodyBar * self = data;
+    g_return_if_fail (self != NULL);
+
+    gboolean is_file = request_body_bar_get_source (self) == BODY_SOURCE_FILE;
+
+    gtk_widget_set_visible (GTK_WIDGET (self->file_button), is_file);
+    gtk_widget_set_visible (GTK_WIDGET (self->file_label), is_file);
+    gtk_widget_set_visible (GTK_WIDGET (self->framing_selector), is_file);
+
+    g_signal_emit_by_name (self, BODY_SOURCE_CHANGED_SIGNAL);
+}
+
+static void request_body_bar_dispose (GObject * object) {
+    RequestBodyBar * self = REQUEST_BODY_BAR (object);
+
+    if (self->chooser != NULL) {
+        gtk_native_dialog_destroy (GTK_NATIVE_DIALOG (self->chooser));
+        g_clear_object (&self->chooser);
+    }
+
+    g_clear_pointer (&self->path, g_free);
+
+    G_OBJECT_CLASS (request_body_bar_parent_class)->dispose (object);
+}
+
+static void request_body_bar_class_init (RequestBodyBarClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
+    GtkWidgetClass * widget_class = GTK_WIDGET_CLASS (klass);
+
+    object_class->dispose = request_body_bar_dispose;
+
+    gtk_widget_class_set_template_from_resource (widget_class, "/com/github/guillotjulien/request/resources/ui/request-body-bar.ui");
+    gtk_widget_class_bind_template_child (widget_class, RequestBodyBar, source_selector);
+    gtk_widget_class_bind_template_child (widget_class, RequestBodyBar, file_button);
+    gtk_widget_class_bind_template_child (widget_class, RequestBodyBar, file_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestBodyBar, framing_selector);
+
+    // Declare our own signals
+    g_signal_new (BODY_SOURCE_CHANGED_SIGNAL, REQUEST_TYPE_BODY_BAR, G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+}
+
+static void request_body_bar_init (RequestBodyBar * self) {
+    gtk_widget_init_template (GTK_WIDGET (self));
+
+    g_return_if_fail (GTK_IS_WIDGET (self->source_selector));
+    g_return_if_fail (GTK_IS_WIDGET (self->file_button));
+    g_return_if_fail (GTK_IS_WIDGET (self->file_label));
+    g_return_if_fail (GTK_IS_WIDGET (self->framing_selector));
+
+    g_signal_connect (self->source_selector, "changed", G_CALLBACK (request_body_bar_on_source_changed), self);
+    g_signal_connect (self->file_button, "clicked", G_CALLBACK (request_body_bar_on_choose_file), self);
+}
+
+RequestBodyBar * request_body_bar_new (void) {
+    return g_object_new (REQUEST_TYPE_BODY_BAR, NULL);
+}
+
+RequestBodySource request_body_bar_get_source (RequestBodyBar * self) {
+    g_return_val_if_fail (REQUEST_IS_BODY_BAR (self), BODY_SOURCE_TEXT);
+
+    const gchar * source = gtk_combo_box_get_active_id (GTK_COMBO_BOX (self->source_selector));
+    if (g_strcmp0 (source, "file") == 0) {
+        return BODY_SOURCE_FILE;
+    }
+
+    if (g_strcmp0 (source, "form") == 0) {
+        return BODY_SOURCE_FORM;
+    }
+
+    return BODY_SOURCE_TEXT;
+}
+
+/**
+ * Sets the chosen file as the body of msg, with the chosen framing. Fails when
+ * no file was chosen or when it cannot be read.
+ */
+gboolean request_body_bar_attach_file (RequestBodyBar * self, SoupMessage * msg, GError ** error) {
+    g_return_val_if_fail (REQUEST_IS_BODY_BAR (self), FALSE);
+
+    if (self->path == NULL) {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No file chosen for the request body"); // FIXME: Handle translations
+        return FALSE;
+    }
+
+    gboolean is_chunked = g_strcmp0 (gtk_combo_box_get_active_id (GTK_COMBO_BOX (self->framing_selector)), "chunked") == 0;
+
+    return request_upload_set_file (msg, self->path, is_chunked ? UPLOAD_FRAMING_CHUNKED : UPLOAD_FRAMING_CONTENT_LENGTH, error);
+}
@@ -0,0 +1,41 @@
+/* request-body-bar.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gtk-4.0/gtk/gtk.h>
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+#define REQUEST_TYPE_BODY_BAR (request_body_bar_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestBodyBar, request_body_bar, REQUEST, BODY_BAR, GtkBox)
+
+#define BODY_SOURCE_CHANGED_SIGNAL "source-changed"
+
+typedef enum RequestBodySource {
+    BODY_SOURCE_TEXT, // typed in the request view
+    BODY_SOURCE_FILE, // sent as is
+    BODY_SOURCE_FORM, // multipart/form-data from the form rows
+} RequestBodySource;
+
+RequestBodyBar * request_body_bar_new (void);
+RequestBodySource request_body_bar_get_source (RequestBodyBar * self);
+gboolean request_body_bar_attach_file (RequestBodyBar * self, SoupMessage * msg, GError ** error);
+
+G_END_DECLS
@@ -0,0 +1,384 @@
+/* request-body-decoder.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "request-body-decoder.h"
+
+// GtkTextBuffer only accepts valid UTF-8 without NUL characters, they are
+// replaced by these symbols.
+#define REPLACEMENT_CHARACTER "\xEF\xBF\xBD" // U+FFFD
+#define NUL_SYMBOL "\xE2\x90\x80" // U+2400
+
+/**
+ * Converts response bodies to UTF-8 text, chunk by chunk, as they stream in.
+ *
+ * UTF-8 bodies are validated in place, any other charset goes through a
+ * GCharsetConverter. A character split across two chunks is kept in pending
+ * until the next chunk completes it.
+ */
+struct _RequestBodyDecoder {
+    gchar * charset;
+    gboolean is_sniffed;
+    GConverter * converter;
+    GByteArray * pending;
+    GByteArray * converted;
+};
+
+/**
+ * Returns the charset parameter of the Content-Type header, or NULL when there
+ * is none.
+ */
+gchar * request_body_decoder_get_charset_from_headers (SoupMessageHeaders * headers) {
+    GHashTable * params = NULL;
+    gchar * charset = NULL;
+
+    g_return_val_if_fail (headers != NULL, NULL);
+
+    if (soup_message_headers_get_content_type (headers, &params) == NULL) {
+        return NULL;
+    }
+
+    const gchar * value = g_hash_table_lookup (params, "charset");
+    if (value != NULL && *value != '\0') {
+        charset = g_strdup (value);
+    }
+
+    g_hash_table_destroy (params);
+
+    return charset;
+}
+
+static gboolean request_body_decoder_is_utf8 (const gchar * charset) {
+    return g_ascii_strcasecmp (charset, "UTF-8") == 0 || g_ascii_strcasecmp (charset, "UTF8") == 0;
+}
+
+static void request_body_decoder_set_charset (RequestBodyDecoder * self, const gchar * charset) {
+    GError * error = NULL;
+
+    g_free (self->charset);
+    g_clear_object (&self->converter);
+    self->charset = g_strdup (charset);
+
+    if (request_body_decoder_is_utf8 (charset)) {
+        return;
+    }
+
+    GCharsetConverter * converter = g_charset_converter_new ("UTF-8", charset, &error);
+    if (converter == NULL) {
+        g_info ("Unsupported charset %s, decoding as UTF-8: %s\n", charset, error->message);
+        g_error_free (error);
+
+        g_free (self->charset);
+        self->charset = g_strdup ("UTF-8");
+        return;
+    }
+
+    // Bytes that are invalid in charset come out escaped instead of failing
+    g_charset_converter_set_use_fallback (converter, TRUE);
+    self->converter = G_CONVERTER (converter);
+}
+
+/**
+ * charset is the one announced by the server, when NULL it is sniffed from the
+ * byte order mark of the body and defaults to UTF-8.
+ */
+RequestBodyDecoder * request_body_decoder_new (const gchar * charset) {
+    RequestBodyDecoder * self = g_new0 (RequestBodyDecoder, 1);
+
+    self->pending = g_byte_array_new ();
+    self->converted = g_byte_array_new ();
+    self->is_sniffed = charset != NULL;
+
+    request_body_decoder_set_charset (self, charset != NULL ? charset : "UTF-8");
+
+    return self;
+}
+
+void request_body_decoder_free (RequestBodyDecoder * self) {
+    if (self == NULL) {
+        return;
+    }
+
+    g_clear_object (&self->converter);
+    g_byte_array_unref (self->pending);
+    g_byte_array_unref (self->converted);
+    g_free (self->charset);
+    g_free (self);
+}
+
+const gchar * request_body_decoder_get_charset (RequestBodyDecoder * self) {
+    g_return_val_if_fail (self != NULL, NULL);
+
+    return self->charset;
+}
+
+/**
+ * Appends valid UTF-8 text to output, replacing NUL characters.
+ */
+static void request_body_decoder_append_text (GString * output, const gchar * text, gsize length) {
+    const gchar * end = text + length;
+
+    while (text < end) {
+        const gchar * nul = memchr (text, '\0', end - text);
+        if (nul == NULL) {
+            g_string_append_len (output, text, end - text);
+            return;
+        }
+
+        g_string_append_len (output, text, nul - text);
+        g_string_append (output, NUL_SYMBOL);
+        text = nul + 1;
+    }
+}
+
+static gsize request_body_decoder_get_sequence_length (guint8 lead) {
+    if (lead < 0x80)
+        return 1;
+    if ((lead & 0xE0) == 0xC0)
+        return 2;
+    if ((lead & 0xF0) == 0xE0)
+        return 3;
+    if ((lead & 0xF8) == 0xF0)
+        return 4;
+
+    return 0;
+}
+
+/**
+ * Returns whether data holds the beginning of a multibyte sequence that the
+ * next chunk may complete.
+ */
+static gboolean request_body_decoder_is_truncated_sequence (const guint8 * data, gsize length) {
+    gsize sequence_length = request_body_decoder_get_sequence_length (data[0]);
+    if (sequence_length <= length) {
+        return FALSE;
+    }
+
+    for (gsize i = 1; i < length; i++) {
+        if ((data[i] & 0xC0) != 0x80) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * Appends the UTF-8 text of data to output, invalid bytes are replaced by
+ * U+FFFD. Returns the number of bytes consumed, which is less than length only
+ * when data ends with a truncated sequence and more data is expected.
+ */
+static gsize request_body_decoder_decode_utf8 (GString * output, const guint8 * data, gsize length, gboolean is_last) {
+    gsize offset = 0;
+
+    while (offset < length) {
+        const gchar * valid_end;
+
+        // Stops on the first invalid byte, NUL included
+        g_utf8_validate_len ((const gchar *) data + offset, length - offset, &valid_end);
+
+        gsize valid_length = (const guint8 *) valid_end - (data + offset);
+        request_body_decoder_append_text (output, (const gchar *) data + offset, valid_length);
+        offset += valid_length;
+
+        if (offset == length) {
+            break;
+        }
+
+        if (data[offset] == '\0') {
+            g_string_append (output, NUL_SYMBOL);
+        } else if (!is_last && request_body_decoder_is_truncated_sequence (data + offset, length - offset)) {
+            break;
+        } else {
+            g_string_append (output, REPLACEMENT_CHARACTER);
+        }
+
+        offset++;
+    }
+
+    return offset;
+}
+
+/**
+ * Runs data through converter, appending what it produces to output.
+ * bytes_consumed is set to the number of bytes of data actually converted,
+ * the rest is a truncated unit the converter needs more input to handle.
+ *
+ * Converters are stateful, the same converter must be fed every chunk in order
+ * with is_last set on the final one.
+ */
+gboolean request_body_decoder_convert (GConverter * converter, const guint8 * data, gsize length, gboolean is_last, GByteArray * output, gsize * bytes_consumed, GError ** error) {
+    GConverterFlags flags = is_last ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS;
+    gsize offset = 0;
+    gsize buffer_size = MAX (length * 2, (gsize) 4096);
+
+    g_return_val_if_fail (G_IS_CONVERTER (converter), FALSE);
+
+    for (;;) {
+        GError * local_error = NULL;
+        gsize bytes_read = 0;
+        gsize bytes_written = 0;
+        guint output_length = output->len;
+
+        g_byte_array_set_size (output, output_length + buffer_size);
+
+        GConverterResult result = g_converter_convert (converter, data + offset, length - offset, output->data + output_length, buffer_size, flags, &bytes_read, &bytes_written, &local_error);
+
+        g_byte_array_set_size (output, output_length + bytes_written);
+        offset += bytes_read;
+
+        if (result == G_CONVERTER_ERROR) {
+            if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NO_SPACE)) {
+                g_error_free (local_error);
+                buffer_size *= 2;
+                continue;
+            }
+
+            if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT) && !is_last) {
+                g_error_free (local_error);
+                break;
+            }
+
+            g_propagate_error (error, local_error);
+            if (bytes_consumed != NULL) {
+                *bytes_consumed = offset;
+            }
+
+            return FALSE;
+        }
+
+        if (result == G_CONVERTER_FINISHED) {
+            break;
+        }
+
+        // Without more input the converter cannot make progress
+        if (bytes_read == 0 && bytes_written == 0) {
+            break;
+        }
+
+        if (!is_last && offset == length) {
+            break;
+        }
+    }
+
+    if (bytes_consumed != NULL) {
+        *bytes_consumed = offset;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Picks the charset from the byte order mark when the server did not announce
+ * one, and skips the mark itself. Returns the number of bytes to skip.
+ */
+static gsize request_body_decoder_sniff (RequestBodyDecoder * self, const guint8 * data, gsize length) {
+    self->is_sniffed = TRUE;
+
+    if (length >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+        return 3;
+    }
+
+    if (length >= 2 && data[0] == 0xFF && data[1] == 0xFE) {
+        request_body_decoder_set_charset (self, "UTF-16LE");
+        return 2;
+    }
+
+    if (length >= 2 && data[0] == 0xFE && data[1] == 0xFF) {
+        request_body_decoder_set_charset (self, "UTF-16BE");
+        return 2;
+    }
+
+    return 0;
+}
+
+static void request_body_decoder_decode_converted (RequestBodyDecoder * self, const guint8 * data, gsize length, gboolean is_last, GString * output) {
+    GError * error = NULL;
+    gsize consumed = 0;
+
+    g_byte_array_set_size (self->converted, 0);
+
+    if (!request_body_decoder_convert (self->converter, data, length, is_last, self->converted, &consumed, &error)) {
+        g_info ("Cannot decode body as %s, falling back to UTF-8: %s\n", self->charset, error->message);
+        g_error_free (error);
+
+        request_body_decoder_append_text (output, (const gchar *) self->converted->data, self->converted->len);
+        request_body_decoder_set_charset (self, "UTF-8");
+
+        consumed += request_body_decoder_decode_utf8 (output, data + consumed, length - consumed, is_last);
+        g_byte_array_append (self->pending, data + consumed, length - consumed);
+        return;
+    }
+
+    // Converted text is valid UTF-8, only NUL characters need to go
+    request_body_decoder_append_text (output, (const gchar *) self->converted->data, self->converted->len);
+    g_byte_array_append (self->pending, data + consumed, length - consumed);
+}
+
+/**
+ * Decodes the next chunk of the body and appends its text to output. Call it
+ * one last time with is_last set once the body is complete, to flush what the
+ * decoder still holds.
+ */
+void request_body_decoder_decode (RequestBodyDecoder * self, const guint8 * data, gsize length, gboolean is_last, GString * output) {
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (output != NULL);
+
+    if (!self->is_sniffed && length > 0) {
+        gsize skipped = request_body_decoder_sniff (self, data, length);
+        data += skipped;
+        length -= skipped;
+    }
+
+    if (self->converter != NULL) {
+        // The converter needs the truncated unit and the rest in one piece
+        if (self->pending->len > 0) {
+            GByteArray * pending = self->pending;
+            self->pending = g_byte_array_new ();
+
+            g_byte_array_append (pending, data, length);
+            request_body_decoder_decode_converted (self, pending->data, pending->len, is_last, output);
+            g_byte_array_unref (pending);
+            return;
+        }
+
+        request_body_decoder_decode_converted (self, data, length, is_last, output);
+        return;
+    }
+
+    if (self->pending->len > 0) {
+        // Complete the truncated sequence with the first bytes of this chunk,
+        // without copying the whole chunk.
+        gsize sequence_length = request_body_decoder_get_sequence_length (self->pending->data[0]);
+        gsize missing = MIN (sequence_length - self->pending->len, length);
+
+        g_byte_array_append (self->pending, data, missing);
+        data += missing;
+        length -= missing;
+
+        if (self->pending->len < sequence_length && !is_last) {
+            return;
+        }
+
+        request_body_decoder_decode_utf8 (output, self->pending->data, self->pending->len, TRUE);
+        g_byte_array_set_size (self->pending, 0);
+    }
+
+    gsize consumed = request_body_decoder_decode_utf8 (output, data, length, is_last);
+    g_byte_array_append (self->pending, data + consumed, length - consumed);
+}
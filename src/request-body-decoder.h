@@ -0,0 +1,34 @@
+/* request-body-decoder.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+typedef struct _RequestBodyDecoder RequestBodyDecoder;
+
+gchar * request_body_decoder_get_charset_from_headers (SoupMessageHeaders * headers);
+RequestBodyDecoder * request_body_decoder_new (const gchar * charset);
+void request_body_decoder_free (RequestBodyDecoder * self);
+const gchar * request_body_decoder_get_charset (RequestBodyDecoder * self);
+void request_body_decoder_decode (RequestBodyDecoder * self, const guint8 * data, gsize length, gboolean is_last, GString * output);
+gboolean request_body_decoder_convert (GConverter * converter, const guint8 * data, gsize length, gboolean is_last, GByteArray * output, gsize * bytes_consumed, GError ** error);
+
+G_END_DECLS
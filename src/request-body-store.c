@@ -0,0 +1,210 @@
+/* request-body-store.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "request-body-store.h"
+#include "request-settings.h"
+
+#define DEFAULT_MEMORY_BUDGET 64 // MB
+
+/**
+ * Holds a response body. Up to memory_budget bytes are kept in memory, past
+ * that the body is spooled to an unlinked temporary file and read back by
+ * mapping it, so huge bodies only cost page cache.
+ */
+struct _RequestBodyStore {
+    GObject parent_instance;
+
+    gsize memory_budget;
+    goffset length;
+    gboolean is_closed;
+
+    /* In memory */
+    GByteArray * data;
+    GBytes * bytes;
+
+    /* Spooled */
+    gint fd;
+};
+
+G_DEFINE_TYPE (RequestBodyStore, request_body_store, G_TYPE_OBJECT);
+
+static void request_body_store_finalize (GObject * object) {
+    RequestBodyStore * self = REQUEST_BODY_STORE (object);
+
+    g_clear_pointer (&self->data, g_byte_array_unref);
+    g_clear_pointer (&self->bytes, g_bytes_unref);
+
+    if (self->fd != -1) {
+        close (self->fd); // the file is already unlinked, this releases it
+    }
+
+    G_OBJECT_CLASS (request_body_store_parent_class)->finalize (object);
+}
+
+static void request_body_store_class_init (RequestBodyStoreClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = request_body_store_finalize;
+}
+
+static void request_body_store_init (RequestBodyStore * self) {
+    self->data = g_byte_array_new ();
+    self->fd = -1;
+}
+
+RequestBodyStore * request_body_store_new (gsize memory_budget) {
+    RequestBodyStore * self = g_object_new (REQUEST_TYPE_BODY_STORE, NULL);
+    self->memory_budget = memory_budget;
+
+    return self;
+}
+
+/**
+ * Creates a store using the memory budget from the settings.
+ */
+RequestBodyStore * request_body_store_new_default (void) {
+    gint budget = request_settings_get_int ("body-memory-budget", DEFAULT_MEMORY_BUDGET);
+
+    return request_body_store_new ((gsize) MAX (budget, 1) * 1024 * 1024);
+}
+
+static gboolean request_body_store_write (RequestBodyStore * self, const guint8 * data, gsize length, GError ** error) {
+    while (length > 0) {
+        ssize_t written = write (self->fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+
+            int saved_errno = errno;
+            g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno), "Cannot spool body: %s", g_strerror (saved_errno));
+            return FALSE;
+        }
+
+        data += written;
+        length -= written;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Moves what was kept in memory so far to a temporary file.
+ */
+static gboolean request_body_store_spool (RequestBodyStore * self, GError ** error) {
+    gchar * path = NULL;
+
+    self->fd = g_file_open_tmp ("request-body-XXXXXX", &path, error);
+    if (self->fd == -1) {
+        return FALSE;
+    }
+
+    // Nobody else needs to see the file, it vanishes once we close it, even if
+    // we crash.
+    g_unlink (path);
+    g_free (path);
+
+    if (!request_body_store_write (self, self->data->data, self->data->len, error)) {
+        return FALSE;
+    }
+
+    g_clear_pointer (&self->data, g_byte_array_unref);
+
+    return TRUE;
+}
+
+gboolean request_body_store_append (RequestBodyStore * self, const guint8 * data, gsize length, GError ** error) {
+    g_return_val_if_fail (REQUEST_IS_BODY_STORE (self), FALSE);
+    g_return_val_if_fail (!self->is_closed, FALSE);
+
+    if (self->fd == -1 && self->data->len + length > self->memory_budget) {
+        if (!request_body_store_spool (self, error)) {
+            return FALSE;
+        }
+    }
+
+    if (self->fd != -1) {
+        if (!request_body_store_write (self, data, length, error)) {
+            return FALSE;
+        }
+    } else {
+        g_byte_array_append (self->data, data, length);
+    }
+
+    self->length += length;
+
+    return TRUE;
+}
+
+/**
+ * Marks the body as complete, no more data can be appended.
+ */
+void request_body_store_close (RequestBodyStore * self) {
+    g_return_if_fail (REQUEST_IS_BODY_STORE (self));
+
+    if (self->is_closed) {
+        return;
+    }
+
+    self->is_closed = TRUE;
+
+    if (self->data != NULL) {
+        self->bytes = g_byte_array_free_to_bytes (self->data);
+        self->data = NULL;
+    }
+}
+
+goffset request_body_store_get_length (RequestBodyStore * self) {
+    g_return_val_if_fail (REQUEST_IS_BODY_STORE (self), 0);
+
+    return self->length;
+}
+
+gboolean request_body_store_is_spooled (RequestBodyStore * self) {
+    g_return_val_if_fail (REQUEST_IS_BODY_STORE (self), FALSE);
+
+    return self->fd != -1;
+}
+
+/**
+ * Returns the body received so far. A spooled body is mapped rather than read,
+ * pages are only loaded when they are accessed.
+ */
+GBytes * request_body_store_get_bytes (RequestBodyStore * self, GError ** error) {
+    g_return_val_if_fail (REQUEST_IS_BODY_STORE (self), NULL);
+
+    if (self->fd != -1) {
+        GMappedFile * mapped_file = g_mapped_file_new_from_fd (self->fd, FALSE, error);
+        if (mapped_file == NULL) {
+            return NULL;
+        }
+
+        GBytes * bytes = g_mapped_file_get_bytes (mapped_file);
+        g_mapped_file_unref (mapped_file);
+
+        return bytes;
+    }
+
+    if (self->bytes != NULL) {
+        return g_bytes_ref (self->bytes);
+    }
+
+    return g_bytes_new (self->data->data, self->data->len);
+}
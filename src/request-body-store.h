@@ -0,0 +1,36 @@
+/* request-body-store.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define REQUEST_TYPE_BODY_STORE (request_body_store_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestBodyStore, request_body_store, REQUEST, BODY_STORE, GObject)
+
+RequestBodyStore * request_body_store_new (gsize memory_budget);
+RequestBodyStore * request_body_store_new_default (void);
+gboolean request_body_store_append (RequestBodyStore * self, const guint8 * data, gsize length, GError ** error);
+void request_body_store_close (RequestBodyStore * self);
+goffset request_body_store_get_length (RequestBodyStore * self);
+gboolean request_body_store_is_spooled (RequestBodyStore * self);
+GBytes * request_body_store_get_bytes (RequestBodyStore * self, GError ** error);
+
+G_END_DECLS
@@ -0,0 +1,113 @@
+/* request-brotli-decompressor.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gio/gio.h>
+
+#include "request-brotli-decompressor.h"
+
+#if HAVE_BROTLI
+
+#include <brotli/decode.h>
+
+/**
+ * GConverter over libbrotlidec, GIO only ships zlib decompressors.
+ */
+struct _RequestBrotliDecompressor {
+    GObject parent_instance;
+
+    BrotliDecoderState * state;
+};
+
+static void request_brotli_decompressor_converter_init (GConverterIface * iface);
+
+G_DEFINE_TYPE_WITH_CODE (RequestBrotliDecompressor, request_brotli_decompressor, G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (G_TYPE_CONVERTER, request_brotli_decompressor_converter_init));
+
+static GConverterResult request_brotli_decompressor_convert (GConverter * converter, const void * inbuf, gsize inbuf_size, void * outbuf, gsize outbuf_size, GConverterFlags flags, gsize * bytes_read, gsize * bytes_written, GError ** error) {
+    RequestBrotliDecompressor * self = REQUEST_BROTLI_DECOMPRESSOR (converter);
+
+    if (self->state == NULL) {
+        self->state = BrotliDecoderCreateInstance (NULL, NULL, NULL);
+    }
+
+    size_t available_in = inbuf_size;
+    const uint8_t * next_in = inbuf;
+    size_t available_out = outbuf_size;
+    uint8_t * next_out = outbuf;
+
+    BrotliDecoderResult result = BrotliDecoderDecompressStream (self->state, &available_in, &next_in, &available_out, &next_out, NULL);
+
+    *bytes_read = inbuf_size - available_in;
+    *bytes_written = outbuf_size - available_out;
+
+    switch (result) {
+        case BROTLI_DECODER_RESULT_SUCCESS:
+            return G_CONVERTER_FINISHED;
+        case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
+            if (*bytes_read == 0 && *bytes_written == 0) {
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, (flags & G_CONVERTER_INPUT_AT_END) ? "Truncated brotli stream" : "Need more input");
+                return G_CONVERTER_ERROR;
+            }
+
+            return G_CONVERTER_CONVERTED;
+        case BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT:
+            if (*bytes_written == 0) {
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE, "Need more output space");
+                return G_CONVERTER_ERROR;
+            }
+
+            return G_CONVERTER_CONVERTED;
+        default:
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Invalid brotli stream: %s", BrotliDecoderErrorString (BrotliDecoderGetErrorCode (self->state)));
+            return G_CONVERTER_ERROR;
+    }
+}
+
+static void request_brotli_decompressor_reset (GConverter * converter) {
+    RequestBrotliDecompressor * self = REQUEST_BROTLI_DECOMPRESSOR (converter);
+
+    g_clear_pointer (&self->state, BrotliDecoderDestroyInstance);
+}
+
+static void request_brotli_decompressor_converter_init (GConverterIface * iface) {
+    iface->convert = request_brotli_decompressor_convert;
+    iface->reset = request_brotli_decompressor_reset;
+}
+
+static void request_brotli_decompressor_finalize (GObject * object) {
+    RequestBrotliDecompressor * self = REQUEST_BROTLI_DECOMPRESSOR (object);
+
+    g_clear_pointer (&self->state, BrotliDecoderDestroyInstance);
+
+    G_OBJECT_CLASS (request_brotli_decompressor_parent_class)->finalize (object);
+}
+
+static void request_brotli_decompressor_class_init (RequestBrotliDecompressorClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = request_brotli_decompressor_finalize;
+}
+
+static void request_brotli_decompressor_init (RequestBrotliDecompressor * self) {
+    (void) self;
+}
+
+RequestBrotliDecompressor * request_brotli_decompressor_new (void) {
+    return g_object_new (REQUEST_TYPE_BROTLI_DECOMPRESSOR, NULL);
+}
+
+#endif
@@ -0,0 +1,36 @@
+/* request-brotli-decompressor.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "request-config.h"
+
+G_BEGIN_DECLS
+
+#if HAVE_BROTLI
+
+#define REQUEST_TYPE_BROTLI_DECOMPRESSOR (request_brotli_decompressor_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestBrotliDecompressor, request_brotli_decompressor, REQUEST, BROTLI_DECOMPRESSOR, GObject)
+
+RequestBrotliDecompressor * request_brotli_decompressor_new (void);
+
+#endif
+
+G_END_DECLS
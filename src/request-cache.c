@@ -0,0 +1,139 @@
+/* request-cache.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <libsoup/soup.h>
+
+#include "request-cache.h"
+#include "request-settings.h"
+#include "request-timings.h"
+
+#define DEFAULT_CACHE_SIZE 256 // MB
+
+static SoupCache * cache = NULL;
+
+// URI of the revalidated entries -> monotonic time of their last 304
+static GHashTable * revalidations = NULL;
+
+static void request_cache_on_conditional_got_headers (SoupMessage * msg, gpointer data) {
+    (void) data;
+
+    if (msg->status_code != SOUP_STATUS_NOT_MODIFIED) {
+        return;
+    }
+
+    gint64 * revalidated_at = g_new (gint64, 1);
+    *revalidated_at = g_get_monotonic_time ();
+
+    g_hash_table_insert (revalidations, soup_uri_to_string (soup_message_get_uri (msg), FALSE), revalidated_at);
+}
+
+/**
+ * SoupCache revalidates stale entries with a message of its own, the one sent
+ * by the user is then answered from the cache. Keep track of those conditional
+ * messages to tell revalidated responses apart from fresh ones.
+ */
+static void request_cache_on_request_queued (SoupSession * session, SoupMessage * msg, gpointer data) {
+    (void) session;
+    (void) data;
+
+    // Messages sent by the user have their timings attached before being queued
+    if (request_timings_get (msg) != NULL) {
+        return;
+    }
+
+    if (soup_message_headers_get_one (msg->request_headers, "If-None-Match") == NULL
+        && soup_message_headers_get_one (msg->request_headers, "If-Modified-Since") == NULL) {
+        return;
+    }
+
+    g_signal_connect (msg, "got-headers", G_CALLBACK (request_cache_on_conditional_got_headers), NULL);
+}
+
+/**
+ * Adds an HTTP cache stored in the user cache directory to session, when
+ * enabled in the settings. Cached entries are revalidated with
+ * If-None-Match/If-Modified-Since once stale.
+ */
+void request_cache_attach (SoupSession * session) {
+    g_return_if_fail (SOUP_IS_SESSION (session));
+
+    if (cache != NULL || !request_settings_get_boolean ("http-cache", FALSE)) {
+        return;
+    }
+
+    gchar * cache_dir = g_build_filename (g_get_user_cache_dir (), "request", "http", NULL);
+
+    cache = soup_cache_new (cache_dir, SOUP_CACHE_SINGLE_USER);
+    soup_cache_set_max_size (cache, (guint) MAX (request_settings_get_int ("http-cache-size", DEFAULT_CACHE_SIZE), 1) * 1024 * 1024);
+    soup_cache_load (cache);
+    soup_session_add_feature (session, SOUP_SESSION_FEATURE (cache));
+
+    revalidations = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    g_signal_connect (session, "request-queued", G_CALLBACK (request_cache_on_request_queued), NULL);
+
+    g_free (cache_dir);
+}
+
+/**
+ * Writes the cache index to disk so entries survive a restart.
+ */
+void request_cache_flush (void) {
+    if (cache != NULL) {
+        soup_cache_dump (cache);
+    }
+}
+
+gboolean request_cache_is_enabled (void) {
+    return cache != NULL;
+}
+
+/**
+ * Returns where the response of msg, sent through a RequestTransfer, came from.
+ */
+RequestCacheSource request_cache_get_source (SoupMessage * msg) {
+    g_return_val_if_fail (SOUP_IS_MESSAGE (msg), CACHE_SOURCE_NETWORK);
+
+    const RequestTimings * timings = request_timings_get (msg);
+
+    // A message answered from the cache never starts on a connection, a
+    // transport error can also happen before that though.
+    if (cache == NULL || timings == NULL || timings->sending != 0 || SOUP_STATUS_IS_TRANSPORT_ERROR (msg->status_code)) {
+        return CACHE_SOURCE_NETWORK;
+    }
+
+    gchar * uri = soup_uri_to_string (soup_message_get_uri (msg), FALSE);
+    gint64 * revalidated_at = g_hash_table_lookup (revalidations, uri);
+    g_free (uri);
+
+    if (revalidated_at != NULL && *revalidated_at >= timings->start) {
+        return CACHE_SOURCE_REVALIDATED;
+    }
+
+    return CACHE_SOURCE_CACHE;
+}
+
+const gchar * request_cache_get_source_name (RequestCacheSource source) {
+    // FIXME: Handle translations
+    switch (source) {
+        case CACHE_SOURCE_CACHE:
+            return "From cache";
+        case CACHE_SOURCE_REVALIDATED:
+            return "Revalidated (304)";
+        default:
+            return "Network";
+    }
+}
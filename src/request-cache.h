@@ -0,0 +1,36 @@
+/* request-cache.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+typedef enum RequestCacheSource {
+    CACHE_SOURCE_NETWORK, // full response from the server
+    CACHE_SOURCE_CACHE, // fresh cached response, nothing was sent
+    CACHE_SOURCE_REVALIDATED, // cached response confirmed by a 304
+} RequestCacheSource;
+
+void request_cache_attach (SoupSession * session);
+void request_cache_flush (void);
+gboolean request_cache_is_enabled (void);
+RequestCacheSource request_cache_get_source (SoupMessage * msg);
+const gchar * request_cache_get_source_name (RequestCacheSource source);
+
+G_END_DECLS
@@ -0,0 +1,200 @@
+/* request-content-decoder.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+
+#include "request-config.h"
+#include "request-content-decoder.h"
+#include "request-body-decoder.h"
+#include "request-brotli-decompressor.h"
+
+/**
+ * One coding of the Content-Encoding list, with the input it could not
+ * consume yet.
+ */
+typedef struct RequestContentDecoderStage {
+    GConverter * converter;
+    GByteArray * pending;
+    gboolean is_deflate;
+    gboolean has_output;
+} RequestContentDecoderStage;
+
+struct _RequestContentDecoder {
+    GPtrArray * stages; // in decoding order
+};
+
+/**
+ * Returns the Accept-Encoding value matching the codings that can be decoded.
+ */
+const gchar * request_content_decoder_get_accept_encoding (void) {
+#if HAVE_BROTLI
+    return "gzip, deflate, br";
+#else
+    return "gzip, deflate";
+#endif
+}
+
+static GConverter * request_content_decoder_create_converter (const gchar * coding, gboolean * is_deflate) {
+    *is_deflate = FALSE;
+
+    if (g_ascii_strcasecmp (coding, "gzip") == 0 || g_ascii_strcasecmp (coding, "x-gzip") == 0) {
+        return G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+    }
+
+    if (g_ascii_strcasecmp (coding, "deflate") == 0) {
+        *is_deflate = TRUE;
+        return G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB));
+    }
+
+#if HAVE_BROTLI
+    if (g_ascii_strcasecmp (coding, "br") == 0) {
+        return G_CONVERTER (request_brotli_decompressor_new ());
+    }
+#endif
+
+    return NULL;
+}
+
+static void request_content_decoder_stage_free (gpointer data) {
+    RequestContentDecoderStage * stage = data;
+
+    g_object_unref (stage->converter);
+    g_byte_array_unref (stage->pending);
+    g_free (stage);
+}
+
+/**
+ * Returns a decoder for the Content-Encoding of headers, or NULL when the body
+ * is not encoded or uses a coding we don't know (it is then shown as is).
+ */
+RequestContentDecoder * request_content_decoder_new (SoupMessageHeaders * headers) {
+    g_return_val_if_fail (headers != NULL, NULL);
+
+    const char * content_encoding = soup_message_headers_get_list (headers, "Content-Encoding");
+    if (content_encoding == NULL) {
+        return NULL;
+    }
+
+    GSList * codings = soup_header_parse_list (content_encoding);
+    GPtrArray * stages = g_ptr_array_new_with_free_func (request_content_decoder_stage_free);
+
+    // Codings are listed in the order they were applied, undo them backwards
+    codings = g_slist_reverse (codings);
+    for (GSList * coding = codings; coding != NULL; coding = coding->next) {
+        if (g_ascii_strcasecmp (coding->data, "identity") == 0) {
+            continue;
+        }
+
+        gboolean is_deflate;
+        GConverter * converter = request_content_decoder_create_converter (coding->data, &is_deflate);
+        if (converter == NULL) {
+            g_info ("Unsupported content encoding %s, showing the body as is.\n", (const gchar *) coding->data);
+            g_ptr_array_set_size (stages, 0);
+            break;
+        }
+
+        RequestContentDecoderStage * stage = g_new0 (RequestContentDecoderStage, 1);
+        stage->converter = converter;
+        stage->pending = g_byte_array_new ();
+        stage->is_deflate = is_deflate;
+
+        g_ptr_array_add (stages, stage);
+    }
+
+    soup_header_free_list (codings);
+
+    if (stages->len == 0) {
+        g_ptr_array_unref (stages);
+        return NULL;
+    }
+
+    RequestContentDecoder * self = g_new0 (RequestContentDecoder, 1);
+    self->stages = stages;
+
+    return self;
+}
+
+void request_content_decoder_free (RequestContentDecoder * self) {
+    if (self == NULL) {
+        return;
+    }
+
+    g_ptr_array_unref (self->stages);
+    g_free (self);
+}
+
+static gboolean request_content_decoder_run_stage (RequestContentDecoderStage * stage, gboolean is_last, GByteArray * output, GError ** error) {
+    gsize consumed = 0;
+    guint output_length = output->len;
+    GError * local_error = NULL;
+
+    if (!request_body_decoder_convert (stage->converter, stage->pending->data, stage->pending->len, is_last, output, &consumed, &local_error)) {
+        // Some servers send raw deflate data instead of the zlib format the
+        // specification asks for, retry once before anything was produced.
+        if (!stage->is_deflate || stage->has_output) {
+            g_propagate_error (error, local_error);
+            return FALSE;
+        }
+
+        g_clear_error (&local_error);
+        g_object_unref (stage->converter);
+        stage->converter = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW));
+        stage->is_deflate = FALSE;
+        g_byte_array_set_size (output, output_length);
+
+        return request_content_decoder_run_stage (stage, is_last, output, error);
+    }
+
+    stage->has_output = stage->has_output || output->len > output_length;
+    g_byte_array_remove_range (stage->pending, 0, consumed);
+
+    return TRUE;
+}
+
+/**
+ * Decodes the next chunk of the body as received on the wire and appends the
+ * result to output. Call it one last time with is_last set once the body is
+ * complete to flush what the decompressors still hold.
+ */
+gboolean request_content_decoder_decode (RequestContentDecoder * self, const guint8 * data, gsize length, gboolean is_last, GByteArray * output, GError ** error) {
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (output != NULL, FALSE);
+
+    GByteArray * input = NULL;
+
+    for (guint i = 0; i < self->stages->len; i++) {
+        RequestContentDecoderStage * stage = g_ptr_array_index (self->stages, i);
+
+        if (input == NULL) {
+            g_byte_array_append (stage->pending, data, length);
+        } else {
+            g_byte_array_append (stage->pending, input->data, input->len);
+            g_byte_array_unref (input);
+        }
+
+        // Last stage writes straight to the output
+        input = i + 1 < self->stages->len ? g_byte_array_new () : NULL;
+
+        if (!request_content_decoder_run_stage (stage, is_last, input != NULL ? input : output, error)) {
+            g_clear_pointer (&input, g_byte_array_unref);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
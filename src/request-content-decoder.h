@@ -0,0 +1,32 @@
+/* request-content-decoder.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+typedef struct _RequestContentDecoder RequestContentDecoder;
+
+const gchar * request_content_decoder_get_accept_encoding (void);
+RequestContentDecoder * request_content_decoder_new (SoupMessageHeaders * headers);
+void request_content_decoder_free (RequestContentDecoder * self);
+gboolean request_content_decoder_decode (RequestContentDecoder * self, const guint8 * data, gsize length, gboolean is_last, GByteArray * output, GError ** error);
+
+G_END_DECLS
@@ -0,0 +1,285 @@
+/* request-diff-view.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtk-4.0/gtk/gtk.h>
+
+#include "request-diff-view.h"
+#include "request-diff.h"
+
+// Longer lines are cut, the view is for spotting differences
+#define LINE_MAX_LENGTH 1024
+
+/**
+ * A row of the diff, as an item of the list.
+ */
+#define REQUEST_TYPE_DIFF_ROW (request_diff_row_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestDiffRowItem, request_diff_row, REQUEST, DIFF_ROW, GObject)
+
+struct _RequestDiffRowItem {
+    GObject parent_instance;
+
+    RequestDiff * diff;
+    guint index;
+};
+
+G_DEFINE_TYPE (RequestDiffRowItem, request_diff_row, G_TYPE_OBJECT);
+
+static void request_diff_row_finalize (GObject * object) {
+    RequestDiffRowItem * self = REQUEST_DIFF_ROW (object);
+
+    request_diff_unref (self->diff);
+
+    G_OBJECT_CLASS (request_diff_row_parent_class)->finalize (object);
+}
+
+static void request_diff_row_class_init (RequestDiffRowItemClass * klass) {
+    G_OBJECT_CLASS (klass)->finalize = request_diff_row_finalize;
+}
+
+static void request_diff_row_init (RequestDiffRowItem * self) {
+    (void) self;
+}
+
+/**
+ * The rows of a diff. Items are only created for the rows on screen.
+ */
+#define REQUEST_TYPE_DIFF_ROW_LIST (request_diff_row_list_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestDiffRowList, request_diff_row_list, REQUEST, DIFF_ROW_LIST, GObject)
+
+struct _RequestDiffRowList {
+    GObject parent_instance;
+
+    RequestDiff * diff;
+};
+
+static void request_diff_row_list_model_init (GListModelInterface * iface);
+
+G_DEFINE_TYPE_WITH_CODE (RequestDiffRowList, request_diff_row_list, G_TYPE_OBJECT, G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, request_diff_row_list_model_init));
+
+static GType request_diff_row_list_get_item_type (GListModel * list) {
+    (void) list;
+
+    return REQUEST_TYPE_DIFF_ROW;
+}
+
+static guint request_diff_row_list_get_n_items (GListModel * list) {
+    return request_diff_get_n_rows (REQUEST_DIFF_ROW_LIST (list)->diff);
+}
+
+static gpointer request_diff_row_list_get_item (GListModel * list, guint position) {
+    RequestDiffRowList * self = REQUEST_DIFF_ROW_LIST (list);
+
+    if (position >= request_diff_get_n_rows (self->diff)) {
+        return NULL;
+    }
+
+    RequestDiffRowItem * item = g_object_new (REQUEST_TYPE_DIFF_ROW, NULL);
+    item->diff = request_diff_ref (self->diff);
+    item->index = position;
+
+    return item;
+}
+
+static void request_diff_row_list_model_init (GListModelInterface * iface) {
+    iface->get_item_type = request_diff_row_list_get_item_type;
+    iface->get_n_items = request_diff_row_list_get_n_items;
+    iface->get_item = request_diff_row_list_get_item;
+}
+
+static void request_diff_row_list_finalize (GObject * object) {
+    RequestDiffRowList * self = REQUEST_DIFF_ROW_LIST (object);
+
+    request_diff_unref (self->diff);
+
+    G_OBJECT_CLASS (request_diff_row_list_parent_class)->finalize (object);
+}
+
+static void request_diff_row_list_class_init (RequestDiffRowListClass * klass) {
+    G_OBJECT_CLASS (klass)->finalize = request_diff_row_list_finalize;
+}
+
+static void request_diff_row_list_init (RequestDiffRowList * self) {
+    (void) self;
+}
+
+/**
+ * Side-by-side view of a RequestDiff: the pinned response on the left, the
+ * current one on the right.
+ */
+struct _RequestDiffView {
+    GtkWidget parent_instance;
+
+    GtkWidget * box;
+    GtkLabel * summary_label;
+    GtkListView * list_view;
+};
+
+G_DEFINE_TYPE (RequestDiffView, request_diff_view, GTK_TYPE_WIDGET);
+
+static const gchar * request_diff_view_kind_classes[] = {
+    [DIFF_KIND_EQUAL] = "equal",
+    [DIFF_KIND_CHANGED] = "changed",
+    [DIFF_KIND_REMOVED] = "removed",
+    [DIFF_KIND_ADDED] = "added",
+};
+
+static GtkWidget * request_diff_view_create_label (const gchar * css_class, gboolean is_text) {
+    GtkWidget * label = gtk_label_new (NULL);
+    gtk_label_set_xalign (GTK_LABEL (label), is_text ? 0 : 1);
+    gtk_widget_add_css_class (label, css_class);
+
+    if (is_text) {
+        gtk_label_set_ellipsize (GTK_LABEL (label), PANGO_ELLIPSIZE_END);
+        gtk_widget_set_hexpand (label, TRUE);
+    } else {
+        gtk_label_set_width_chars (GTK_LABEL (label), 6);
+    }
+
+    return label;
+}
+
+static void request_diff_view_on_setup (GtkSignalListItemFactory * factory, GtkListItem * list_item, gpointer user_data) {
+    (void) factory;
+    (void) user_data;
+
+    // old number, old text, new number, new text
+    GtkWidget * row = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_widget_add_css_class (row, "request_diff_view__row");
+    gtk_box_set_homogeneous (GTK_BOX (row), TRUE); // both halves get the same width
+
+    for (guint side = 0; side < 2; side++) {
+        GtkWidget * half = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+        gtk_widget_set_hexpand (half, TRUE);
+        gtk_widget_add_css_class (half, side == 0 ? "old" : "new");
+        gtk_box_append (GTK_BOX (half), request_diff_view_create_label ("request_diff_view__number", FALSE));
+        gtk_box_append (GTK_BOX (half), request_diff_view_create_label ("request_diff_view__text", TRUE));
+        gtk_box_append (GTK_BOX (row), half);
+    }
+
+    gtk_list_item_set_child (list_item, row);
+}
+
+static void request_diff_view_set_side (GtkWidget * half, RequestDiff * diff, gboolean is_new, guint32 line, RequestDiffKind kind) {
+    GtkWidget * number_label = gtk_widget_get_first_child (half);
+    GtkWidget * text_label = gtk_widget_get_next_sibling (number_label);
+
+    for (guint i = 0; i < G_N_ELEMENTS (request_diff_view_kind_classes); i++) {
+        gtk_widget_remove_css_class (half, request_diff_view_kind_classes[i]);
+    }
+
+    if (line == DIFF_NO_LINE) {
+        gtk_label_set_text (GTK_LABEL (number_label), "");
+        gtk_label_set_text (GTK_LABEL (text_label), "");
+        return;
+    }
+
+    gchar number[16];
+    g_snprintf (number, sizeof (number), "%u", line + 1);
+    gchar * text = request_diff_get_line (diff, is_new, line, LINE_MAX_LENGTH);
+
+    gtk_label_set_text (GTK_LABEL (number_label), number);
+    gtk_label_set_text (GTK_LABEL (text_label), text);
+    gtk_widget_add_css_class (half, request_diff_view_kind_classes[kind]);
+
+    g_free (text);
+}
+
+static void request_diff_view_on_bind (GtkSignalListItemFactory * factory, GtkListItem * list_item, gpointer user_data) {
+    (void) factory;
+    (void) user_data;
+
+    RequestDiffRowItem * item = REQUEST_DIFF_ROW (gtk_list_item_get_item (list_item));
+    const RequestDiffRow * row = request_diff_get_row (item->diff, item->index);
+    GtkWidget * old_half = gtk_widget_get_first_child (gtk_list_item_get_child (list_item));
+    GtkWidget * new_half = gtk_widget_get_next_sibling (old_half);
+
+    request_diff_view_set_side (old_half, item->diff, FALSE, row->old_line, row->kind);
+    request_diff_view_set_side (new_half, item->diff, TRUE, row->new_line, row->kind);
+}
+
+static void request_diff_view_dispose (GObject * object) {
+    RequestDiffView * self = REQUEST_DIFF_VIEW (object);
+
+    g_clear_pointer (&self->box, gtk_widget_unparent);
+
+    G_OBJECT_CLASS (request_diff_view_parent_class)->dispose (object);
+}
+
+static void request_diff_view_class_init (RequestDiffViewClass * klass) {
+    G_OBJECT_CLASS (klass)->dispose = request_diff_view_dispose;
+
+    gtk_widget_class_set_layout_manager_type (GTK_WIDGET_CLASS (klass), GTK_TYPE_BIN_LAYOUT);
+}
+
+static void request_diff_view_init (RequestDiffView * self) {
+    GtkListItemFactory * factory = gtk_signal_list_item_factory_new ();
+    g_signal_connect (factory, "setup", G_CALLBACK (request_diff_view_on_setup), NULL);
+    g_signal_connect (factory, "bind", G_CALLBACK (request_diff_view_on_bind), NULL);
+
+    self->list_view = GTK_LIST_VIEW (gtk_list_view_new (NULL, factory));
+    gtk_widget_add_css_class (GTK_WIDGET (self->list_view), "monospace");
+
+    GtkWidget * scrolled_window = gtk_scrolled_window_new ();
+    gtk_scrolled_window_set_child (GTK_SCROLLED_WINDOW (scrolled_window), GTK_WIDGET (self->list_view));
+    gtk_widget_set_vexpand (scrolled_window, TRUE);
+
+    self->summary_label = GTK_LABEL (gtk_label_new (NULL));
+    gtk_label_set_xalign (self->summary_label, 0);
+    gtk_widget_add_css_class (GTK_WIDGET (self->summary_label), "request_diff_view__summary");
+
+    self->box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+    gtk_box_append (GTK_BOX (self->box), GTK_WIDGET (self->summary_label));
+    gtk_box_append (GTK_BOX (self->box), scrolled_window);
+    gtk_widget_set_parent (self->box, GTK_WIDGET (self));
+
+    gtk_widget_add_css_class (GTK_WIDGET (self), "request_diff_view");
+}
+
+RequestDiffView * request_diff_view_new (void) {
+    return g_object_new (REQUEST_TYPE_DIFF_VIEW, NULL);
+}
+
+/**
+ * Shows diff, or nothing when diff is NULL.
+ */
+void request_diff_view_set_diff (RequestDiffView * self, RequestDiff * diff) {
+    g_return_if_fail (REQUEST_IS_DIFF_VIEW (self));
+
+    if (diff == NULL) {
+        gtk_list_view_set_model (self->list_view, NULL);
+        gtk_label_set_text (self->summary_label, "");
+        return;
+    }
+
+    guint n_added = request_diff_get_n_added (diff);
+    guint n_removed = request_diff_get_n_removed (diff);
+    gchar * summary = n_added == 0 && n_removed == 0
+        ? g_strdup ("Identical") // FIXME: Handle translations
+        : g_strdup_printf ("%u %s added, %u removed", n_added, n_added == 1 ? "line" : "lines", n_removed); // FIXME: Handle translations
+    gtk_label_set_text (self->summary_label, summary);
+    g_free (summary);
+
+    RequestDiffRowList * rows = g_object_new (REQUEST_TYPE_DIFF_ROW_LIST, NULL);
+    rows->diff = request_diff_ref (diff);
+
+    // Takes ownership of rows
+    GtkSelectionModel * selection = GTK_SELECTION_MODEL (gtk_no_selection_new (G_LIST_MODEL (rows)));
+    gtk_list_view_set_model (self->list_view, selection);
+    g_object_unref (selection);
+}
@@ -0,0 +1,642 @@
+/* request-diff.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gio/gio.h>
+#include <string.h>
+
+#include "request-diff.h"
+#include "request-json.h"
+
+// Past that many steps of the middle snake search, the best diagonal found so
+// far is used: the diff may not be minimal but stays fast on unrelated bodies.
+#define DIFF_MIN_TOO_EXPENSIVE 4096
+
+/**
+ * Line diff of two documents.
+ *
+ * Each line is replaced by the number of the first line with the same content,
+ * lines found in a single document are set aside, then the sequences of
+ * numbers are compared with Myers' algorithm in linear space (the "middle
+ * snake" divide and conquer variant). The result is kept
+ * as rows pairing the lines of both documents, the text is read from the
+ * documents when a row is shown.
+ */
+struct _RequestDiff {
+    GBytes * bytes[2]; // old, new
+    GArray * lines[2]; // guint64 offset of each line start, and of the end
+    GArray * rows; // RequestDiffRow
+    guint n_added;
+    guint n_removed;
+};
+
+typedef struct RequestDiffLine {
+    const guint8 * data;
+    gsize length;
+    guint hash;
+} RequestDiffLine;
+
+typedef struct RequestDiffContext {
+    const guint32 * x; // line ids of the old document
+    const guint32 * y; // line ids of the new document
+    guint8 * removed; // by old line
+    guint8 * added; // by new line
+    gint64 * forward; // furthest x reached on each diagonal
+    gint64 * backward;
+    gint64 too_expensive;
+    GCancellable * cancellable;
+    gboolean is_cancelled;
+} RequestDiffContext;
+
+static guint request_diff_line_hash (gconstpointer key) {
+    return ((const RequestDiffLine *) key)->hash;
+}
+
+static gboolean request_diff_line_equal (gconstpointer a, gconstpointer b) {
+    const RequestDiffLine * first = a;
+    const RequestDiffLine * second = b;
+
+    return first->length == second->length && memcmp (first->data, second->data, first->length) == 0;
+}
+
+/**
+ * Returns the start of each line of bytes, followed by the end of the
+ * document.
+ */
+static GArray * request_diff_split_lines (GBytes * bytes) {
+    gsize length;
+    const guint8 * data = g_bytes_get_data (bytes, &length);
+    GArray * lines = g_array_new (FALSE, FALSE, sizeof (guint64));
+    guint64 offset = 0;
+
+    while (offset < length) {
+        g_array_append_val (lines, offset);
+
+        const guint8 * newline = memchr (data + offset, '\n', length - offset);
+        offset = newline != NULL ? (guint64) (newline - data) + 1 : length;
+    }
+
+    g_array_append_val (lines, offset);
+
+    return lines;
+}
+
+/**
+ * Numbers the lines of a document, equal lines of both documents get the same
+ * number. keys is filled with the lines used as keys of ids, it must outlive
+ * the table.
+ */
+static guint32 * request_diff_number_lines (RequestDiff * self, guint side, GHashTable * ids, RequestDiffLine ** keys) {
+    const guint8 * data = g_bytes_get_data (self->bytes[side], NULL);
+    GArray * lines = self->lines[side];
+    guint n_lines = lines->len - 1;
+    guint32 * numbers = g_new (guint32, MAX (n_lines, 1));
+
+    *keys = g_new (RequestDiffLine, MAX (n_lines, 1));
+
+    for (guint i = 0; i < n_lines; i++) {
+        guint64 start = g_array_index (lines, guint64, i);
+        guint64 end = g_array_index (lines, guint64, i + 1);
+        RequestDiffLine * key = &(*keys)[i];
+
+        key->data = data + start;
+        key->length = end - start;
+
+        // FNV-1a
+        key->hash = 2166136261u;
+        for (gsize j = 0; j < key->length; j++) {
+            key->hash = (key->hash ^ key->data[j]) * 16777619u;
+        }
+
+        gpointer id;
+        if (g_hash_table_lookup_extended (ids, key, NULL, &id)) {
+            numbers[i] = GPOINTER_TO_UINT (id);
+        } else {
+            numbers[i] = g_hash_table_size (ids);
+            g_hash_table_insert (ids, key, GUINT_TO_POINTER (numbers[i]));
+        }
+    }
+
+    return numbers;
+}
+
+/**
+ * Finds the middle snake of x[xoff, xlim) and y[yoff, ylim): a point of an
+ * optimal edit path, stored in xmid and ymid. The path is searched from both
+ * ends at once, diagonals are numbered by x - y.
+ */
+static void request_diff_middle_snake (RequestDiffContext * ctx, gint64 xoff, gint64 xlim, gint64 yoff, gint64 ylim, gint64 * xmid, gint64 * ymid) {
+    gint64 * fd = ctx->forward;
+    gint64 * bd = ctx->backward;
+    const guint32 * x = ctx->x;
+    const guint32 * y = ctx->y;
+    gint64 dmin = xoff - ylim;
+    gint64 dmax = xlim - yoff;
+    gint64 fmid = xoff - yoff;
+    gint64 bmid = xlim - ylim;
+    gint64 fmin = fmid;
+    gint64 fmax = fmid;
+    gint64 bmin = bmid;
+    gint64 bmax = bmid;
+    gboolean is_odd = (fmid - bmid) & 1;
+
+    fd[fmid] = xoff;
+    bd[bmid] = xlim;
+
+    for (gint64 cost = 1;; cost++) {
+        // One more step forward
+        if (fmin > dmin) {
+            fd[--fmin - 1] = -1;
+        } else {
+            fmin++;
+        }
+
+        if (fmax < dmax) {
+            fd[++fmax + 1] = -1;
+        } else {
+            fmax--;
+        }
+
+        for (gint64 d = fmax; d >= fmin; d -= 2) {
+            gint64 low = fd[d - 1];
+            gint64 high = fd[d + 1];
+            gint64 i = low >= high ? low + 1 : high;
+            gint64 j = i - d;
+
+            while (i < xlim && j < ylim && x[i] == y[j]) {
+                i++;
+                j++;
+            }
+
+            fd[d] = i;
+
+            if (is_odd && bmin <= d && d <= bmax && bd[d] <= i) {
+                *xmid = i;
+                *ymid = j;
+                return;
+            }
+        }
+
+        // One more step backward
+        if (bmin > dmin) {
+            bd[--bmin - 1] = G_MAXINT64;
+        } else {
+            bmin++;
+        }
+
+        if (bmax < dmax) {
+            bd[++bmax + 1] = G_MAXINT64;
+        } else {
+            bmax--;
+        }
+
+        for (gint64 d = bmax; d >= bmin; d -= 2) {
+            gint64 low = bd[d - 1];
+            gint64 high = bd[d + 1];
+            gint64 i = low < high ? low : high - 1;
+            gint64 j = i - d;
+
+            while (i > xoff && j > yoff && x[i - 1] == y[j - 1]) {
+                i--;
+                j--;
+            }
+
+            bd[d] = i;
+
+            if (!is_odd && fmin <= d && d <= fmax && i <= fd[d]) {
+                *xmid = i;
+                *ymid = j;
+                return;
+            }
+        }
+
+        if (cost < ctx->too_expensive) {
+            continue;
+        }
+
+        // Too expensive: split at the furthest point reached in either direction
+        gint64 forward_best = -1;
+        gint64 forward_x = xoff;
+        for (gint64 d = fmax; d >= fmin; d -= 2) {
+            gint64 i = MIN (fd[d], xlim);
+            gint64 j = i - d;
+            if (j > ylim) {
+                i = ylim + d;
+                j = ylim;
+            }
+            if (forward_best < i + j) {
+                forward_best = i + j;
+                forward_x = i;
+            }
+        }
+
+        gint64 backward_best = G_MAXINT64;
+        gint64 backward_x = xlim;
+        for (gint64 d = bmax; d >= bmin; d -= 2) {
+            gint64 i = MAX (xoff, bd[d]);
+            gint64 j = i - d;
+            if (j < yoff) {
+                i = yoff + d;
+                j = yoff;
+            }
+            if (i + j < backward_best) {
+                backward_best = i + j;
+                backward_x = i;
+            }
+        }
+
+        if ((xlim + ylim) - backward_best < forward_best - (xoff + yoff)) {
+            *xmid = forward_x;
+            *ymid = forward_best - forward_x;
+        } else {
+            *xmid = backward_x;
+            *ymid = backward_best - backward_x;
+        }
+
+        return;
+    }
+}
+
+static void request_diff_compare (RequestDiffContext * ctx, gint64 xoff, gint64 xlim, gint64 yoff, gint64 ylim) {
+    if (ctx->is_cancelled || g_cancellable_is_cancelled (ctx->cancellable)) {
+        ctx->is_cancelled = TRUE;
+        return;
+    }
+
+    // Common prefix and suffix
+    while (xoff < xlim && yoff < ylim && ctx->x[xoff] == ctx->y[yoff]) {
+        xoff++;
+        yoff++;
+    }
+
+    while (xlim > xoff && ylim > yoff && ctx->x[xlim - 1] == ctx->y[ylim - 1]) {
+        xlim--;
+        ylim--;
+    }
+
+    if (xoff == xlim || yoff == ylim) {
+        memset (ctx->removed + xoff, 1, xlim - xoff);
+        memset (ctx->added + yoff, 1, ylim - yoff);
+        return;
+    }
+
+    gint64 xmid;
+    gint64 ymid;
+    request_diff_middle_snake (ctx, xoff, xlim, yoff, ylim, &xmid, &ymid);
+
+    // The heuristic may fail to split, everything left is then changed
+    if ((xmid == xoff && ymid == yoff) || (xmid == xlim && ymid == ylim)) {
+        memset (ctx->removed + xoff, 1, xlim - xoff);
+        memset (ctx->added + yoff, 1, ylim - yoff);
+        return;
+    }
+
+    request_diff_compare (ctx, xoff, xmid, yoff, ymid);
+    request_diff_compare (ctx, xmid, xlim, ymid, ylim);
+}
+
+static void request_diff_append_row (RequestDiff * self, guint32 old_line, guint32 new_line, RequestDiffKind kind) {
+    RequestDiffRow row = { old_line, new_line, kind };
+    g_array_append_val (self->rows, row);
+}
+
+/**
+ * Pairs the lines of both documents into rows. Lines removed and added at the
+ * same place are shown side by side as changed.
+ */
+static void request_diff_build_rows (RequestDiff * self, const guint8 * removed, guint32 n_old, const guint8 * added, guint32 n_new) {
+    guint32 i = 0;
+    guint32 j = 0;
+
+    while (i < n_old || j < n_new) {
+        guint32 removed_end = i;
+        guint32 added_end = j;
+
+        while (removed_end < n_old && removed[removed_end]) {
+            removed_end++;
+        }
+
+        while (added_end < n_new && added[added_end]) {
+            added_end++;
+        }
+
+        self->n_removed += removed_end - i;
+        self->n_added += added_end - j;
+
+        while (i < removed_end && j < added_end) {
+            request_diff_append_row (self, i++, j++, DIFF_KIND_CHANGED);
+        }
+
+        while (i < removed_end) {
+            request_diff_append_row (self, i++, DIFF_NO_LINE, DIFF_KIND_REMOVED);
+        }
+
+        while (j < added_end) {
+            request_diff_append_row (self, DIFF_NO_LINE, j++, DIFF_KIND_ADDED);
+        }
+
+        if (i < n_old && j < n_new) {
+            request_diff_append_row (self, i++, j++, DIFF_KIND_EQUAL);
+        } else if (i < n_old) { // only when the comparison was cut short
+            request_diff_append_row (self, i++, DIFF_NO_LINE, DIFF_KIND_REMOVED);
+        } else if (j < n_new) {
+            request_diff_append_row (self, DIFF_NO_LINE, j++, DIFF_KIND_ADDED);
+        }
+    }
+}
+
+static void request_diff_clear (RequestDiff * self) {
+    for (guint side = 0; side < 2; side++) {
+        g_bytes_unref (self->bytes[side]);
+        g_clear_pointer (&self->lines[side], g_array_unref);
+    }
+
+    g_clear_pointer (&self->rows, g_array_unref);
+}
+
+/**
+ * Compares the lines of old_bytes and new_bytes.
+ */
+RequestDiff * request_diff_new (GBytes * old_bytes, GBytes * new_bytes, GCancellable * cancellable, GError ** error) {
+    g_return_val_if_fail (old_bytes != NULL, NULL);
+    g_return_val_if_fail (new_bytes != NULL, NULL);
+
+    RequestDiff * self = g_atomic_rc_box_new0 (RequestDiff);
+    self->bytes[0] = g_bytes_ref (old_bytes);
+    self->bytes[1] = g_bytes_ref (new_bytes);
+    self->lines[0] = request_diff_split_lines (old_bytes);
+    self->lines[1] = request_diff_split_lines (new_bytes);
+    self->rows = g_array_new (FALSE, FALSE, sizeof (RequestDiffRow));
+
+    guint32 n_old = self->lines[0]->len - 1;
+    guint32 n_new = self->lines[1]->len - 1;
+
+    if ((guint64) n_old + n_new >= G_MAXUINT32) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Too many lines to compare"); // FIXME: Handle translations
+        request_diff_unref (self);
+        return NULL;
+    }
+
+    GHashTable * ids = g_hash_table_new (request_diff_line_hash, request_diff_line_equal);
+    RequestDiffLine * old_keys;
+    RequestDiffLine * new_keys;
+    guint32 * x = request_diff_number_lines (self, 0, ids, &old_keys);
+    guint32 * y = request_diff_number_lines (self, 1, ids, &new_keys);
+    guint n_ids = g_hash_table_size (ids);
+
+    g_hash_table_unref (ids);
+    g_free (old_keys);
+    g_free (new_keys);
+
+    guint8 * removed = g_malloc0 (MAX (n_old, 1));
+    guint8 * added = g_malloc0 (MAX (n_new, 1));
+
+    // Lines found in one document only can't be matched, they are left out of
+    // the comparison. Unrelated bodies then cost next to nothing.
+    guint8 * in_old = g_malloc0 (MAX (n_ids, 1));
+    guint8 * in_new = g_malloc0 (MAX (n_ids, 1));
+    guint32 * old_map = g_new (guint32, MAX (n_old, 1));
+    guint32 * new_map = g_new (guint32, MAX (n_new, 1));
+    guint32 n_x = 0;
+    guint32 n_y = 0;
+
+    for (guint32 i = 0; i < n_old; i++) {
+        in_old[x[i]] = 1;
+    }
+
+    for (guint32 j = 0; j < n_new; j++) {
+        in_new[y[j]] = 1;
+    }
+
+    for (guint32 i = 0; i < n_old; i++) {
+        if (in_new[x[i]]) {
+            old_map[n_x] = i;
+            x[n_x++] = x[i];
+        } else {
+            removed[i] = 1;
+        }
+    }
+
+    for (guint32 j = 0; j < n_new; j++) {
+        if (in_old[y[j]]) {
+            new_map[n_y] = j;
+            y[n_y++] = y[j];
+        } else {
+            added[j] = 1;
+        }
+    }
+
+    g_free (in_old);
+    g_free (in_new);
+
+    // Diagonals range from -n_y - 1 to n_x + 1
+    gsize n_diagonals = (gsize) n_x + n_y + 3;
+    gint64 * diagonals = g_new (gint64, 2 * n_diagonals);
+
+    RequestDiffContext ctx = { 0 };
+    ctx.x = x;
+    ctx.y = y;
+    ctx.removed = g_malloc0 (MAX (n_x, 1));
+    ctx.added = g_malloc0 (MAX (n_y, 1));
+    ctx.forward = diagonals + n_y + 1;
+    ctx.backward = diagonals + n_diagonals + n_y + 1;
+    ctx.cancellable = cancellable;
+
+    // About the square root of the number of diagonals
+    ctx.too_expensive = 1;
+    for (gsize n = n_diagonals; n != 0; n >>= 2) {
+        ctx.too_expensive <<= 1;
+    }
+    ctx.too_expensive = MAX (ctx.too_expensive, DIFF_MIN_TOO_EXPENSIVE);
+
+    request_diff_compare (&ctx, 0, n_x, 0, n_y);
+
+    if (!ctx.is_cancelled) {
+        for (guint32 i = 0; i < n_x; i++) {
+            removed[old_map[i]] = ctx.removed[i];
+        }
+
+        for (guint32 j = 0; j < n_y; j++) {
+            added[new_map[j]] = ctx.added[j];
+        }
+
+        request_diff_build_rows (self, removed, n_old, added, n_new);
+    }
+
+    g_free (ctx.removed);
+    g_free (ctx.added);
+    g_free (diagonals);
+    g_free (old_map);
+    g_free (new_map);
+    g_free (removed);
+    g_free (added);
+    g_free (x);
+    g_free (y);
+
+    if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+        request_diff_unref (self);
+        return NULL;
+    }
+
+    return self;
+}
+
+typedef struct RequestDiffTaskData {
+    GBytes * old_bytes;
+    GBytes * new_bytes;
+    gboolean is_json;
+} RequestDiffTaskData;
+
+static void request_diff_task_data_free (RequestDiffTaskData * data) {
+    g_bytes_unref (data->old_bytes);
+    g_bytes_unref (data->new_bytes);
+    g_free (data);
+}
+
+/**
+ * Returns bytes beautified when they are valid JSON, a new reference to bytes
+ * otherwise. Returns NULL when cancelled.
+ */
+static GBytes * request_diff_format_json (GBytes * bytes, GCancellable * cancellable, GError ** error) {
+    gsize length;
+    const gchar * text = g_bytes_get_data (bytes, &length);
+    GError * format_error = NULL;
+
+    gchar * formatted = request_json_format (text, (gssize) length, JSON_FORMAT_BEAUTIFY, cancellable, &format_error);
+    if (formatted != NULL) {
+        return g_bytes_new_take (formatted, strlen (formatted));
+    }
+
+    if (g_error_matches (format_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_propagate_error (error, format_error);
+        return NULL;
+    }
+
+    // Compared as received
+    g_error_free (format_error);
+
+    return g_bytes_ref (bytes);
+}
+
+static void request_diff_thread (GTask * task, gpointer source_object, gpointer task_data, GCancellable * cancellable) {
+    (void) source_object;
+    RequestDiffTaskData * data = task_data;
+    GError * error = NULL;
+    GBytes * old_bytes;
+    GBytes * new_bytes;
+
+    // Minified documents are a single line, one line per value makes the
+    // diff readable
+    if (data->is_json) {
+        old_bytes = request_diff_format_json (data->old_bytes, cancellable, &error);
+        if (old_bytes == NULL) {
+            g_task_return_error (task, error);
+            return;
+        }
+
+        new_bytes = request_diff_format_json (data->new_bytes, cancellable, &error);
+        if (new_bytes == NULL) {
+            g_bytes_unref (old_bytes);
+            g_task_return_error (task, error);
+            return;
+        }
+    } else {
+        old_bytes = g_bytes_ref (data->old_bytes);
+        new_bytes = g_bytes_ref (data->new_bytes);
+    }
+
+    RequestDiff * diff = request_diff_new (old_bytes, new_bytes, cancellable, &error);
+
+    g_bytes_unref (old_bytes);
+    g_bytes_unref (new_bytes);
+
+    if (diff == NULL) {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    g_task_return_pointer (task, diff, (GDestroyNotify) request_diff_unref);
+}
+
+/**
+ * Compares old_bytes and new_bytes on a worker thread. With is_json, documents
+ * that are valid JSON are beautified first and compared value by value.
+ */
+void request_diff_new_async (GBytes * old_bytes, GBytes * new_bytes, gboolean is_json, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data) {
+    g_return_if_fail (old_bytes != NULL);
+    g_return_if_fail (new_bytes != NULL);
+
+    RequestDiffTaskData * data = g_new0 (RequestDiffTaskData, 1);
+    data->old_bytes = g_bytes_ref (old_bytes);
+    data->new_bytes = g_bytes_ref (new_bytes);
+    data->is_json = is_json;
+
+    GTask * task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_task_data (task, data, (GDestroyNotify) request_diff_task_data_free);
+    g_task_run_in_thread (task, request_diff_thread);
+    g_object_unref (task);
+}
+
+RequestDiff * request_diff_new_finish (GAsyncResult * result, GError ** error) {
+    g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+    return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+RequestDiff * request_diff_ref (RequestDiff * self) {
+    return g_atomic_rc_box_acquire (self);
+}
+
+void request_diff_unref (RequestDiff * self) {
+    g_atomic_rc_box_release_full (self, (GDestroyNotify) request_diff_clear);
+}
+
+guint request_diff_get_n_rows (RequestDiff * self) {
+    return self->rows->len;
+}
+
+const RequestDiffRow * request_diff_get_row (RequestDiff * self, guint index) {
+    g_return_val_if_fail (index < self->rows->len, NULL);
+
+    return &g_array_index (self->rows, RequestDiffRow, index);
+}
+
+guint request_diff_get_n_added (RequestDiff * self) {
+    return self->n_added;
+}
+
+guint request_diff_get_n_removed (RequestDiff * self) {
+    return self->n_removed;
+}
+
+/**
+ * Returns the text of a line of the old or new document, without its line
+ * ending, cut at max_length bytes and made valid UTF-8.
+ */
+gchar * request_diff_get_line (RequestDiff * self, gboolean is_new, guint32 line, gsize max_length) {
+    GArray * lines = self->lines[is_new ? 1 : 0];
+    g_return_val_if_fail (line < lines->len - 1, NULL);
+
+    const gchar * data = g_bytes_get_data (self->bytes[is_new ? 1 : 0], NULL);
+    guint64 start = g_array_index (lines, guint64, line);
+    guint64 end = g_array_index (lines, guint64, line + 1);
+
+    while (end > start && (data[end - 1] == '\n' || data[end - 1] == '\r')) {
+        end--;
+    }
+
+    return g_utf8_make_valid (data + start, MIN (end - start, max_length));
+}
@@ -0,0 +1,56 @@
+/* request-diff.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define DIFF_NO_LINE G_MAXUINT32
+
+typedef struct _RequestDiff RequestDiff;
+
+typedef enum RequestDiffKind {
+    DIFF_KIND_EQUAL,
+    DIFF_KIND_CHANGED, // removed on the left, added on the right
+    DIFF_KIND_REMOVED,
+    DIFF_KIND_ADDED,
+} RequestDiffKind;
+
+/**
+ * A row of the side-by-side view: a line of each document, DIFF_NO_LINE when
+ * that side is blank.
+ */
+typedef struct RequestDiffRow {
+    guint32 old_line;
+    guint32 new_line;
+    RequestDiffKind kind;
+} RequestDiffRow;
+
+RequestDiff * request_diff_new (GBytes * old_bytes, GBytes * new_bytes, GCancellable * cancellable, GError ** error);
+void request_diff_new_async (GBytes * old_bytes, GBytes * new_bytes, gboolean is_json, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data);
+RequestDiff * request_diff_new_finish (GAsyncResult * result, GError ** error);
+RequestDiff * request_diff_ref (RequestDiff * self);
+void request_diff_unref (RequestDiff * self);
+guint request_diff_get_n_rows (RequestDiff * self);
+const RequestDiffRow * request_diff_get_row (RequestDiff * self, guint index);
+guint request_diff_get_n_added (RequestDiff * self);
+guint request_diff_get_n_removed (RequestDiff * self);
+gchar * request_diff_get_line (RequestDiff * self, gboolean is_new, guint32 line, gsize max_length);
+
+G_END_DECLS
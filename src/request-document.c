@@ -0,0 +1,577 @@
+/* request-document.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtk-4.0/gtk/gtk.h>
+#include <libsoup/soup.h>
+
+#include "request-document.h"
+#include "request-url-bar.h"
+#include "request-response-bar.h"
+#include "request-double-entry.h"
+#include "request-header-list.h"
+#include "request-response-panel.h"
+#include "request-source-view.h"
+#include "request-body-decoder.h"
+#include "request-body-store.h"
+#include "request-settings.h"
+#include "request-transfer.h"
+#include "request-transfer-progress.h"
+#include "request-body-bar.h"
+#include "request-upload.h"
+#include "request-json.h"
+#include "request-json-index.h"
+
+/**
+ * A request and its response, shown in a tab of the window. Each document
+ * sends its own messages, on the session shared by all of them.
+ */
+struct _RequestDocument {
+    GtkWidget parent_instance;
+
+    GtkPaned * main_grid;
+    gchar * title;
+    gboolean is_loading;
+
+    /* Custom widgets */
+    RequestURLBar * request_url_bar;
+    RequestResponseBar * request_response_bar;
+    RequestResponsePanel * response_panel;
+    RequestHeaderList * response_header_list;
+    RequestBodyBar * request_body_bar;
+    RequestSourceView * request_source_view;
+    RequestHeaderList * request_form_list;
+    RequestSourceView * response_source_view;
+    RequestTransferProgress * transfer_progress;
+
+    /* Response being received */
+    RequestBodyStore * response_body;
+    RequestBodyDecoder * body_decoder;
+    gboolean is_large_body;
+    GString * pending_text;
+    guint flush_source_id;
+    GCancellable * json_cancellable;
+};
+
+G_DEFINE_TYPE (RequestDocument, request_document, GTK_TYPE_WIDGET)
+
+// How often the text received since the last update is pushed to the response
+// view, inserting every chunk separately would relayout the view for each one.
+#define BODY_FLUSH_INTERVAL 100 // ms
+
+// Bodies larger than this (in MB) are shown by the large text view
+#define DEFAULT_LARGE_BODY_THRESHOLD 8
+
+static goffset request_document_get_large_body_threshold (void) {
+    return (goffset) MAX (request_settings_get_int ("large-body-threshold", DEFAULT_LARGE_BODY_THRESHOLD), 1) * 1024 * 1024;
+}
+
+/**
+ * Stops loading the body in the source view, it will be shown by the large
+ * text view once received.
+ */
+static void request_document_switch_to_large_body (RequestDocument * self) {
+    self->is_large_body = TRUE;
+    g_string_truncate (self->pending_text, 0);
+
+    request_source_view_set_text (self->response_source_view, "");
+    request_response_panel_set_is_large_body (self->response_panel, TRUE);
+}
+
+static gboolean request_document_flush_body (gpointer data) {
+    RequestDocument * self = data;
+
+    self->flush_source_id = 0;
+
+    if (self->pending_text->len > 0) {
+        request_source_view_append_text (self->response_source_view, self->pending_text->str, self->pending_text->len);
+        g_string_truncate (self->pending_text, 0);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * Builds a multipart/form-data body from the enabled form rows, rows without
+ * a name are skipped.
+ */
+static gboolean request_document_attach_form (RequestDocument * self, SoupMessage * msg, GError ** error) {
+    GListModel * rows = request_header_list_get_rows (self->request_form_list);
+    SoupMultipart * form = request_upload_form_new ();
+
+    for (guint i = 0; i < g_list_model_get_n_items (rows); i++) {
+        RequestHeaderListRow * row = g_list_model_get_item (rows, i);
+        const gchar * name = request_header_list_row_get_label (row);
+        const gchar * value = request_header_list_row_get_value (row);
+
+        gboolean is_appended = !request_header_list_row_get_is_enabled (row) || name == NULL || *name == '\0'
+            || request_upload_form_append (form, name, value != NULL ? value : "", NULL, error);
+
+        g_object_unref (row);
+
+        if (!is_appended) {
+            soup_multipart_free (form);
+            return FALSE;
+        }
+    }
+
+    request_upload_set_form (msg, form);
+    soup_multipart_free (form);
+
+    return TRUE;
+}
+
+/**
+ * Attaches the text of the request view. JSON bodies are validated first so a
+ * typo is reported here instead of by the server.
+ */
+static gboolean request_document_attach_text (RequestDocument * self, SoupMessage * msg, GError ** error) {
+    request_upload_set_text (msg, request_source_view_get_text (self->request_source_view));
+
+    const gchar * content_type = soup_message_headers_get_content_type (msg->request_headers, NULL);
+    if (content_type == NULL || g_strstr_len (content_type, -1, "json") == NULL)
+        return TRUE;
+
+    // The text is a single chunk, shared and not flattened into a copy
+    SoupBuffer * body = soup_message_body_get_chunk (msg->request_body, 0);
+    if (body == NULL)
+        return TRUE;
+
+    gboolean is_valid = body->length == 0 || request_json_validate (body->data, body->length, error);
+    soup_buffer_free (body);
+
+    return is_valid;
+}
+
+/**
+ * Attaches the request body, from the request view, the chosen file or the
+ * form rows. Returns TRUE to abort the request when a file cannot be sent or
+ * a JSON body is invalid.
+ */
+static gboolean on_request_prepare (RequestDocument * sender, SoupMessage * msg, gpointer data) {
+    (void) sender;
+    RequestDocument * self = data;
+
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (SOUP_IS_MESSAGE (msg), FALSE);
+
+    GError * error = NULL;
+    gboolean is_attached = TRUE;
+
+    switch (request_body_bar_get_source (self->request_body_bar)) {
+        case BODY_SOURCE_TEXT:
+            is_attached = request_document_attach_text (self, msg, &error);
+            break;
+        case BODY_SOURCE_FILE:
+            is_attached = request_body_bar_attach_file (self->request_body_bar, msg, &error);
+            break;
+        case BODY_SOURCE_FORM:
+            is_attached = request_document_attach_form (self, msg, &error);
+            break;
+    }
+
+    if (!is_attached) {
+        request_response_bar_show_error (self->request_response_bar, error->message);
+        g_error_free (error);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void on_body_source_changed (RequestBodyBar * sender, gpointer data) {
+    RequestDocument * self = data;
+    g_return_if_fail (self != NULL);
+
+    RequestBodySource source = request_body_bar_get_source (sender);
+
+    // Files are sent as is, never loaded in the view
+    gtk_widget_set_visible (GTK_WIDGET (self->request_source_view), source == BODY_SOURCE_TEXT);
+    gtk_widget_set_visible (request_header_list_get_view (self->request_form_list), source == BODY_SOURCE_FORM);
+}
+
+static void on_request_start (RequestDocument * sender, SoupMessage * msg, gpointer data) {
+    (void) sender; // We don't use sender directly as it doesn't contain a reference to the widgets of request_response_bar...
+    RequestDocument * self = data;
+
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (msg != NULL);
+    g_return_if_fail (SOUP_IS_MESSAGE (msg));
+
+    g_clear_object (&self->response_body);
+
+    request_transfer_progress_start (self->transfer_progress);
+    request_response_bar_on_message_begin (msg, self->request_response_bar);
+
+    // The whole URL, tabs on the same host but another port or query differ
+    gchar * url = soup_uri_to_string (soup_message_get_uri (msg), FALSE);
+    g_free (self->title);
+    self->title = g_strdup_printf ("%s %s", msg->method, url);
+    g_free (url);
+    self->is_loading = TRUE;
+
+    g_signal_emit_by_name (self, DOCUMENT_STATE_CHANGED_SIGNAL);
+}
+
+static void on_json_index_ready (GObject * source_object, GAsyncResult * result, gpointer data) {
+    (void) source_object;
+    RequestDocument * self = data;
+    GError * error = NULL;
+
+    RequestJsonIndex * index = request_json_index_new_finish (result, &error);
+    if (index == NULL) {
+        // Not JSON after all, or the response was replaced
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_clear_object (&self->json_cancellable);
+        }
+
+        g_error_free (error);
+        return;
+    }
+
+    g_clear_object (&self->json_cancellable);
+
+    request_response_panel_set_json_index (self->response_panel, index);
+
+    // The tree is the cheaper way to browse a large document
+    if (self->is_large_body) {
+        request_response_panel_show_json_tree (self->response_panel, TRUE);
+    }
+
+    request_json_index_unref (index);
+}
+
+/**
+ * Indexes the response body on a worker thread when it is JSON, it can then
+ * be browsed as a tree.
+ */
+static void request_document_index_json_body (RequestDocument * self, SoupMessage * msg, GBytes * bytes) {
+    const gchar * content_type = soup_message_headers_get_content_type (msg->response_headers, NULL);
+    if (content_type == NULL || g_strstr_len (content_type, -1, "json") == NULL) {
+        return;
+    }
+
+    self->json_cancellable = g_cancellable_new ();
+    request_json_index_new_async (bytes, self->json_cancellable, on_json_index_ready, self);
+}
+
+static void on_request_headers (RequestDocument * sender, SoupMessage * msg, gpointer data) {
+    (void) sender;
+    RequestDocument * self = data;
+
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (SOUP_IS_MESSAGE (msg));
+
+    gboolean has_content_length = soup_message_headers_get_encoding (msg->response_headers) == SOUP_ENCODING_CONTENT_LENGTH;
+    goffset content_length = has_content_length ? soup_message_headers_get_content_length (msg->response_headers) : -1;
+
+    request_transfer_progress_set_expected_length (self->transfer_progress, content_length);
+
+    request_response_panel_set_headers (self->response_panel, msg->response_headers);
+
+    // Drop the tree of the previous response
+    if (self->json_cancellable != NULL) {
+        g_cancellable_cancel (self->json_cancellable);
+        g_clear_object (&self->json_cancellable);
+    }
+
+    request_response_panel_set_json_index (self->response_panel, NULL);
+    request_response_panel_set_body (self->response_panel, NULL);
+
+    gchar * charset = request_body_decoder_get_charset_from_headers (msg->response_headers);
+
+    request_body_decoder_free (self->body_decoder);
+    self->body_decoder = request_body_decoder_new (charset);
+    self->is_large_body = FALSE;
+    g_string_truncate (self->pending_text, 0);
+
+    g_clear_object (&self->response_body);
+    self->response_body = request_body_store_new_default ();
+
+    request_response_panel_set_is_large_body (self->response_panel, FALSE);
+
+    g_free (charset);
+
+    request_source_view_set_text (self->response_source_view, "");
+
+    if (content_length > request_document_get_large_body_threshold ()) {
+        request_document_switch_to_large_body (self);
+    }
+}
+
+static void on_request_chunk (RequestDocument * sender, SoupMessage * msg, GBytes * chunk, gpointer data) {
+    (void) sender;
+    RequestDocument * self = data;
+
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (chunk != NULL);
+
+    // Content-Length counts the bytes on the wire, before content decoding
+    RequestTransfer * transfer = request_transfer_get_from_message (msg);
+    if (transfer != NULL) {
+        request_transfer_progress_update (self->transfer_progress, request_transfer_get_received_length (transfer));
+    }
+
+    GError * error = NULL;
+    gsize length;
+    const guint8 * chunk_data = g_bytes_get_data (chunk, &length);
+
+    if (!request_body_store_append (self->response_body, chunk_data, length, &error)) {
+        g_warning ("Cannot store response body: %s\n", error->message);
+        g_error_free (error);
+    }
+
+    if (self->is_large_body) {
+        return;
+    }
+
+    // The source view keeps its own copy of the text and cannot cope with huge
+    // bodies, past the threshold the body is only kept in the store.
+    if (request_body_store_get_length (self->response_body) > request_document_get_large_body_threshold ()
+        || request_body_store_is_spooled (self->response_body)) {
+        request_document_switch_to_large_body (self);
+        return;
+    }
+
+    request_body_decoder_decode (self->body_decoder, chunk_data, length, FALSE, self->pending_text);
+
+    if (self->flush_source_id == 0) {
+        self->flush_source_id = g_timeout_add (BODY_FLUSH_INTERVAL, request_document_flush_body, self);
+    }
+}
+
+static void on_request_complete (RequestDocument * sender, SoupMessage * msg, gpointer data) {
+    (void) sender; // We don't use sender directly as it doesn't contain a reference to the widgets of request_response_bar...
+    RequestDocument * self = data;
+
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (msg != NULL);
+    g_return_if_fail (SOUP_IS_MESSAGE (msg));
+    g_return_if_fail (GTK_IS_WIDGET (self->request_response_bar));
+
+    request_transfer_progress_stop (self->transfer_progress);
+
+    self->is_loading = FALSE;
+    g_signal_emit_by_name (self, DOCUMENT_STATE_CHANGED_SIGNAL);
+
+    goffset body_length = 0;
+    if (self->response_body != NULL) {
+        request_body_store_close (self->response_body);
+        body_length = request_body_store_get_length (self->response_body);
+    }
+
+    RequestTransfer * transfer = request_transfer_get_from_message (msg);
+    goffset wire_length = transfer != NULL ? request_transfer_get_received_length (transfer) : body_length;
+
+    request_response_bar_on_message_received (msg, wire_length, body_length, self->request_response_bar);
+
+    if (self->is_large_body && self->response_body != NULL) {
+        RequestLargeTextView * large_text_view = request_response_panel_get_large_text_view (self->response_panel);
+        request_large_text_view_set_body (large_text_view, self->response_body, request_body_decoder_get_charset (self->body_decoder));
+    } else if (self->body_decoder != NULL) {
+        // Flush what the decoder still holds, there is no more data to complete it
+        request_body_decoder_decode (self->body_decoder, NULL, 0, TRUE, self->pending_text);
+    }
+
+    g_clear_pointer (&self->body_decoder, request_body_decoder_free);
+
+    g_clear_handle_id (&self->flush_source_id, g_source_remove);
+    request_document_flush_body (self);
+
+    // The complete body can now be searched and browsed
+    if (self->response_body != NULL) {
+        GError * error = NULL;
+        GBytes * bytes = request_body_store_get_bytes (self->response_body, &error);
+
+        if (bytes == NULL) {
+            g_warning ("Cannot read response body: %s\n", error->message);
+            g_error_free (error);
+            return;
+        }
+
+        request_response_panel_set_body (self->response_panel, bytes);
+        request_document_index_json_body (self, msg, bytes);
+        g_bytes_unref (bytes);
+    }
+}
+
+static void on_transfer_cancel (RequestTransferProgress * sender, gpointer data) {
+    (void) sender;
+    RequestDocument * self = data;
+    g_return_if_fail (self != NULL);
+
+    request_url_bar_cancel (self->request_url_bar);
+}
+
+static void request_document_dispose (GObject * object) {
+    RequestDocument * self = REQUEST_DOCUMENT (object);
+
+    g_clear_pointer ((GtkWidget **) &self->main_grid, gtk_widget_unparent);
+
+    G_OBJECT_CLASS (request_document_parent_class)->dispose (object);
+}
+
+static void request_document_finalize (GObject * object) {
+    RequestDocument * self = REQUEST_DOCUMENT (object);
+
+    g_clear_handle_id (&self->flush_source_id, g_source_remove);
+
+    if (self->json_cancellable != NULL) {
+        g_cancellable_cancel (self->json_cancellable);
+        g_clear_object (&self->json_cancellable);
+    }
+
+    g_clear_pointer (&self->body_decoder, request_body_decoder_free);
+    g_clear_object (&self->response_body);
+    g_clear_object (&self->request_form_list);
+    g_clear_object (&self->response_panel);
+    g_string_free (self->pending_text, TRUE);
+    g_free (self->title);
+
+    G_OBJECT_CLASS (request_document_parent_class)->finalize (object);
+}
+
+static void request_document_class_init (RequestDocumentClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
+    GtkWidgetClass * widget_class = GTK_WIDGET_CLASS (klass);
+
+    object_class->dispose = request_document_dispose;
+    object_class->finalize = request_document_finalize;
+
+    gtk_widget_class_set_layout_manager_type (widget_class, GTK_TYPE_BIN_LAYOUT);
+
+    // Declare our own signals
+    g_signal_new (DOCUMENT_STATE_CHANGED_SIGNAL, REQUEST_TYPE_DOCUMENT, G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+}
+
+static void request_document_init (RequestDocument * self) {
+    self->pending_text = g_string_new (NULL);
+    self->title = g_strdup ("New request"); // FIXME: Handle translations
+
+    self->main_grid = GTK_PANED (gtk_paned_new (GTK_ORIENTATION_HORIZONTAL));
+    gtk_widget_set_hexpand (GTK_WIDGET (self->main_grid), TRUE);
+    gtk_widget_set_vexpand (GTK_WIDGET (self->main_grid), TRUE);
+    gtk_widget_set_parent (GTK_WIDGET (self->main_grid), GTK_WIDGET (self));
+
+    request_document_set_paned_view_size (self);
+
+    GtkWidget * left = gtk_grid_new ();
+    GtkWidget * right = gtk_grid_new ();
+
+    gtk_paned_set_start_child (self->main_grid, left);
+    gtk_paned_set_end_child (self->main_grid, right);
+
+    // Prevent widgets in paned view from shrinking too much
+    gtk_paned_set_shrink_start_child (self->main_grid, FALSE);
+    gtk_paned_set_shrink_end_child (self->main_grid, FALSE);
+
+    /* BUILD LEFT PANEL */
+
+    self->request_url_bar = request_url_bar_new ();
+    g_return_if_fail (self->request_url_bar != NULL);
+
+    gtk_grid_attach (GTK_GRID (left), GTK_WIDGET (self->request_url_bar), 0, 0, 1, 1);
+
+    g_signal_connect (self->request_url_bar, REQUEST_PREPARE_SIGNAL, G_CALLBACK (on_request_prepare), self);
+    g_signal_connect (self->request_url_bar, REQUEST_STARTED_SIGNAL, G_CALLBACK (on_request_start), self);
+    g_signal_connect (self->request_url_bar, REQUEST_HEADERS_SIGNAL, G_CALLBACK (on_request_headers), self);
+    g_signal_connect (self->request_url_bar, REQUEST_CHUNK_SIGNAL, G_CALLBACK (on_request_chunk), self);
+    g_signal_connect (self->request_url_bar, REQUEST_COMPLETED_SIGNAL, G_CALLBACK (on_request_complete), self);
+
+    /* BUILD RIGHT PANEL */
+
+    self->request_response_bar = request_response_bar_new ();
+    g_return_if_fail (self->request_response_bar != NULL);
+
+    gtk_grid_attach (GTK_GRID (right), GTK_WIDGET (self->request_response_bar), 0, 0, 1, 1);
+
+    self->response_panel = request_response_panel_new ();
+    g_return_if_fail (self->response_panel != NULL);
+
+    self->response_header_list = request_response_panel_get_header_list_view (self->response_panel);
+    g_return_if_fail (self->response_header_list != NULL);
+
+    self->response_source_view = request_response_panel_get_source_view (self->response_panel);
+    g_return_if_fail (self->response_source_view != NULL);
+
+    gtk_grid_attach (GTK_GRID (right), request_response_panel_get_view (self->response_panel), 0, 1, 1, 1);
+
+    self->transfer_progress = request_transfer_progress_new ();
+    g_return_if_fail (self->transfer_progress != NULL);
+
+    gtk_grid_attach (GTK_GRID (right), GTK_WIDGET (self->transfer_progress), 0, 2, 1, 1);
+
+    g_signal_connect (self->transfer_progress, TRANSFER_PROGRESS_CANCEL_SIGNAL, G_CALLBACK (on_transfer_cancel), self);
+
+    self->request_body_bar = request_body_bar_new ();
+    g_return_if_fail (self->request_body_bar != NULL);
+
+    gtk_grid_attach (GTK_GRID (left), GTK_WIDGET (self->request_body_bar), 0, 1, 1, 1);
+
+    g_signal_connect (self->request_body_bar, BODY_SOURCE_CHANGED_SIGNAL, G_CALLBACK (on_body_source_changed), self);
+
+    self->request_source_view = request_source_view_new (FALSE);
+    g_return_if_fail (self->request_source_view != NULL);
+
+    gtk_grid_attach (GTK_GRID (left), GTK_WIDGET (self->request_source_view), 0, 2, 1, 1);
+
+    self->request_form_list = request_header_list_new ();
+    g_return_if_fail (self->request_form_list != NULL);
+
+    RequestHeaderListRow * form_row = request_header_list_row_new (self->request_form_list, "", "", FALSE);
+    request_header_list_add_row (self->request_form_list, form_row);
+    g_object_unref (form_row);
+
+    gtk_grid_attach (GTK_GRID (left), request_header_list_get_view (self->request_form_list), 0, 3, 1, 1);
+    gtk_widget_set_visible (request_header_list_get_view (self->request_form_list), FALSE);
+}
+
+RequestDocument * request_document_new (void) {
+    return g_object_new (REQUEST_TYPE_DOCUMENT, NULL);
+}
+
+/**
+ * Returns the method and URL of the last request sent, for the tab label.
+ */
+const gchar * request_document_get_title (RequestDocument * self) {
+    g_return_val_if_fail (REQUEST_IS_DOCUMENT (self), NULL);
+
+    return self->title;
+}
+
+gboolean request_document_is_loading (RequestDocument * self) {
+    g_return_val_if_fail (REQUEST_IS_DOCUMENT (self), FALSE);
+
+    return self->is_loading;
+}
+
+/**
+ * Aborts the request in flight, if any.
+ */
+void request_document_cancel (RequestDocument * self) {
+    g_return_if_fail (REQUEST_IS_DOCUMENT (self));
+
+    request_url_bar_cancel (self->request_url_bar);
+}
+
+void request_document_set_paned_view_size (RequestDocument * self) {
+    (void) self; // avoid unused parameter warning
+
+    // If we don't have a stored position for our panels, we set it to 50% of the current window size,
+    // else, we set it to the previously known position.
+
+    // TODO: Implement me
+}
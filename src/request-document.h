@@ -0,0 +1,36 @@
+/* request-document.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gtk-4.0/gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define REQUEST_TYPE_DOCUMENT (request_document_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestDocument, request_document, REQUEST, DOCUMENT, GtkWidget)
+
+#define DOCUMENT_STATE_CHANGED_SIGNAL "state-changed"
+
+RequestDocument * request_document_new (void);
+const gchar * request_document_get_title (RequestDocument * self);
+gboolean request_document_is_loading (RequestDocument * self);
+void request_document_cancel (RequestDocument * self);
+void request_document_set_paned_view_size (RequestDocument * self);
+
+G_END_DECLS
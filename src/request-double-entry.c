@@ -101,6 +101,8 @@ static void request_double_entry_on_activate_toggled (GtkCheckButton * button, g
 
     gtk_widget_set_sensitive (GTK_WIDGET (self->label), self->is_enabled);
     gtk_widget_set_sensitive (GTK_WIDGET (self->value), self->is_enabled);
+
+    g_signal_emit_by_name (self, DOUBLE_ENTRY_CHANGED_SIGNAL, self);
 }
 
 static void request_double_entry_class_init (RequestDoubleEntryClass * klass) {
@@ -175,3 +177,27 @@ void request_double_entry_set_is_readonly (RequestDoubleEntry * self, gboolean i
     g_object_set (self->value, "editable", !is_readonly, NULL);
     gtk_check_button_set_active (self->disable_button, TRUE);
 }
+
+const gchar * request_double_entry_get_label (RequestDoubleEntry * self) {
+    g_return_val_if_fail (REQUEST_IS_DOUBLE_ENTRY (self), NULL);
+
+    return gtk_editable_get_text (GTK_EDITABLE (self->label));
+}
+
+const gchar * request_double_entry_get_value (RequestDoubleEntry * self) {
+    g_return_val_if_fail (REQUEST_IS_DOUBLE_ENTRY (self), NULL);
+
+    return gtk_editable_get_text (GTK_EDITABLE (self->value));
+}
+
+gboolean request_double_entry_get_is_enabled (RequestDoubleEntry * self) {
+    g_return_val_if_fail (REQUEST_IS_DOUBLE_ENTRY (self), FALSE);
+
+    return gtk_check_button_get_active (self->disable_button);
+}
+
+void request_double_entry_set_is_enabled (RequestDoubleEntry * self, gboolean is_enabled) {
+    g_return_if_fail (REQUEST_IS_DOUBLE_ENTRY (self));
+
+    gtk_check_button_set_active (self->disable_button, is_enabled);
+}
@@ -34,5 +34,9 @@ RequestDoubleEntry * request_double_entry_new (const gchar * label, const gchar
 void request_double_entry_set_label (RequestDoubleEntry * self, const gchar * label);
 void request_double_entry_set_value (RequestDoubleEntry * self, const gchar * value);
 void request_double_entry_set_is_readonly (RequestDoubleEntry * self, gboolean is_readonly);
+const gchar * request_double_entry_get_label (RequestDoubleEntry * self);
+const gchar * request_double_entry_get_value (RequestDoubleEntry * self);
+gboolean request_double_entry_get_is_enabled (RequestDoubleEntry * self);
+void request_double_entry_set_is_enabled (RequestDoubleEntry * self, gboolean is_enabled);
 
 G_END_DECLS
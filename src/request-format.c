@@ -0,0 +1,62 @@
+/* request-format.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <glib.h>
+#include <inttypes.h>
+
+#include "request-format.h"
+
+/**
+ * Returns length as a string with the appropriate unit at the end of the
+ * string.
+ */
+gchar * request_format_size (goffset raw_length) {
+    const char * sizes[] = { "TB", "GB", "MB", "KB", "B" };
+    const uint64_t exbibytes = 1024ULL * 1024ULL * 1024ULL * 1024ULL;
+
+    guint64 length = (guint64) MAX (raw_length, 0);
+    uint64_t multiplier = exbibytes;
+    for (unsigned long i = 0; i < sizeof (sizes) / sizeof (*(sizes)); i++, multiplier /= 1024) {
+        if (length < multiplier)
+            continue;
+        if (length % multiplier == 0)
+            return g_strdup_printf ("%" PRIu64 " %s", length / multiplier, sizes[i]);
+        else
+            return g_strdup_printf ("%.2f %s", (float) length / multiplier, sizes[i]);
+    }
+
+    return g_strdup ("0 B");
+}
+
+/**
+ * Returns the decoded size, followed by the size on the wire and the
+ * compression ratio when the body was encoded.
+ */
+gchar * request_format_transfer_size (goffset wire_length, goffset decoded_length) {
+    gchar * decoded_size = request_format_size (decoded_length);
+    if (wire_length == decoded_length || wire_length <= 0) {
+        return decoded_size;
+    }
+
+    gchar * wire_size = request_format_size (wire_length);
+    gchar * size = g_strdup_printf ("%s (%s on the wire, %.1f×)", decoded_size, wire_size, (gdouble) decoded_length / wire_length); // FIXME: Handle translations
+
+    g_free (decoded_size);
+    g_free (wire_size);
+
+    return size;
+}
@@ -20,6 +20,7 @@
 
 #include "request-header-list.h"
 #include "request-double-entry.h"
+#include "request-header-model.h"
 
 struct _RequestHeaderListRow {
     GObject parent_instance;
@@ -27,14 +28,20 @@ struct _RequestHeaderListRow {
     gchar * label;
     gchar * value;
     gboolean is_readonly;
+    gboolean is_enabled;
 
     RequestHeaderList * container;
+
+    // Set when the strings are borrowed from the owner instead of copied
+    gpointer owner;
+    GDestroyNotify owner_release;
 };
 
 struct _RequestHeaderList {
     GObject parent_instance;
 
     GListModel * store;
+    RequestHeaderModel * model; // read-only lists only
 
     GtkWidget * scroll_view;
     GtkWidget * list_view;
@@ -47,25 +54,77 @@ struct _RequestHeaderListClass {
 G_DEFINE_TYPE (RequestHeaderListRow, request_header_list_row, G_TYPE_OBJECT);
 G_DEFINE_TYPE (RequestHeaderList, request_header_list, G_TYPE_OBJECT);
 
+static void request_header_list_row_finalize (GObject * object) {
+    RequestHeaderListRow * self = REQUEST_HEADER_LIST_ROW (object);
+
+    if (self->owner_release != NULL) {
+        self->owner_release (self->owner);
+    } else {
+        g_free (self->label);
+        g_free (self->value);
+    }
+
+    G_OBJECT_CLASS (request_header_list_row_parent_class)->finalize (object);
+}
+
 static void request_header_list_row_class_init (RequestHeaderListRowClass * klass) {
-    (void) klass;
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = request_header_list_row_finalize;
 }
 
 static void request_header_list_row_init (RequestHeaderListRow * self) {
-    (void) self;
+    self->is_enabled = TRUE;
 }
 
+/**
+ * label and value are copied, the row can outlive the message they come from.
+ */
 RequestHeaderListRow * request_header_list_row_new (RequestHeaderList * container, gchar * label, gchar * value, gboolean is_readonly) {
     RequestHeaderListRow * self = g_object_new (REQUEST_TYPE_HEADER_LIST_ROW, NULL);
 
-    self->label = label;
-    self->value = value;
+    self->label = g_strdup (label);
+    self->value = g_strdup (value);
     self->is_readonly = is_readonly;
     self->container = container;
 
     return self;
 }
 
+/**
+ * Creates a read-only row pointing to label and value without copying them,
+ * owner is kept until the row is finalized and then given to owner_release.
+ */
+RequestHeaderListRow * request_header_list_row_new_borrowed (const gchar * label, const gchar * value, gpointer owner, GDestroyNotify owner_release) {
+    RequestHeaderListRow * self = g_object_new (REQUEST_TYPE_HEADER_LIST_ROW, NULL);
+
+    self->label = (gchar *) label;
+    self->value = (gchar *) value;
+    self->is_readonly = TRUE;
+    self->owner = owner;
+    self->owner_release = owner_release;
+
+    return self;
+}
+
+const gchar * request_header_list_row_get_label (RequestHeaderListRow * self) {
+    g_return_val_if_fail (REQUEST_IS_HEADER_LIST_ROW (self), NULL);
+
+    return self->label;
+}
+
+const gchar * request_header_list_row_get_value (RequestHeaderListRow * self) {
+    g_return_val_if_fail (REQUEST_IS_HEADER_LIST_ROW (self), NULL);
+
+    return self->value;
+}
+
+gboolean request_header_list_row_get_is_enabled (RequestHeaderListRow * self) {
+    g_return_val_if_fail (REQUEST_IS_HEADER_LIST_ROW (self), FALSE);
+
+    return self->is_enabled;
+}
+
 static void request_header_list_class_init (RequestHeaderListClass * klass) {
     (void) klass;
 }
@@ -89,12 +148,21 @@ static guint request_header_list_get_row_position (RequestHeaderListRow * self)
 }
 
 static void on_row_changed_signal (RequestDoubleEntry * row, gpointer data) {
-    (void) row;
     RequestHeaderListRow * self = data;
 
+    // Keep the row in sync with the entries, they are recycled when scrolled
+    // out of view.
+    g_free (self->label);
+    g_free (self->value);
+    self->label = g_strdup (request_double_entry_get_label (row));
+    self->value = g_strdup (request_double_entry_get_value (row));
+    self->is_enabled = request_double_entry_get_is_enabled (row);
+
     // When we change the last row, we adds a new row on edit
     if (request_header_list_get_row_position (self) == g_list_model_get_n_items (self->container->store) - 1) {
-        request_header_list_add_row (self->container, request_header_list_row_new (self->container, "", "", FALSE));
+        RequestHeaderListRow * new_row = request_header_list_row_new (self->container, "", "", FALSE);
+        request_header_list_add_row (self->container, new_row);
+        g_object_unref (new_row);
     }
 }
 
@@ -124,6 +192,7 @@ static void on_bind_listitem (GtkSignalListItemFactory * factory, GtkListItem *
     request_double_entry_set_label ((RequestDoubleEntry *) entries, row->label);
     request_double_entry_set_value ((RequestDoubleEntry *) entries, row->value);
     request_double_entry_set_is_readonly ((RequestDoubleEntry *) entries, row->is_readonly);
+    request_double_entry_set_is_enabled ((RequestDoubleEntry *) entries, row->is_enabled);
 
     if (!row->is_readonly) {
         g_signal_connect (entries, DOUBLE_ENTRY_CHANGED_SIGNAL, G_CALLBACK (on_row_changed_signal), row);
@@ -183,10 +252,47 @@ GtkWidget * request_header_list_get_view (RequestHeaderList * self) {
     return self->scroll_view;
 }
 
+/**
+ * Returns the rows of the list (RequestHeaderListRow), owned by the list.
+ */
+GListModel * request_header_list_get_rows (RequestHeaderList * self) {
+    return self->store;
+}
+
 void request_header_list_add_row (RequestHeaderList * self, RequestHeaderListRow * row) {
     g_list_store_append ((GListStore *) self->store, row);
 }
 
+/**
+ * Read-only lists show headers straight from an arena-backed model, rows are
+ * only created for the visible items.
+ */
+RequestHeaderList * request_header_list_new_readonly (void) {
+    RequestHeaderList * self = request_header_list_new ();
+
+    self->model = request_header_model_new ();
+    self->store = G_LIST_MODEL (self->model);
+
+    // No selection: it would materialize the selected row for nothing
+    gtk_list_view_set_model (GTK_LIST_VIEW (self->list_view), GTK_SELECTION_MODEL (gtk_no_selection_new (g_object_ref (self->store))));
+
+    return self;
+}
+
+/**
+ * Replaces every row of a read-only list with headers, in a single update.
+ */
+void request_header_list_set_headers (RequestHeaderList * self, SoupMessageHeaders * headers) {
+    g_return_if_fail (self->model != NULL);
+
+    request_header_model_set_headers (self->model, headers);
+}
+
 void request_header_list_empty (RequestHeaderList * self) {
+    if (self->model != NULL) {
+        request_header_model_clear (self->model);
+        return;
+    }
+
     g_list_store_remove_all ((GListStore *) self->store);
 }
@@ -19,6 +19,8 @@
 
 #include <gtk-4.0/gtk/gtk.h>
 
+#include <libsoup/soup.h>
+
 #include "request-double-entry.h"
 
 G_BEGIN_DECLS
@@ -30,10 +32,17 @@ G_DECLARE_FINAL_TYPE (RequestHeaderList, request_header_list, REQUEST, HEADER_LI
 G_DECLARE_FINAL_TYPE (RequestHeaderListRow, request_header_list_row, REQUEST, HEADER_LIST_ROW, GObject)
 
 RequestHeaderListRow * request_header_list_row_new (RequestHeaderList * container, gchar * label, gchar * value, gboolean is_readonly);
+RequestHeaderListRow * request_header_list_row_new_borrowed (const gchar * label, const gchar * value, gpointer owner, GDestroyNotify owner_release);
+const gchar * request_header_list_row_get_label (RequestHeaderListRow * self);
+const gchar * request_header_list_row_get_value (RequestHeaderListRow * self);
+gboolean request_header_list_row_get_is_enabled (RequestHeaderListRow * self);
 
 RequestHeaderList * request_header_list_new (void);
+RequestHeaderList * request_header_list_new_readonly (void);
 GtkWidget * request_header_list_get_view (RequestHeaderList * self);
+GListModel * request_header_list_get_rows (RequestHeaderList * self);
 void request_header_list_add_row (RequestHeaderList * self, RequestHeaderListRow * row);
+void request_header_list_set_headers (RequestHeaderList * self, SoupMessageHeaders * headers);
 void request_header_list_empty (RequestHeaderList * self);
 
 G_END_DECLS
@@ -0,0 +1,198 @@
+/* request-header-model.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+
+#include "request-header-model.h"
+#include "request-header-list.h"
+
+/**
+ * Strings and entries of one response. It is reference counted so rows handed
+ * to the view stay valid after the model moved on to another response.
+ */
+typedef struct RequestHeaderArena {
+    GStringChunk * strings;
+    GArray * entries;
+} RequestHeaderArena;
+
+typedef struct RequestHeaderEntry {
+    const gchar * name;
+    const gchar * value;
+} RequestHeaderEntry;
+
+struct _RequestHeaderModel {
+    GObject parent_instance;
+
+    RequestHeaderArena * arena;
+};
+
+static void request_header_model_list_model_init (GListModelInterface * iface);
+
+G_DEFINE_TYPE_WITH_CODE (RequestHeaderModel, request_header_model, G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, request_header_model_list_model_init));
+
+// Names most responses carry, they point to this table instead of the arena
+static const gchar * common_header_names[] = {
+    "Accept-Ranges", "Access-Control-Allow-Credentials", "Access-Control-Allow-Headers",
+    "Access-Control-Allow-Methods", "Access-Control-Allow-Origin", "Access-Control-Expose-Headers",
+    "Access-Control-Max-Age", "Age", "Alt-Svc", "Cache-Control", "Connection", "Content-Disposition",
+    "Content-Encoding", "Content-Language", "Content-Length", "Content-Location", "Content-Range",
+    "Content-Security-Policy", "Content-Type", "Date", "ETag", "Expires", "Keep-Alive", "Last-Modified",
+    "Link", "Location", "Pragma", "Referrer-Policy", "Retry-After", "Server", "Server-Timing",
+    "Set-Cookie", "Strict-Transport-Security", "Timing-Allow-Origin", "Transfer-Encoding", "Vary",
+    "Via", "WWW-Authenticate", "X-Cache", "X-Content-Type-Options", "X-Frame-Options",
+    "X-Powered-By", "X-Request-Id", "X-XSS-Protection",
+};
+
+static const gchar * request_header_model_intern_name (RequestHeaderArena * arena, const gchar * name) {
+    static GHashTable * interned = NULL;
+
+    if (g_once_init_enter (&interned)) {
+        GHashTable * table = g_hash_table_new (g_str_hash, g_str_equal);
+        for (gsize i = 0; i < G_N_ELEMENTS (common_header_names); i++) {
+            g_hash_table_add (table, (gpointer) common_header_names[i]);
+        }
+
+        g_once_init_leave (&interned, table);
+    }
+
+    const gchar * common_name = g_hash_table_lookup (interned, name);
+    if (common_name != NULL) {
+        return common_name;
+    }
+
+    // Uncommon names repeated in the same response are stored once
+    return g_string_chunk_insert_const (arena->strings, name);
+}
+
+static RequestHeaderArena * request_header_arena_new (void) {
+    RequestHeaderArena * arena = g_rc_box_new0 (RequestHeaderArena);
+    arena->strings = g_string_chunk_new (4096);
+    arena->entries = g_array_new (FALSE, FALSE, sizeof (RequestHeaderEntry));
+
+    return arena;
+}
+
+static void request_header_arena_clear (gpointer data) {
+    RequestHeaderArena * arena = data;
+
+    g_string_chunk_free (arena->strings);
+    g_array_unref (arena->entries);
+}
+
+static void request_header_arena_release (gpointer data) {
+    g_rc_box_release_full (data, request_header_arena_clear);
+}
+
+static GType request_header_model_get_item_type (GListModel * list) {
+    (void) list;
+
+    return REQUEST_TYPE_HEADER_LIST_ROW;
+}
+
+static guint request_header_model_get_n_items (GListModel * list) {
+    RequestHeaderModel * self = REQUEST_HEADER_MODEL (list);
+
+    return self->arena != NULL ? self->arena->entries->len : 0;
+}
+
+/**
+ * Rows are only created when the view binds them, and borrow their strings
+ * from the arena.
+ */
+static gpointer request_header_model_get_item (GListModel * list, guint position) {
+    RequestHeaderModel * self = REQUEST_HEADER_MODEL (list);
+
+    if (self->arena == NULL || position >= self->arena->entries->len) {
+        return NULL;
+    }
+
+    RequestHeaderEntry * entry = &g_array_index (self->arena->entries, RequestHeaderEntry, position);
+
+    return request_header_list_row_new_borrowed (entry->name, entry->value, g_rc_box_acquire (self->arena), request_header_arena_release);
+}
+
+static void request_header_model_list_model_init (GListModelInterface * iface) {
+    iface->get_item_type = request_header_model_get_item_type;
+    iface->get_n_items = request_header_model_get_n_items;
+    iface->get_item = request_header_model_get_item;
+}
+
+static void request_header_model_finalize (GObject * object) {
+    RequestHeaderModel * self = REQUEST_HEADER_MODEL (object);
+
+    g_clear_pointer (&self->arena, request_header_arena_release);
+
+    G_OBJECT_CLASS (request_header_model_parent_class)->finalize (object);
+}
+
+static void request_header_model_class_init (RequestHeaderModelClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = request_header_model_finalize;
+}
+
+static void request_header_model_init (RequestHeaderModel * self) {
+    (void) self;
+}
+
+RequestHeaderModel * request_header_model_new (void) {
+    return g_object_new (REQUEST_TYPE_HEADER_MODEL, NULL);
+}
+
+/**
+ * Copies headers in a new arena and replaces the previous ones, the view gets
+ * a single items-changed.
+ */
+void request_header_model_set_headers (RequestHeaderModel * self, SoupMessageHeaders * headers) {
+    g_return_if_fail (REQUEST_IS_HEADER_MODEL (self));
+    g_return_if_fail (headers != NULL);
+
+    guint removed = request_header_model_get_n_items (G_LIST_MODEL (self));
+    RequestHeaderArena * arena = request_header_arena_new ();
+
+    SoupMessageHeadersIter iter;
+    soup_message_headers_iter_init (&iter, headers);
+
+    const char * name;
+    const char * value;
+    while (soup_message_headers_iter_next (&iter, &name, &value)) {
+        RequestHeaderEntry entry = {
+            .name = request_header_model_intern_name (arena, name),
+            .value = g_string_chunk_insert (arena->strings, value),
+        };
+
+        g_array_append_val (arena->entries, entry);
+    }
+
+    g_clear_pointer (&self->arena, request_header_arena_release);
+    self->arena = arena;
+
+    g_list_model_items_changed (G_LIST_MODEL (self), 0, removed, arena->entries->len);
+}
+
+void request_header_model_clear (RequestHeaderModel * self) {
+    g_return_if_fail (REQUEST_IS_HEADER_MODEL (self));
+
+    guint removed = request_header_model_get_n_items (G_LIST_MODEL (self));
+    g_clear_pointer (&self->arena, request_header_arena_release);
+
+    if (removed > 0) {
+        g_list_model_items_changed (G_LIST_MODEL (self), 0, removed, 0);
+    }
+}
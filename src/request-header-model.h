@@ -0,0 +1,33 @@
+/* request-header-model.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+#define REQUEST_TYPE_HEADER_MODEL (request_header_model_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestHeaderModel, request_header_model, REQUEST, HEADER_MODEL, GObject)
+
+RequestHeaderModel * request_header_model_new (void);
+void request_header_model_set_headers (RequestHeaderModel * self, SoupMessageHeaders * headers);
+void request_header_model_clear (RequestHeaderModel * self);
+
+G_END_DECLS
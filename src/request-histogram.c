@@ -0,0 +1,225 @@
+/* request-histogram.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "request-histogram.h"
+
+/*
+ * Values are split in buckets covering [2^n, 2^(n+1)[, each one divided in
+ * the same number of linear sub-buckets. The first half of the sub-buckets of
+ * every bucket but the first overlaps the previous bucket, so only the second
+ * half is stored.
+ */
+struct RequestHistogram {
+    gint64 highest_trackable_value;
+    gint sub_bucket_count;
+    gint sub_bucket_half_count;
+    gint sub_bucket_half_count_magnitude;
+    gint64 sub_bucket_mask;
+    gint bucket_count;
+
+    gint counts_length;
+    gint64 * counts;
+
+    gint64 total_count;
+    gint64 min;
+    gint64 max;
+    gdouble sum;
+};
+
+static gint request_histogram_get_bucket_index (const RequestHistogram * self, gint64 value) {
+    // Index of the highest bit set, always at least the sub bucket magnitude
+    gint pow2_ceiling = (gint) g_bit_storage ((gulong) (value | self->sub_bucket_mask));
+    return pow2_ceiling - (self->sub_bucket_half_count_magnitude + 1);
+}
+
+static gint request_histogram_get_counts_index (const RequestHistogram * self, gint64 value) {
+    gint bucket_index = request_histogram_get_bucket_index (self, value);
+    gint sub_bucket_index = (gint) (value >> bucket_index);
+
+    return ((bucket_index + 1) << self->sub_bucket_half_count_magnitude) + (sub_bucket_index - self->sub_bucket_half_count);
+}
+
+/**
+ * Returns the highest value that falls in the same slot as the one at index.
+ */
+static gint64 request_histogram_get_highest_equivalent_value (const RequestHistogram * self, gint index) {
+    gint bucket_index = (index >> self->sub_bucket_half_count_magnitude) - 1;
+    gint sub_bucket_index = (index & (self->sub_bucket_half_count - 1)) + self->sub_bucket_half_count;
+
+    if (bucket_index < 0) {
+        sub_bucket_index -= self->sub_bucket_half_count;
+        bucket_index = 0;
+    }
+
+    gint64 lowest = ((gint64) sub_bucket_index) << bucket_index;
+    gint64 range = ((gint64) 1) << bucket_index;
+
+    return lowest + range - 1;
+}
+
+/**
+ * Creates a histogram able to record values in [0, highest_trackable_value]
+ * with significant_digits (1 to 5) of precision. Higher values are clamped.
+ */
+RequestHistogram * request_histogram_new (gint64 highest_trackable_value, gint significant_digits) {
+    g_return_val_if_fail (highest_trackable_value >= 2, NULL);
+    g_return_val_if_fail (significant_digits >= 1 && significant_digits <= 5, NULL);
+
+    RequestHistogram * self = g_new0 (RequestHistogram, 1);
+
+    gint64 largest_value_with_single_unit_resolution = 2;
+    for (gint i = 0; i < significant_digits; i++) {
+        largest_value_with_single_unit_resolution *= 10;
+    }
+
+    gint sub_bucket_count_magnitude = (gint) g_bit_storage ((gulong) (largest_value_with_single_unit_resolution - 1));
+
+    self->highest_trackable_value = highest_trackable_value;
+    self->sub_bucket_half_count_magnitude = MAX (sub_bucket_count_magnitude, 1) - 1;
+    self->sub_bucket_count = 1 << (self->sub_bucket_half_count_magnitude + 1);
+    self->sub_bucket_half_count = self->sub_bucket_count / 2;
+    self->sub_bucket_mask = (gint64) self->sub_bucket_count - 1;
+
+    gint64 smallest_untrackable_value = self->sub_bucket_count;
+    gint buckets_needed = 1;
+    while (smallest_untrackable_value <= highest_trackable_value) {
+        if (smallest_untrackable_value > G_MAXINT64 / 2) {
+            buckets_needed++;
+            break;
+        }
+
+        smallest_untrackable_value <<= 1;
+        buckets_needed++;
+    }
+
+    self->bucket_count = buckets_needed;
+    self->counts_length = (self->bucket_count + 1) * self->sub_bucket_half_count;
+    self->counts = g_new0 (gint64, self->counts_length);
+
+    request_histogram_reset (self);
+
+    return self;
+}
+
+void request_histogram_free (RequestHistogram * self) {
+    if (self == NULL) {
+        return;
+    }
+
+    g_free (self->counts);
+    g_free (self);
+}
+
+void request_histogram_reset (RequestHistogram * self) {
+    g_return_if_fail (self != NULL);
+
+    memset (self->counts, 0, sizeof (gint64) * self->counts_length);
+    self->total_count = 0;
+    self->min = G_MAXINT64;
+    self->max = 0;
+    self->sum = 0;
+}
+
+void request_histogram_record_value (RequestHistogram * self, gint64 value) {
+    g_return_if_fail (self != NULL);
+
+    value = CLAMP (value, 0, self->highest_trackable_value);
+
+    gint index = request_histogram_get_counts_index (self, value);
+    g_return_if_fail (index >= 0 && index < self->counts_length);
+
+    self->counts[index]++;
+    self->total_count++;
+    self->min = MIN (self->min, value);
+    self->max = MAX (self->max, value);
+    self->sum += (gdouble) value;
+}
+
+/**
+ * Records value and back-fills the samples a load generator waiting on a
+ * response failed to send: when value exceeds the expected_interval between
+ * two requests, values decreasing by expected_interval are added down to it.
+ * This corrects for coordinated omission.
+ */
+void request_histogram_record_corrected_value (RequestHistogram * self, gint64 value, gint64 expected_interval) {
+    g_return_if_fail (self != NULL);
+
+    request_histogram_record_value (self, value);
+
+    if (expected_interval <= 0 || value <= expected_interval) {
+        return;
+    }
+
+    for (gint64 missing = value - expected_interval; missing >= expected_interval; missing -= expected_interval) {
+        request_histogram_record_value (self, missing);
+    }
+}
+
+gint64 request_histogram_get_total_count (const RequestHistogram * self) {
+    g_return_val_if_fail (self != NULL, 0);
+
+    return self->total_count;
+}
+
+gint64 request_histogram_get_min (const RequestHistogram * self) {
+    g_return_val_if_fail (self != NULL, 0);
+
+    return self->total_count > 0 ? self->min : 0;
+}
+
+gint64 request_histogram_get_max (const RequestHistogram * self) {
+    g_return_val_if_fail (self != NULL, 0);
+
+    return self->max;
+}
+
+gdouble request_histogram_get_mean (const RequestHistogram * self) {
+    g_return_val_if_fail (self != NULL, 0);
+
+    return self->total_count > 0 ? self->sum / self->total_count : 0;
+}
+
+/**
+ * Returns the value below which percentile (0 to 100) of the recorded values
+ * fall, within the precision of the histogram.
+ */
+gint64 request_histogram_get_value_at_percentile (const RequestHistogram * self, gdouble percentile) {
+    g_return_val_if_fail (self != NULL, 0);
+
+    if (self->total_count == 0) {
+        return 0;
+    }
+
+    percentile = CLAMP (percentile, 0.0, 100.0);
+
+    gint64 count_at_percentile = (gint64) ((percentile / 100.0) * self->total_count + 0.5);
+    count_at_percentile = MAX (count_at_percentile, 1);
+
+    gint64 total = 0;
+    for (gint i = 0; i < self->counts_length; i++) {
+        total += self->counts[i];
+
+        if (total >= count_at_percentile) {
+            return MIN (request_histogram_get_highest_equivalent_value (self, i), self->max);
+        }
+    }
+
+    return self->max;
+}
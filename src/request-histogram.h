@@ -0,0 +1,42 @@
+/* request-histogram.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Log-linear histogram in the spirit of HdrHistogram: values are kept with a
+ * fixed number of significant digits over their whole range, so recording is
+ * O(1) and memory does not depend on the number of samples.
+ */
+typedef struct RequestHistogram RequestHistogram;
+
+RequestHistogram * request_histogram_new (gint64 highest_trackable_value, gint significant_digits);
+void request_histogram_free (RequestHistogram * self);
+void request_histogram_reset (RequestHistogram * self);
+void request_histogram_record_value (RequestHistogram * self, gint64 value);
+void request_histogram_record_corrected_value (RequestHistogram * self, gint64 value, gint64 expected_interval);
+gint64 request_histogram_get_total_count (const RequestHistogram * self);
+gint64 request_histogram_get_min (const RequestHistogram * self);
+gint64 request_histogram_get_max (const RequestHistogram * self);
+gdouble request_histogram_get_mean (const RequestHistogram * self);
+gint64 request_histogram_get_value_at_percentile (const RequestHistogram * self, gdouble percentile);
+
+G_END_DECLS
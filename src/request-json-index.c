@@ -0,0 +1,639 @@
+/* request-json-index.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gio/gio.h>
+#include <string.h>
+
+#include "request-json-index.h"
+#include "request-json.h"
+#include "request-scan.h"
+
+// Cancellation is checked once every that many bytes
+#define INDEX_CANCEL_STRIDE (16 * 1024 * 1024)
+
+// Where one child out of INDEX_CHILD_STRIDE starts is kept, the others are
+// found by scanning forward from the closest one. Flat arrays of millions of
+// items are browsed without ever listing all of them.
+#define INDEX_CHILD_STRIDE 64
+
+/**
+ * Index of a JSON document for browsing it as a tree without parsing it into
+ * a DOM.
+ *
+ * Only objects and arrays are indexed, in document order: their bounds, their
+ * number of children, the container following their subtree and a checkpoint
+ * every INDEX_CHILD_STRIDE children. A child is read on demand by scanning
+ * the container from the closest checkpoint, nested containers are jumped
+ * over thanks to the index. Scalars are never decoded, the text of what is
+ * shown is read straight from the document.
+ */
+struct _RequestJsonIndex {
+    GBytes * bytes;
+    const guint8 * data;
+    gsize length;
+
+    GArray * containers; // RequestJsonContainer
+    GHashTable * checkpoints; // container index to GArray of RequestJsonCheckpoint
+    guint64 root_offset;
+};
+
+typedef struct RequestJsonContainer {
+    guint64 start; // offset of { or [
+    guint64 end; // offset of } or ]
+    guint32 n_children;
+    guint32 next; // first container after this one's subtree
+} RequestJsonContainer;
+
+/**
+ * Where the child number n * INDEX_CHILD_STRIDE of a container starts, for n
+ * from 1. The first child is found from the bounds of the container.
+ */
+typedef struct RequestJsonCheckpoint {
+    guint64 offset; // of the key for object members
+    guint32 next; // first container from offset
+} RequestJsonCheckpoint;
+
+static inline gboolean request_json_index_is_space (guint8 c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline gboolean request_json_index_is_delimiter (guint8 c) {
+    return request_json_index_is_space (c) || c == ',' || c == ':' || c == ']' || c == '}';
+}
+
+/**
+ * Returns the offset of the quote closing the string opened at offset, or
+ * length when it is not closed.
+ */
+static gsize request_json_index_skip_string (const guint8 * data, gsize length, gsize offset) {
+    gsize position = offset + 1;
+
+    while (position < length) {
+        position += request_scan_string (data + position, length - position);
+        if (position >= length) {
+            return length;
+        }
+
+        if (data[position] == '"') {
+            return position;
+        }
+
+        position += data[position] == '\\' ? 2 : 1; // escape or control character
+    }
+
+    return length;
+}
+
+static gsize request_json_index_skip_whitespace (const guint8 * data, gsize length, gsize offset) {
+    gsize n_newlines = 0;
+    gsize line_start = 0;
+
+    return offset + request_scan_whitespace (data + offset, length - offset, &n_newlines, &line_start);
+}
+
+static gsize request_json_index_skip_scalar (const guint8 * data, gsize length, gsize offset) {
+    while (offset < length && !request_json_index_is_delimiter (data[offset])) {
+        offset++;
+    }
+
+    return offset;
+}
+
+static void request_json_index_set_error (GError ** error, const gchar * message, gsize offset) {
+    g_set_error (error, REQUEST_JSON_ERROR, REQUEST_JSON_ERROR_INVALID, "Invalid JSON at offset %" G_GSIZE_FORMAT ": %s", offset, message); // FIXME: Handle translations
+}
+
+/**
+ * What may come next in the container being indexed.
+ */
+typedef enum RequestJsonIndexState {
+    INDEX_STATE_VALUE, // after [ , or :
+    INDEX_STATE_VALUE_OR_CLOSE, // after [
+    INDEX_STATE_KEY, // after , in an object
+    INDEX_STATE_KEY_OR_CLOSE, // after {
+    INDEX_STATE_COLON, // after a key
+    INDEX_STATE_SEPARATOR, // after a value, a comma or the closing bracket
+} RequestJsonIndexState;
+
+static inline gboolean request_json_index_expects_value (RequestJsonIndexState state) {
+    return state == INDEX_STATE_VALUE || state == INDEX_STATE_VALUE_OR_CLOSE;
+}
+
+static inline gboolean request_json_index_is_digit (guint8 c) {
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Checks that the text between start and end is true, false, null or a
+ * number.
+ */
+static gboolean request_json_index_is_scalar (const guint8 * data, gsize start, gsize end) {
+    gsize length = end - start;
+    const gchar * text = (const gchar *) data + start;
+
+    if ((length == 4 && memcmp (text, "true", 4) == 0) || (length == 5 && memcmp (text, "false", 5) == 0)
+        || (length == 4 && memcmp (text, "null", 4) == 0)) {
+        return TRUE;
+    }
+
+    gsize i = start;
+    if (i < end && data[i] == '-') {
+        i++;
+    }
+
+    // Integer part, without leading zeros
+    if (i < end && data[i] == '0') {
+        i++;
+    } else if (i < end && request_json_index_is_digit (data[i])) {
+        while (i < end && request_json_index_is_digit (data[i])) {
+            i++;
+        }
+    } else {
+        return FALSE;
+    }
+
+    if (i < end && data[i] == '.') {
+        gsize fraction = ++i;
+        while (i < end && request_json_index_is_digit (data[i])) {
+            i++;
+        }
+
+        if (i == fraction) {
+            return FALSE;
+        }
+    }
+
+    if (i < end && (data[i] == 'e' || data[i] == 'E')) {
+        i++;
+        if (i < end && (data[i] == '+' || data[i] == '-')) {
+            i++;
+        }
+
+        gsize exponent = i;
+        while (i < end && request_json_index_is_digit (data[i])) {
+            i++;
+        }
+
+        if (i == exponent) {
+            return FALSE;
+        }
+    }
+
+    return i == end;
+}
+
+/**
+ * Counts a key or a value starting at offset in the container on top of
+ * stack, object members are counted on their key.
+ */
+static inline void request_json_index_add_child (GArray * containers, GArray * stack, GHashTable * checkpoints, const guint8 * data,
+                                                 gsize offset, gboolean is_key) {
+    if (stack->len == 0) {
+        return;
+    }
+
+    guint32 index = g_array_index (stack, guint32, stack->len - 1);
+    RequestJsonContainer * container = &g_array_index (containers, RequestJsonContainer, index);
+    if ((data[container->start] == '{') != is_key) {
+        return;
+    }
+
+    if (container->n_children > 0 && container->n_children % INDEX_CHILD_STRIDE == 0) {
+        GArray * list = g_hash_table_lookup (checkpoints, GUINT_TO_POINTER (index));
+        if (list == NULL) {
+            list = g_array_new (FALSE, FALSE, sizeof (RequestJsonCheckpoint));
+            g_hash_table_insert (checkpoints, GUINT_TO_POINTER (index), list);
+        }
+
+        RequestJsonCheckpoint checkpoint = { offset, containers->len };
+        g_array_append_val (list, checkpoint);
+    }
+
+    container->n_children++;
+}
+
+/**
+ * Checks what lies between two structural characters: whitespace, the colon
+ * of an object member and a scalar value. Returns a description of the
+ * problem, NULL when the text is valid. offset is set to where it was found.
+ */
+static const gchar * request_json_index_check_gap (const guint8 * data, gsize * offset, gsize end, RequestJsonIndexState * state,
+                                                   GArray * containers, GArray * stack, GHashTable * checkpoints) {
+    gsize position = request_json_index_skip_whitespace (data, end, *offset);
+
+    if (position < end && data[position] == ':') {
+        if (*state != INDEX_STATE_COLON) {
+            *offset = position;
+            return "unexpected ':'";
+        }
+
+        *state = INDEX_STATE_VALUE;
+        position = request_json_index_skip_whitespace (data, end, position + 1);
+    }
+
+    if (position < end) {
+        gsize scalar_end = request_json_index_skip_scalar (data, end, position);
+        *offset = position;
+
+        if (!request_json_index_expects_value (*state)) {
+            return *state == INDEX_STATE_COLON ? "expected ':'" : "unexpected value";
+        }
+
+        if (!request_json_index_is_scalar (data, position, scalar_end)) {
+            return "invalid value";
+        }
+
+        request_json_index_add_child (containers, stack, checkpoints, data, position, FALSE);
+        *state = INDEX_STATE_SEPARATOR;
+
+        position = request_json_index_skip_whitespace (data, end, scalar_end);
+        if (position < end) {
+            *offset = position;
+            return data[position] == ':' ? "unexpected ':'" : "unexpected value";
+        }
+    }
+
+    *offset = end;
+
+    return NULL;
+}
+
+/**
+ * Indexes the JSON document in bytes in a single pass. Structural characters
+ * are found with the scanning kernels, the grammar of containers is checked
+ * and scalars in between are validated, but strings are only checked to be
+ * terminated.
+ */
+RequestJsonIndex * request_json_index_new (GBytes * bytes, GCancellable * cancellable, GError ** error) {
+    g_return_val_if_fail (bytes != NULL, NULL);
+
+    gsize length;
+    const guint8 * data = g_bytes_get_data (bytes, &length);
+
+    GArray * containers = g_array_new (FALSE, FALSE, sizeof (RequestJsonContainer));
+    GArray * stack = g_array_new (FALSE, FALSE, sizeof (guint32)); // open containers
+    GHashTable * checkpoints = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_array_unref);
+    RequestJsonIndexState state = INDEX_STATE_VALUE;
+    gsize root_offset = request_json_index_skip_whitespace (data, length, 0);
+    gsize next_check = INDEX_CANCEL_STRIDE;
+    const gchar * problem = NULL;
+    gsize offset = root_offset;
+
+    if (root_offset >= length) {
+        problem = "empty document";
+    }
+
+    while (problem == NULL) {
+        gsize structural = offset + request_scan_structural (data + offset, length - offset);
+
+        problem = request_json_index_check_gap (data, &offset, structural, &state, containers, stack, checkpoints);
+        if (problem != NULL || offset >= length) {
+            break;
+        }
+
+        if (offset >= next_check) {
+            if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+                g_hash_table_unref (checkpoints);
+                g_array_unref (stack);
+                g_array_unref (containers);
+                return NULL;
+            }
+
+            next_check = offset + INDEX_CANCEL_STRIDE;
+        }
+
+        guint8 c = data[offset];
+
+        if (c == '"') {
+            gboolean is_key = state == INDEX_STATE_KEY || state == INDEX_STATE_KEY_OR_CLOSE;
+
+            if (is_key) {
+                request_json_index_add_child (containers, stack, checkpoints, data, offset, TRUE);
+                state = INDEX_STATE_COLON;
+            } else if (request_json_index_expects_value (state)) {
+                request_json_index_add_child (containers, stack, checkpoints, data, offset, FALSE);
+                state = INDEX_STATE_SEPARATOR;
+            } else {
+                problem = state == INDEX_STATE_COLON ? "expected ':'" : "unexpected string";
+                continue;
+            }
+
+            offset = request_json_index_skip_string (data, length, offset);
+            if (offset >= length) {
+                problem = "unterminated string";
+                continue;
+            }
+        } else if (c == ',') {
+            if (stack->len == 0 || state != INDEX_STATE_SEPARATOR) {
+                problem = "unexpected ','";
+                continue;
+            }
+
+            guint32 index = g_array_index (stack, guint32, stack->len - 1);
+            state = data[g_array_index (containers, RequestJsonContainer, index).start] == '{' ? INDEX_STATE_KEY : INDEX_STATE_VALUE;
+        } else if (c == '{' || c == '[') {
+            if (!request_json_index_expects_value (state)) {
+                problem = stack->len == 0 ? "more than one value" : state == INDEX_STATE_COLON ? "expected ':'" : "unexpected value";
+                continue;
+            }
+
+            request_json_index_add_child (containers, stack, checkpoints, data, offset, FALSE);
+
+            RequestJsonContainer container = { offset, 0, 0, 0 };
+            guint32 index = containers->len;
+
+            g_array_append_val (containers, container);
+            g_array_append_val (stack, index);
+            state = c == '{' ? INDEX_STATE_KEY_OR_CLOSE : INDEX_STATE_VALUE_OR_CLOSE;
+        } else {
+            if (stack->len == 0) {
+                problem = "unexpected closing bracket";
+                continue;
+            }
+
+            guint32 index = g_array_index (stack, guint32, stack->len - 1);
+            RequestJsonContainer * container = &g_array_index (containers, RequestJsonContainer, index);
+            if ((data[container->start] == '{') != (c == '}')) {
+                problem = "mismatched brackets";
+                continue;
+            }
+
+            // Nothing may be missing before the bracket, a value after a
+            // comma or a colon, or the value of a member
+            if (state != INDEX_STATE_SEPARATOR && state != INDEX_STATE_VALUE_OR_CLOSE && state != INDEX_STATE_KEY_OR_CLOSE) {
+                problem = state == INDEX_STATE_COLON ? "expected ':'" : "expected a value";
+                continue;
+            }
+
+            container->end = offset;
+            container->next = containers->len;
+            g_array_set_size (stack, stack->len - 1);
+            state = INDEX_STATE_SEPARATOR;
+        }
+
+        offset++;
+    }
+
+    if (problem == NULL && (stack->len > 0 || state != INDEX_STATE_SEPARATOR)) {
+        problem = "unexpected end of document";
+    }
+
+    g_array_unref (stack);
+
+    if (problem != NULL) {
+        request_json_index_set_error (error, problem, MIN (offset, length));
+        g_hash_table_unref (checkpoints);
+        g_array_unref (containers);
+        return NULL;
+    }
+
+    RequestJsonIndex * self = g_atomic_rc_box_new0 (RequestJsonIndex);
+    self->bytes = g_bytes_ref (bytes);
+    self->data = data;
+    self->length = length;
+    self->containers = containers;
+    self->checkpoints = checkpoints;
+    self->root_offset = root_offset;
+
+    return self;
+}
+
+static void request_json_index_thread (GTask * task, gpointer source_object, gpointer task_data, GCancellable * cancellable) {
+    (void) source_object;
+    GError * error = NULL;
+
+    RequestJsonIndex * index = request_json_index_new (task_data, cancellable, &error);
+    if (index == NULL) {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    g_task_return_pointer (task, index, (GDestroyNotify) request_json_index_unref);
+}
+
+/**
+ * Indexes bytes on a worker thread.
+ */
+void request_json_index_new_async (GBytes * bytes, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data) {
+    g_return_if_fail (bytes != NULL);
+
+    GTask * task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_task_data (task, g_bytes_ref (bytes), (GDestroyNotify) g_bytes_unref);
+    g_task_run_in_thread (task, request_json_index_thread);
+    g_object_unref (task);
+}
+
+RequestJsonIndex * request_json_index_new_finish (GAsyncResult * result, GError ** error) {
+    g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+    return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void request_json_index_clear (RequestJsonIndex * self) {
+    g_bytes_unref (self->bytes);
+    g_array_unref (self->containers);
+    g_hash_table_unref (self->checkpoints);
+}
+
+RequestJsonIndex * request_json_index_ref (RequestJsonIndex * self) {
+    return g_atomic_rc_box_acquire (self);
+}
+
+void request_json_index_unref (RequestJsonIndex * self) {
+    g_atomic_rc_box_release_full (self, (GDestroyNotify) request_json_index_clear);
+}
+
+/**
+ * Returns the top-level value of the document.
+ */
+RequestJsonChild request_json_index_get_root (RequestJsonIndex * self) {
+    RequestJsonChild root = { JSON_INDEX_NO_KEY, self->root_offset, JSON_INDEX_NONE };
+
+    guint8 c = self->data[self->root_offset];
+    if (c == '{' || c == '[') {
+        root.container = 0; // first one opened
+    }
+
+    return root;
+}
+
+guint32 request_json_index_get_n_children (RequestJsonIndex * self, guint32 container) {
+    g_return_val_if_fail (container < self->containers->len, 0);
+
+    return g_array_index (self->containers, RequestJsonContainer, container).n_children;
+}
+
+/**
+ * Reads the child of parent found first from offset, and moves offset and
+ * next past it. Returns FALSE when there is none left.
+ */
+static gboolean request_json_index_read_child (RequestJsonIndex * self, const RequestJsonContainer * parent, gsize * offset, guint32 * next,
+                                               RequestJsonChild * child) {
+    while (*offset < parent->end && (request_json_index_is_space (self->data[*offset]) || self->data[*offset] == ',')) {
+        (*offset)++;
+    }
+
+    if (*offset >= parent->end) {
+        return FALSE;
+    }
+
+    *child = (RequestJsonChild) { JSON_INDEX_NO_KEY, 0, JSON_INDEX_NONE };
+
+    if (self->data[parent->start] == '{') {
+        child->key_offset = *offset;
+        *offset = request_json_index_skip_string (self->data, parent->end, *offset) + 1;
+
+        while (*offset < parent->end && (request_json_index_is_space (self->data[*offset]) || self->data[*offset] == ':')) {
+            (*offset)++;
+        }
+
+        // The index only holds valid documents, but never read past the
+        // container
+        if (*offset >= parent->end) {
+            return FALSE;
+        }
+    }
+
+    child->value_offset = *offset;
+    guint8 c = self->data[*offset];
+
+    if ((c == '{' || c == '[') && *next < self->containers->len) {
+        const RequestJsonContainer * nested = &g_array_index (self->containers, RequestJsonContainer, *next);
+
+        child->container = *next;
+        *offset = nested->end + 1;
+        *next = nested->next;
+    } else if (c == '"') {
+        *offset = request_json_index_skip_string (self->data, parent->end, *offset) + 1;
+    } else {
+        *offset = request_json_index_skip_scalar (self->data, parent->end, *offset);
+    }
+
+    return TRUE;
+}
+
+/**
+ * Sets child to the direct child of container at position, in document
+ * order. At most INDEX_CHILD_STRIDE children are scanned to find it. Returns
+ * FALSE when position is out of range.
+ */
+gboolean request_json_index_get_child (RequestJsonIndex * self, guint32 container, guint32 position, RequestJsonChild * child) {
+    g_return_val_if_fail (container < self->containers->len, FALSE);
+    g_return_val_if_fail (child != NULL, FALSE);
+
+    const RequestJsonContainer * parent = &g_array_index (self->containers, RequestJsonContainer, container);
+    if (position >= parent->n_children) {
+        return FALSE;
+    }
+
+    guint32 checkpoint = position / INDEX_CHILD_STRIDE;
+    guint32 next = container + 1; // first child container, if any
+    gsize offset = parent->start + 1;
+
+    if (checkpoint > 0) {
+        GArray * checkpoints = g_hash_table_lookup (self->checkpoints, GUINT_TO_POINTER (container));
+        g_return_val_if_fail (checkpoints != NULL && checkpoint <= checkpoints->len, FALSE);
+
+        const RequestJsonCheckpoint * closest = &g_array_index (checkpoints, RequestJsonCheckpoint, checkpoint - 1);
+        offset = closest->offset;
+        next = closest->next;
+    }
+
+    for (guint32 i = checkpoint * INDEX_CHILD_STRIDE; i <= position; i++) {
+        if (!request_json_index_read_child (self, parent, &offset, &next, child)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+RequestJsonKind request_json_index_get_kind (RequestJsonIndex * self, const RequestJsonChild * child) {
+    switch (self->data[child->value_offset]) {
+        case '{':
+            return JSON_KIND_OBJECT;
+        case '[':
+            return JSON_KIND_ARRAY;
+        case '"':
+            return JSON_KIND_STRING;
+        case 't':
+        case 'f':
+            return JSON_KIND_BOOLEAN;
+        case 'n':
+            return JSON_KIND_NULL;
+        default:
+            return JSON_KIND_NUMBER;
+    }
+}
+
+/**
+ * Returns a copy of the text between start and end, cut at max_length bytes
+ * (on a character boundary) with an ellipsis.
+ */
+static gchar * request_json_index_get_text (RequestJsonIndex * self, gsize start, gsize end, gsize max_length) {
+    if (end - start <= max_length) {
+        return g_strndup ((const gchar *) self->data + start, end - start);
+    }
+
+    end = start + max_length;
+    while (end > start && (self->data[end] & 0xC0) == 0x80) {
+        end--;
+    }
+
+    gchar * text = g_strndup ((const gchar *) self->data + start, end - start);
+    gchar * shortened = g_strconcat (text, "…", NULL);
+    g_free (text);
+
+    return shortened;
+}
+
+/**
+ * Returns the key of child as written in the document (escapes are kept), or
+ * NULL when it is not an object member.
+ */
+gchar * request_json_index_get_key (RequestJsonIndex * self, const RequestJsonChild * child, gsize max_length) {
+    if (child->key_offset == JSON_INDEX_NO_KEY) {
+        return NULL;
+    }
+
+    gsize end = request_json_index_skip_string (self->data, self->length, child->key_offset);
+
+    return request_json_index_get_text (self, child->key_offset + 1, end, max_length);
+}
+
+/**
+ * Returns the value of child as written in the document for scalars, and a
+ * summary with the number of children for objects and arrays.
+ */
+gchar * request_json_index_get_preview (RequestJsonIndex * self, const RequestJsonChild * child, gsize max_length) {
+    if (child->container != JSON_INDEX_NONE) {
+        guint32 n_children = request_json_index_get_n_children (self, child->container);
+
+        // FIXME: Handle translations
+        if (request_json_index_get_kind (self, child) == JSON_KIND_OBJECT) {
+            return g_strdup_printf ("{…} %u %s", n_children, n_children == 1 ? "key" : "keys");
+        }
+
+        return g_strdup_printf ("[…] %u %s", n_children, n_children == 1 ? "item" : "items");
+    }
+
+    gsize end = self->data[child->value_offset] == '"'
+        ? request_json_index_skip_string (self->data, self->length, child->value_offset) + 1
+        : request_json_index_skip_scalar (self->data, self->length, child->value_offset);
+
+    return request_json_index_get_text (self, child->value_offset, MIN (end, self->length), max_length);
+}
@@ -0,0 +1,61 @@
+/* request-json-index.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define JSON_INDEX_NONE G_MAXUINT32
+#define JSON_INDEX_NO_KEY G_MAXUINT64
+
+typedef struct _RequestJsonIndex RequestJsonIndex;
+
+typedef enum RequestJsonKind {
+    JSON_KIND_OBJECT,
+    JSON_KIND_ARRAY,
+    JSON_KIND_STRING,
+    JSON_KIND_NUMBER,
+    JSON_KIND_BOOLEAN,
+    JSON_KIND_NULL,
+} RequestJsonKind;
+
+/**
+ * A value of the document: where it starts, where its key starts when it is
+ * an object member (JSON_INDEX_NO_KEY otherwise) and, for objects and arrays,
+ * the container to list its children (JSON_INDEX_NONE otherwise).
+ */
+typedef struct RequestJsonChild {
+    guint64 key_offset;
+    guint64 value_offset;
+    guint32 container;
+} RequestJsonChild;
+
+RequestJsonIndex * request_json_index_new (GBytes * bytes, GCancellable * cancellable, GError ** error);
+void request_json_index_new_async (GBytes * bytes, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data);
+RequestJsonIndex * request_json_index_new_finish (GAsyncResult * result, GError ** error);
+RequestJsonIndex * request_json_index_ref (RequestJsonIndex * self);
+void request_json_index_unref (RequestJsonIndex * self);
+RequestJsonChild request_json_index_get_root (RequestJsonIndex * self);
+guint32 request_json_index_get_n_children (RequestJsonIndex * self, guint32 container);
+gboolean request_json_index_get_child (RequestJsonIndex * self, guint32 container, guint32 position, RequestJsonChild * child);
+RequestJsonKind request_json_index_get_kind (RequestJsonIndex * self, const RequestJsonChild * child);
+gchar * request_json_index_get_key (RequestJsonIndex * self, const RequestJsonChild * child, gsize max_length);
+gchar * request_json_index_get_preview (RequestJsonIndex * self, const RequestJsonChild * child, gsize max_length);
+
+G_END_DECLS
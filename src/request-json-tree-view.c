@@ -0,0 +1,280 @@
+/* request-json-tree-view.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtk-4.0/gtk/gtk.h>
+
+#include "request-json-tree-view.h"
+#include "request-json-index.h"
+
+// Keys and values are cut past that many bytes
+#define PREVIEW_MAX_LENGTH 256
+
+/**
+ * A value of the document, as an item of the tree.
+ */
+#define REQUEST_TYPE_JSON_NODE (request_json_node_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestJsonNode, request_json_node, REQUEST, JSON_NODE, GObject)
+
+struct _RequestJsonNode {
+    GObject parent_instance;
+
+    RequestJsonIndex * index;
+    RequestJsonChild child;
+    guint position; // in its parent, shown for array items
+};
+
+G_DEFINE_TYPE (RequestJsonNode, request_json_node, G_TYPE_OBJECT);
+
+static void request_json_node_finalize (GObject * object) {
+    RequestJsonNode * self = REQUEST_JSON_NODE (object);
+
+    request_json_index_unref (self->index);
+
+    G_OBJECT_CLASS (request_json_node_parent_class)->finalize (object);
+}
+
+static void request_json_node_class_init (RequestJsonNodeClass * klass) {
+    G_OBJECT_CLASS (klass)->finalize = request_json_node_finalize;
+}
+
+static void request_json_node_init (RequestJsonNode * self) {
+    (void) self;
+}
+
+static RequestJsonNode * request_json_node_new (RequestJsonIndex * index, const RequestJsonChild * child, guint position) {
+    RequestJsonNode * self = g_object_new (REQUEST_TYPE_JSON_NODE, NULL);
+    self->index = request_json_index_ref (index);
+    self->child = *child;
+    self->position = position;
+
+    return self;
+}
+
+/**
+ * The children of a container. Its size comes from the index, each child is
+ * read from the document when it is asked for, that is when the container is
+ * expanded and the child scrolled into view.
+ */
+#define REQUEST_TYPE_JSON_NODE_LIST (request_json_node_list_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestJsonNodeList, request_json_node_list, REQUEST, JSON_NODE_LIST, GObject)
+
+struct _RequestJsonNodeList {
+    GObject parent_instance;
+
+    RequestJsonIndex * index;
+    guint32 container;
+    guint n_items;
+};
+
+static void request_json_node_list_model_init (GListModelInterface * iface);
+
+G_DEFINE_TYPE_WITH_CODE (RequestJsonNodeList, request_json_node_list, G_TYPE_OBJECT, G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, request_json_node_list_model_init));
+
+static GType request_json_node_list_get_item_type (GListModel * list) {
+    (void) list;
+
+    return REQUEST_TYPE_JSON_NODE;
+}
+
+static guint request_json_node_list_get_n_items (GListModel * list) {
+    return REQUEST_JSON_NODE_LIST (list)->n_items;
+}
+
+static gpointer request_json_node_list_get_item (GListModel * list, guint position) {
+    RequestJsonNodeList * self = REQUEST_JSON_NODE_LIST (list);
+
+    RequestJsonChild child;
+    if (!request_json_index_get_child (self->index, self->container, position, &child)) {
+        return NULL;
+    }
+
+    return request_json_node_new (self->index, &child, position);
+}
+
+static void request_json_node_list_model_init (GListModelInterface * iface) {
+    iface->get_item_type = request_json_node_list_get_item_type;
+    iface->get_n_items = request_json_node_list_get_n_items;
+    iface->get_item = request_json_node_list_get_item;
+}
+
+static void request_json_node_list_finalize (GObject * object) {
+    RequestJsonNodeList * self = REQUEST_JSON_NODE_LIST (object);
+
+    request_json_index_unref (self->index);
+
+    G_OBJECT_CLASS (request_json_node_list_parent_class)->finalize (object);
+}
+
+static void request_json_node_list_class_init (RequestJsonNodeListClass * klass) {
+    G_OBJECT_CLASS (klass)->finalize = request_json_node_list_finalize;
+}
+
+static void request_json_node_list_init (RequestJsonNodeList * self) {
+    (void) self;
+}
+
+static RequestJsonNodeList * request_json_node_list_new (RequestJsonIndex * index, guint32 container) {
+    RequestJsonNodeList * self = g_object_new (REQUEST_TYPE_JSON_NODE_LIST, NULL);
+    self->index = request_json_index_ref (index);
+    self->container = container;
+    self->n_items = request_json_index_get_n_children (index, container);
+
+    return self;
+}
+
+/**
+ * Tree of a JSON response, built from a RequestJsonIndex.
+ */
+struct _RequestJsonTreeView {
+    GtkWidget parent_instance;
+
+    GtkWidget * scrolled_window;
+    GtkListView * list_view;
+};
+
+G_DEFINE_TYPE (RequestJsonTreeView, request_json_tree_view, GTK_TYPE_WIDGET);
+
+static GListModel * request_json_tree_view_create_children (gpointer item, gpointer user_data) {
+    (void) user_data;
+    RequestJsonNode * node = REQUEST_JSON_NODE (item);
+
+    // Scalars and empty containers can't be expanded
+    if (node->child.container == JSON_INDEX_NONE || request_json_index_get_n_children (node->index, node->child.container) == 0) {
+        return NULL;
+    }
+
+    return G_LIST_MODEL (request_json_node_list_new (node->index, node->child.container));
+}
+
+static void request_json_tree_view_on_setup (GtkSignalListItemFactory * factory, GtkListItem * list_item, gpointer user_data) {
+    (void) factory;
+    (void) user_data;
+
+    GtkWidget * label = gtk_label_new (NULL);
+    gtk_label_set_xalign (GTK_LABEL (label), 0);
+    gtk_label_set_ellipsize (GTK_LABEL (label), PANGO_ELLIPSIZE_END);
+    gtk_label_set_selectable (GTK_LABEL (label), TRUE);
+    gtk_widget_add_css_class (label, "monospace");
+
+    GtkWidget * expander = gtk_tree_expander_new ();
+    gtk_tree_expander_set_child (GTK_TREE_EXPANDER (expander), label);
+    gtk_list_item_set_child (list_item, expander);
+}
+
+static void request_json_tree_view_on_bind (GtkSignalListItemFactory * factory, GtkListItem * list_item, gpointer user_data) {
+    (void) factory;
+    (void) user_data;
+
+    GtkTreeListRow * row = GTK_TREE_LIST_ROW (gtk_list_item_get_item (list_item));
+    GtkTreeExpander * expander = GTK_TREE_EXPANDER (gtk_list_item_get_child (list_item));
+    RequestJsonNode * node = REQUEST_JSON_NODE (gtk_tree_list_row_get_item (row));
+
+    gchar * preview = request_json_index_get_preview (node->index, &node->child, PREVIEW_MAX_LENGTH);
+    gchar * key = request_json_index_get_key (node->index, &node->child, PREVIEW_MAX_LENGTH);
+    gchar * text;
+
+    if (key != NULL) {
+        text = g_strdup_printf ("%s: %s", key, preview);
+    } else if (gtk_tree_list_row_get_depth (row) > 0) {
+        text = g_strdup_printf ("[%u]: %s", node->position, preview);
+    } else {
+        text = g_strdup (preview);
+    }
+
+    gtk_tree_expander_set_list_row (expander, row);
+    gtk_label_set_text (GTK_LABEL (gtk_tree_expander_get_child (expander)), text);
+
+    g_free (text);
+    g_free (key);
+    g_free (preview);
+    g_object_unref (node);
+}
+
+static void request_json_tree_view_on_unbind (GtkSignalListItemFactory * factory, GtkListItem * list_item, gpointer user_data) {
+    (void) factory;
+    (void) user_data;
+
+    gtk_tree_expander_set_list_row (GTK_TREE_EXPANDER (gtk_list_item_get_child (list_item)), NULL);
+}
+
+static void request_json_tree_view_dispose (GObject * object) {
+    RequestJsonTreeView * self = REQUEST_JSON_TREE_VIEW (object);
+
+    g_clear_pointer (&self->scrolled_window, gtk_widget_unparent);
+
+    G_OBJECT_CLASS (request_json_tree_view_parent_class)->dispose (object);
+}
+
+static void request_json_tree_view_class_init (RequestJsonTreeViewClass * klass) {
+    G_OBJECT_CLASS (klass)->dispose = request_json_tree_view_dispose;
+
+    gtk_widget_class_set_layout_manager_type (GTK_WIDGET_CLASS (klass), GTK_TYPE_BIN_LAYOUT);
+}
+
+static void request_json_tree_view_init (RequestJsonTreeView * self) {
+    GtkListItemFactory * factory = gtk_signal_list_item_factory_new ();
+    g_signal_connect (factory, "setup", G_CALLBACK (request_json_tree_view_on_setup), NULL);
+    g_signal_connect (factory, "bind", G_CALLBACK (request_json_tree_view_on_bind), NULL);
+    g_signal_connect (factory, "unbind", G_CALLBACK (request_json_tree_view_on_unbind), NULL);
+
+    self->list_view = GTK_LIST_VIEW (gtk_list_view_new (NULL, factory));
+
+    self->scrolled_window = gtk_scrolled_window_new ();
+    gtk_scrolled_window_set_child (GTK_SCROLLED_WINDOW (self->scrolled_window), GTK_WIDGET (self->list_view));
+    gtk_widget_set_parent (self->scrolled_window, GTK_WIDGET (self));
+}
+
+RequestJsonTreeView * request_json_tree_view_new (void) {
+    return g_object_new (REQUEST_TYPE_JSON_TREE_VIEW, NULL);
+}
+
+/**
+ * Shows the document of index, or nothing when index is NULL. Only the root
+ * is listed, deeper levels are listed as they get expanded.
+ */
+void request_json_tree_view_set_index (RequestJsonTreeView * self, RequestJsonIndex * index) {
+    g_return_if_fail (REQUEST_IS_JSON_TREE_VIEW (self));
+
+    if (index == NULL) {
+        gtk_list_view_set_model (self->list_view, NULL);
+        return;
+    }
+
+    GListStore * roots = g_list_store_new (REQUEST_TYPE_JSON_NODE);
+    RequestJsonChild root = request_json_index_get_root (index);
+    RequestJsonNode * node = request_json_node_new (index, &root, 0);
+    g_list_store_append (roots, node);
+    g_object_unref (node);
+
+    // Takes ownership of roots
+    GtkTreeListModel * tree = gtk_tree_list_model_new (G_LIST_MODEL (roots), FALSE, FALSE, request_json_tree_view_create_children, NULL, NULL);
+    gtk_tree_list_model_set_autoexpand (tree, FALSE);
+
+    // The root is expanded
+    GtkTreeListRow * row = gtk_tree_list_model_get_row (tree, 0);
+    if (row != NULL) {
+        gtk_tree_list_row_set_expanded (row, TRUE);
+        g_object_unref (row);
+    }
+
+    // Takes ownership of tree
+    GtkSelectionModel * selection = GTK_SELECTION_MODEL (gtk_no_selection_new (G_LIST_MODEL (tree)));
+    gtk_list_view_set_model (self->list_view, selection);
+    g_object_unref (selection);
+}
@@ -0,0 +1,33 @@
+/* request-json-tree-view.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gtk-4.0/gtk/gtk.h>
+
+#include "request-json-index.h"
+
+G_BEGIN_DECLS
+
+#define REQUEST_TYPE_JSON_TREE_VIEW (request_json_tree_view_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestJsonTreeView, request_json_tree_view, REQUEST, JSON_TREE_VIEW, GtkWidget)
+
+RequestJsonTreeView * request_json_tree_view_new (void);
+void request_json_tree_view_set_index (RequestJsonTreeView * self, RequestJsonIndex * index);
+
+G_END_DECLS
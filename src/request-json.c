@@ -0,0 +1,549 @@
+/* request-json.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gio/gio.h>
+#include <string.h>
+
+#include "request-json.h"
+#include "request-scan.h"
+
+G_DEFINE_QUARK (request-json-error-quark, request_json_error)
+
+#define FORMAT_INDENT 4
+
+// Cancellation is checked between chunks of that size
+#define FORMAT_CHUNK_SIZE (4 * 1024 * 1024)
+
+typedef enum RequestJsonExpect {
+    EXPECT_VALUE,
+    EXPECT_FIRST_VALUE, // after [
+    EXPECT_KEY,
+    EXPECT_FIRST_KEY, // after {
+    EXPECT_COLON,
+    EXPECT_SEPARATOR, // , or closing bracket
+    EXPECT_NOTHING, // document is complete
+} RequestJsonExpect;
+
+typedef enum RequestJsonToken {
+    TOKEN_NONE,
+    TOKEN_STRING,
+    TOKEN_ESCAPE,
+    TOKEN_UNICODE,
+    TOKEN_LITERAL,
+    TOKEN_NUMBER,
+} RequestJsonToken;
+
+typedef enum RequestJsonNumberState {
+    NUMBER_MINUS,
+    NUMBER_ZERO,
+    NUMBER_INTEGER,
+    NUMBER_DOT,
+    NUMBER_FRACTION,
+    NUMBER_E,
+    NUMBER_E_SIGN,
+    NUMBER_EXPONENT,
+} RequestJsonNumberState;
+
+/**
+ * Token-level JSON formatter.
+ *
+ * The document is validated and rewritten in a single pass as it is fed,
+ * tokens are copied as they were written (object keys keep their order,
+ * strings and numbers their exact spelling) and only whitespace is changed.
+ * Memory use only depends on the nesting depth, a token may span several
+ * chunks.
+ *
+ * It doesn't touch any widget so it can safely run on a worker thread.
+ */
+struct _RequestJsonFormatter {
+    RequestJsonFormat format;
+    GByteArray * stack; // { or [ of the open containers
+    RequestJsonExpect expect;
+    RequestJsonToken token;
+    RequestJsonNumberState number_state;
+    gboolean is_key;
+    const gchar * literal;
+    guint literal_position;
+    guint unicode_digits; // left to read
+
+    // For error messages
+    guint64 offset;
+    guint64 line;
+    guint64 line_start;
+};
+
+static const gchar request_json_spaces[] = "                                ";
+
+RequestJsonFormatter * request_json_formatter_new (RequestJsonFormat format) {
+    RequestJsonFormatter * self = g_new0 (RequestJsonFormatter, 1);
+    self->format = format;
+    self->stack = g_byte_array_new ();
+    self->expect = EXPECT_VALUE;
+    self->token = TOKEN_NONE;
+    self->line = 1;
+
+    return self;
+}
+
+void request_json_formatter_free (RequestJsonFormatter * self) {
+    g_return_if_fail (self != NULL);
+
+    g_byte_array_unref (self->stack);
+    g_free (self);
+}
+
+static gboolean request_json_formatter_fail (RequestJsonFormatter * self, gsize position, const gchar * message, GError ** error) {
+    guint64 offset = self->offset + position;
+
+    g_set_error (error, REQUEST_JSON_ERROR, REQUEST_JSON_ERROR_INVALID, "Invalid JSON at line %" G_GUINT64_FORMAT ", column %" G_GUINT64_FORMAT ": %s", self->line, offset - self->line_start + 1, message); // FIXME: Handle translations
+
+    return FALSE;
+}
+
+static inline void request_json_formatter_emit (GString * out, const gchar * data, gsize length) {
+    if (out != NULL) {
+        g_string_append_len (out, data, length);
+    }
+}
+
+static inline void request_json_formatter_emit_c (GString * out, gchar c) {
+    if (out != NULL) {
+        g_string_append_c (out, c);
+    }
+}
+
+/**
+ * Starts a new line indented for the current depth when beautifying.
+ */
+static void request_json_formatter_newline (RequestJsonFormatter * self, GString * out) {
+    if (out == NULL || self->format != JSON_FORMAT_BEAUTIFY) {
+        return;
+    }
+
+    g_string_append_c (out, '\n');
+
+    gsize indent = (gsize) self->stack->len * FORMAT_INDENT;
+    while (indent > 0) {
+        gsize length = MIN (indent, sizeof (request_json_spaces) - 1);
+        g_string_append_len (out, request_json_spaces, length);
+        indent -= length;
+    }
+}
+
+static void request_json_formatter_value_done (RequestJsonFormatter * self) {
+    self->token = TOKEN_NONE;
+    self->expect = self->stack->len > 0 ? EXPECT_SEPARATOR : EXPECT_NOTHING;
+}
+
+static gboolean request_json_formatter_close (RequestJsonFormatter * self, gchar c, gsize position, GString * out, GError ** error) {
+    guint8 open = self->stack->len > 0 ? self->stack->data[self->stack->len - 1] : 0;
+    if ((c == '}' && open != '{') || (c == ']' && open != '[')) {
+        return request_json_formatter_fail (self, position, "mismatched brackets", error);
+    }
+
+    g_byte_array_set_size (self->stack, self->stack->len - 1);
+
+    // Empty containers stay on one line
+    if (self->expect == EXPECT_SEPARATOR) {
+        request_json_formatter_newline (self, out);
+    }
+
+    request_json_formatter_emit_c (out, c);
+    request_json_formatter_value_done (self);
+
+    return TRUE;
+}
+
+static gboolean request_json_formatter_begin_value (RequestJsonFormatter * self, gchar c, gsize position, GString * out, GError ** error) {
+    switch (c) {
+        case '{':
+        case '[':
+            g_byte_array_append (self->stack, (const guint8 *) &c, 1);
+            self->expect = c == '{' ? EXPECT_FIRST_KEY : EXPECT_FIRST_VALUE;
+            break;
+        case '"':
+            self->token = TOKEN_STRING;
+            self->is_key = FALSE;
+            break;
+        case 't':
+            self->literal = "true";
+            break;
+        case 'f':
+            self->literal = "false";
+            break;
+        case 'n':
+            self->literal = "null";
+            break;
+        case '-':
+            self->token = TOKEN_NUMBER;
+            self->number_state = NUMBER_MINUS;
+            break;
+        case '0':
+            self->token = TOKEN_NUMBER;
+            self->number_state = NUMBER_ZERO;
+            break;
+        default:
+            if (c < '1' || c > '9') {
+                return request_json_formatter_fail (self, position, "unexpected character", error);
+            }
+
+            self->token = TOKEN_NUMBER;
+            self->number_state = NUMBER_INTEGER;
+            break;
+    }
+
+    if (c == 't' || c == 'f' || c == 'n') {
+        self->token = TOKEN_LITERAL;
+        self->literal_position = 1;
+    }
+
+    request_json_formatter_emit_c (out, c);
+
+    return TRUE;
+}
+
+/**
+ * Handles c outside of any token.
+ */
+static gboolean request_json_formatter_structure (RequestJsonFormatter * self, gchar c, gsize position, GString * out, GError ** error) {
+    switch (self->expect) {
+        case EXPECT_NOTHING:
+            return request_json_formatter_fail (self, position, "unexpected data after the document", error);
+
+        case EXPECT_COLON:
+            if (c != ':') {
+                return request_json_formatter_fail (self, position, "expected ':'", error);
+            }
+
+            request_json_formatter_emit (out, ": ", self->format == JSON_FORMAT_BEAUTIFY ? 2 : 1);
+            self->expect = EXPECT_VALUE;
+            return TRUE;
+
+        case EXPECT_SEPARATOR:
+            if (c == '}' || c == ']') {
+                return request_json_formatter_close (self, c, position, out, error);
+            }
+
+            if (c != ',') {
+                return request_json_formatter_fail (self, position, "expected ',' or a closing bracket", error);
+            }
+
+            request_json_formatter_emit_c (out, ',');
+            request_json_formatter_newline (self, out);
+            self->expect = self->stack->data[self->stack->len - 1] == '{' ? EXPECT_KEY : EXPECT_VALUE;
+            return TRUE;
+
+        case EXPECT_FIRST_KEY:
+            if (c == '}') {
+                return request_json_formatter_close (self, c, position, out, error);
+            }
+
+            request_json_formatter_newline (self, out);
+            // fallthrough
+        case EXPECT_KEY:
+            if (c != '"') {
+                return request_json_formatter_fail (self, position, "expected a string key", error);
+            }
+
+            request_json_formatter_emit_c (out, c);
+            self->token = TOKEN_STRING;
+            self->is_key = TRUE;
+            return TRUE;
+
+        case EXPECT_FIRST_VALUE:
+            if (c == ']') {
+                return request_json_formatter_close (self, c, position, out, error);
+            }
+
+            request_json_formatter_newline (self, out);
+            // fallthrough
+        case EXPECT_VALUE:
+            return request_json_formatter_begin_value (self, c, position, out, error);
+    }
+
+    return TRUE;
+}
+
+/**
+ * Advances the number being read with c. Returns FALSE once c is not part of
+ * it anymore, c must then be handled as structure.
+ */
+static gboolean request_json_formatter_number (RequestJsonFormatter * self, gchar c) {
+    gboolean is_digit = c >= '0' && c <= '9';
+    gboolean is_exponent = c == 'e' || c == 'E';
+
+    switch (self->number_state) {
+        case NUMBER_MINUS:
+            if (c == '0') {
+                self->number_state = NUMBER_ZERO;
+            } else if (is_digit) {
+                self->number_state = NUMBER_INTEGER;
+            } else {
+                return FALSE;
+            }
+            return TRUE;
+        case NUMBER_ZERO:
+        case NUMBER_INTEGER:
+            if (is_digit && self->number_state == NUMBER_INTEGER) {
+                return TRUE;
+            }
+            if (c == '.') {
+                self->number_state = NUMBER_DOT;
+                return TRUE;
+            }
+            if (is_exponent) {
+                self->number_state = NUMBER_E;
+                return TRUE;
+            }
+            return FALSE;
+        case NUMBER_DOT:
+        case NUMBER_FRACTION:
+            if (is_digit) {
+                self->number_state = NUMBER_FRACTION;
+                return TRUE;
+            }
+            if (is_exponent && self->number_state == NUMBER_FRACTION) {
+                self->number_state = NUMBER_E;
+                return TRUE;
+            }
+            return FALSE;
+        case NUMBER_E:
+            if (c == '+' || c == '-') {
+                self->number_state = NUMBER_E_SIGN;
+                return TRUE;
+            }
+            // fallthrough
+        case NUMBER_E_SIGN:
+        case NUMBER_EXPONENT:
+            if (is_digit) {
+                self->number_state = NUMBER_EXPONENT;
+                return TRUE;
+            }
+            return FALSE;
+    }
+
+    return FALSE;
+}
+
+static gboolean request_json_formatter_number_is_complete (RequestJsonFormatter * self) {
+    return self->number_state == NUMBER_ZERO || self->number_state == NUMBER_INTEGER
+        || self->number_state == NUMBER_FRACTION || self->number_state == NUMBER_EXPONENT;
+}
+
+/**
+ * Validates the next length bytes of the document and appends them, formatted,
+ * to out (nothing is written when out is NULL). The formatter can't be used
+ * anymore once it failed.
+ */
+gboolean request_json_formatter_feed (RequestJsonFormatter * self, const gchar * data, gsize length, GString * out, GError ** error) {
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    if (self->format == JSON_FORMAT_VALIDATE) {
+        out = NULL;
+    }
+
+    gsize i = 0;
+    while (i < length) {
+        gchar c = data[i];
+
+        switch (self->token) {
+            case TOKEN_STRING: {
+                // Copy everything up to the next quote, escape or control character at once
+                gsize start = i;
+                i += request_scan_string ((const guint8 *) data + i, length - i);
+
+                request_json_formatter_emit (out, data + start, i - start);
+                if (i == length) {
+                    continue;
+                }
+
+                c = data[i];
+                if (c == '"') {
+                    self->token = TOKEN_NONE;
+                    if (self->is_key) {
+                        self->expect = EXPECT_COLON;
+                    } else {
+                        request_json_formatter_value_done (self);
+                    }
+                } else if (c == '\\') {
+                    self->token = TOKEN_ESCAPE;
+                } else {
+                    return request_json_formatter_fail (self, i, "control character in string", error);
+                }
+
+                request_json_formatter_emit_c (out, c);
+                i++;
+                continue;
+            }
+
+            case TOKEN_ESCAPE:
+                if (c == 'u') {
+                    self->token = TOKEN_UNICODE;
+                    self->unicode_digits = 4;
+                } else if (strchr ("\"\\/bfnrt", c) != NULL && c != '\0') {
+                    self->token = TOKEN_STRING;
+                } else {
+                    return request_json_formatter_fail (self, i, "invalid escape sequence", error);
+                }
+
+                request_json_formatter_emit_c (out, c);
+                i++;
+                continue;
+
+            case TOKEN_UNICODE:
+                if (!g_ascii_isxdigit (c)) {
+                    return request_json_formatter_fail (self, i, "invalid escape sequence", error);
+                }
+
+                if (--self->unicode_digits == 0) {
+                    self->token = TOKEN_STRING;
+                }
+
+                request_json_formatter_emit_c (out, c);
+                i++;
+                continue;
+
+            case TOKEN_LITERAL:
+                if (c != self->literal[self->literal_position]) {
+                    return request_json_formatter_fail (self, i, "invalid literal", error);
+                }
+
+                if (self->literal[++self->literal_position] == '\0') {
+                    request_json_formatter_value_done (self);
+                }
+
+                request_json_formatter_emit_c (out, c);
+                i++;
+                continue;
+
+            case TOKEN_NUMBER:
+                if (request_json_formatter_number (self, c)) {
+                    request_json_formatter_emit_c (out, c);
+                    i++;
+                    continue;
+                }
+
+                if (!request_json_formatter_number_is_complete (self)) {
+                    return request_json_formatter_fail (self, i, "invalid number", error);
+                }
+
+                // c ends the number, it is handled below
+                request_json_formatter_value_done (self);
+                break;
+
+            case TOKEN_NONE:
+                break;
+        }
+
+        if (c == ' ' || c == '\n' || c == '\t' || c == '\r') {
+            gsize n_newlines = 0;
+            gsize line_start = 0;
+            gsize end = i + request_scan_whitespace ((const guint8 *) data + i, length - i, &n_newlines, &line_start);
+
+            if (n_newlines > 0) {
+                self->line += n_newlines;
+                self->line_start = self->offset + i + line_start;
+            }
+
+            i = end;
+            continue;
+        }
+
+        if (!request_json_formatter_structure (self, c, i, out, error)) {
+            return FALSE;
+        }
+
+        i++;
+    }
+
+    self->offset += length;
+
+    return TRUE;
+}
+
+/**
+ * Checks that the document fed so far is complete.
+ */
+gboolean request_json_formatter_finish (RequestJsonFormatter * self, GString * out, GError ** error) {
+    g_return_val_if_fail (self != NULL, FALSE);
+    (void) out; // nothing is held back, kept for symmetry with feed
+
+    if (self->token == TOKEN_NUMBER && request_json_formatter_number_is_complete (self)) {
+        request_json_formatter_value_done (self);
+    }
+
+    if (self->token != TOKEN_NONE || self->expect != EXPECT_NOTHING) {
+        return request_json_formatter_fail (self, 0, "unexpected end of document", error);
+    }
+
+    return TRUE;
+}
+
+static gboolean request_json_run (const gchar * text, gsize length, RequestJsonFormat format, GCancellable * cancellable, GString * out, GError ** error) {
+    RequestJsonFormatter * formatter = request_json_formatter_new (format);
+    gboolean is_valid = TRUE;
+
+    for (gsize offset = 0; offset < length && is_valid; offset += FORMAT_CHUNK_SIZE) {
+        if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+            is_valid = FALSE;
+            break;
+        }
+
+        is_valid = request_json_formatter_feed (formatter, text + offset, MIN (length - offset, FORMAT_CHUNK_SIZE), out, error);
+    }
+
+    if (is_valid) {
+        is_valid = request_json_formatter_finish (formatter, out, error);
+    }
+
+    request_json_formatter_free (formatter);
+
+    return is_valid;
+}
+
+/**
+ * Formats the length bytes of text (up to the first nul when length is -1).
+ */
+gchar * request_json_format (const gchar * text, gssize length, RequestJsonFormat format, GCancellable * cancellable, GError ** error) {
+    g_return_val_if_fail (text != NULL, NULL);
+
+    gsize text_length = length < 0 ? strlen (text) : (gsize) length;
+
+    // Beautified documents usually end up about twice as large
+    GString * out = g_string_sized_new (format == JSON_FORMAT_BEAUTIFY ? text_length * 2 : text_length + 1);
+
+    if (!request_json_run (text, text_length, format, cancellable, out, error)) {
+        g_string_free (out, TRUE);
+        return NULL;
+    }
+
+    return g_string_free (out, FALSE);
+}
+
+gboolean request_json_validate (const gchar * text, gssize length, GError ** error) {
+    g_return_val_if_fail (text != NULL, FALSE);
+
+    return request_json_run (text, length < 0 ? strlen (text) : (gsize) length, JSON_FORMAT_VALIDATE, NULL, NULL, error);
+}
+
+gchar * request_json_beautify (const gchar * text, GError ** error) {
+    return request_json_format (text, -1, JSON_FORMAT_BEAUTIFY, NULL, error);
+}
+
+gchar * request_json_minify (const gchar * text, GError ** error) {
+    return request_json_format (text, -1, JSON_FORMAT_MINIFY, NULL, error);
+}
@@ -0,0 +1,48 @@
+/* request-json.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define REQUEST_JSON_ERROR (request_json_error_quark ())
+
+typedef enum RequestJsonError {
+    REQUEST_JSON_ERROR_INVALID,
+} RequestJsonError;
+
+typedef enum RequestJsonFormat {
+    JSON_FORMAT_BEAUTIFY,
+    JSON_FORMAT_MINIFY,
+    JSON_FORMAT_VALIDATE,
+} RequestJsonFormat;
+
+typedef struct _RequestJsonFormatter RequestJsonFormatter;
+
+GQuark request_json_error_quark (void);
+RequestJsonFormatter * request_json_formatter_new (RequestJsonFormat format);
+void request_json_formatter_free (RequestJsonFormatter * self);
+gboolean request_json_formatter_feed (RequestJsonFormatter * self, const gchar * data, gsize length, GString * out, GError ** error);
+gboolean request_json_formatter_finish (RequestJsonFormatter * self, GString * out, GError ** error);
+gchar * request_json_format (const gchar * text, gssize length, RequestJsonFormat format, GCancellable * cancellable, GError ** error);
+gboolean request_json_validate (const gchar * text, gssize length, GError ** error);
+gchar * request_json_beautify (const gchar * text, GError ** error);
+gchar * request_json_minify (const gchar * text, GError ** error);
+
+G_END_DECLS
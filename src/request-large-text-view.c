@@ -0,0 +1,619 @@
+/* request-large-text-view.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <gtk-4.0/gtk/gtk.h>
+
+#include "request-large-text-view.h"
+
+// Offset of one line out of INDEX_STRIDE is kept, the others are found by
+// scanning forward from the closest one. This keeps the index small enough for
+// bodies with hundreds of millions of lines.
+#define INDEX_STRIDE 64
+
+// Longer lines are displayed as several lines, minified payloads are often a
+// single line of hundreds of MB.
+#define MAX_LINE_LENGTH 4096
+
+// Amount of body indexed between two updates of the view
+#define INDEX_BATCH_SIZE (16 * 1024 * 1024)
+
+/**
+ * Read-only viewer for bodies too large for GtkTextView.
+ *
+ * The body stays where RequestBodyStore put it (memory or a mapped file), a
+ * line index is built on a worker thread and only the visible lines are ever
+ * decoded and laid out.
+ */
+struct _RequestLargeTextView {
+    GtkWidget parent_instance;
+
+    GtkAdjustment * hadjustment;
+    GtkAdjustment * vadjustment;
+    guint hscroll_policy : 1;
+    guint vscroll_policy : 1;
+
+    GBytes * bytes;
+    const guint8 * data;
+    gsize length;
+    gchar * charset;
+    gboolean is_utf8;
+
+    GArray * checkpoints; // guint64 offset of every INDEX_STRIDE-th line
+    guint64 n_lines;
+    gsize max_line_length;
+    GCancellable * index_cancellable;
+
+    gint line_height;
+    gint char_width;
+
+    // Highlighted range, e.g. a search match
+    gboolean has_selection;
+    guint64 selection_start;
+    guint64 selection_end;
+};
+
+enum {
+    PROP_0,
+    PROP_HADJUSTMENT,
+    PROP_VADJUSTMENT,
+    PROP_HSCROLL_POLICY,
+    PROP_VSCROLL_POLICY,
+};
+
+typedef struct RequestLargeTextViewBatch {
+    RequestLargeTextView * view;
+    GCancellable * cancellable;
+    GArray * checkpoints;
+    guint64 n_lines;
+    gsize max_line_length;
+} RequestLargeTextViewBatch;
+
+G_DEFINE_TYPE_WITH_CODE (RequestLargeTextView, request_large_text_view, GTK_TYPE_WIDGET, G_IMPLEMENT_INTERFACE (GTK_TYPE_SCROLLABLE, NULL));
+
+/**
+ * Returns the offset of the line following the one starting at offset. Both
+ * the indexer and the renderer split lines through here so they always agree.
+ */
+static gsize request_large_text_view_next_line (const guint8 * data, gsize length, gsize offset) {
+    gsize limit = MIN (length - offset, (gsize) MAX_LINE_LENGTH);
+
+    const guint8 * newline = memchr (data + offset, '\n', limit);
+    if (newline != NULL) {
+        return newline - data + 1;
+    }
+
+    if (offset + limit >= length) {
+        return length;
+    }
+
+    // Don't split a UTF-8 sequence in two
+    gsize end = offset + limit;
+    while (end > offset + 1 && (data[end] & 0xC0) == 0x80) {
+        end--;
+    }
+
+    return end;
+}
+
+static void request_large_text_view_batch_free (RequestLargeTextViewBatch * batch) {
+    g_object_unref (batch->view);
+    g_object_unref (batch->cancellable);
+    g_array_unref (batch->checkpoints);
+    g_free (batch);
+}
+
+static void request_large_text_view_update_adjustments (RequestLargeTextView * self);
+
+static gboolean request_large_text_view_on_batch (gpointer data) {
+    RequestLargeTextViewBatch * batch = data;
+    RequestLargeTextView * self = batch->view;
+
+    if (g_cancellable_is_cancelled (batch->cancellable)) { // body was replaced
+        return G_SOURCE_REMOVE;
+    }
+
+    g_array_append_vals (self->checkpoints, batch->checkpoints->data, batch->checkpoints->len);
+    self->n_lines = batch->n_lines;
+    self->max_line_length = MAX (self->max_line_length, batch->max_line_length);
+
+    request_large_text_view_update_adjustments (self);
+    gtk_widget_queue_draw (GTK_WIDGET (self));
+
+    return G_SOURCE_REMOVE;
+}
+
+static void request_large_text_view_publish_batch (RequestLargeTextView * self, GCancellable * cancellable, GArray * checkpoints, guint64 n_lines, gsize max_line_length) {
+    RequestLargeTextViewBatch * batch = g_new0 (RequestLargeTextViewBatch, 1);
+    batch->view = g_object_ref (self);
+    batch->cancellable = g_object_ref (cancellable);
+    batch->checkpoints = checkpoints;
+    batch->n_lines = n_lines;
+    batch->max_line_length = max_line_length;
+
+    g_main_context_invoke_full (NULL, G_PRIORITY_DEFAULT_IDLE, request_large_text_view_on_batch, batch, (GDestroyNotify) request_large_text_view_batch_free);
+}
+
+static void request_large_text_view_index_thread (GTask * task, gpointer source_object, gpointer task_data, GCancellable * cancellable) {
+    RequestLargeTextView * self = source_object;
+    GBytes * bytes = task_data;
+    gsize length;
+    const guint8 * data = g_bytes_get_data (bytes, &length);
+
+    GArray * checkpoints = g_array_new (FALSE, FALSE, sizeof (guint64));
+    gsize max_line_length = 0;
+    gsize next_batch = INDEX_BATCH_SIZE;
+    guint64 line = 0;
+    gsize offset = 0;
+
+    while (offset < length) {
+        if (line % INDEX_STRIDE == 0) {
+            guint64 checkpoint = offset;
+            g_array_append_val (checkpoints, checkpoint);
+        }
+
+        gsize next = request_large_text_view_next_line (data, length, offset);
+        max_line_length = MAX (max_line_length, next - offset);
+        offset = next;
+        line++;
+
+        // Let the first lines show up while the rest is indexed
+        if (offset >= next_batch) {
+            if (g_cancellable_is_cancelled (cancellable)) {
+                g_array_unref (checkpoints);
+                g_task_return_boolean (task, FALSE);
+                return;
+            }
+
+            request_large_text_view_publish_batch (self, cancellable, checkpoints, line, max_line_length);
+            checkpoints = g_array_new (FALSE, FALSE, sizeof (guint64));
+            next_batch = offset + INDEX_BATCH_SIZE;
+        }
+    }
+
+    request_large_text_view_publish_batch (self, cancellable, checkpoints, line, max_line_length);
+    g_task_return_boolean (task, TRUE);
+}
+
+static gsize request_large_text_view_get_line_offset (RequestLargeTextView * self, guint64 line) {
+    guint64 checkpoint = line / INDEX_STRIDE;
+    g_return_val_if_fail (checkpoint < self->checkpoints->len, 0);
+
+    gsize offset = g_array_index (self->checkpoints, guint64, checkpoint);
+    for (guint64 i = checkpoint * INDEX_STRIDE; i < line; i++) {
+        offset = request_large_text_view_next_line (self->data, self->length, offset);
+    }
+
+    return offset;
+}
+
+/**
+ * Returns the line containing offset and stores where it starts in
+ * line_offset.
+ */
+static guint64 request_large_text_view_get_line_at_offset (RequestLargeTextView * self, gsize offset, gsize * line_offset) {
+    g_return_val_if_fail (self->checkpoints->len > 0, 0);
+
+    // Last checkpoint at or before offset
+    guint low = 0;
+    guint high = self->checkpoints->len;
+    while (high - low > 1) {
+        guint middle = low + (high - low) / 2;
+        if (g_array_index (self->checkpoints, guint64, middle) <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    guint64 line = (guint64) low * INDEX_STRIDE;
+    gsize start = g_array_index (self->checkpoints, guint64, low);
+
+    for (;;) {
+        gsize next = request_large_text_view_next_line (self->data, self->length, start);
+        if (next > offset || next >= self->length) {
+            break;
+        }
+
+        start = next;
+        line++;
+    }
+
+    *line_offset = start;
+
+    return line;
+}
+
+/**
+ * Returns how many columns the bytes between start and end take.
+ */
+static gsize request_large_text_view_count_columns (RequestLargeTextView * self, gsize start, gsize end) {
+    if (self->is_utf8) {
+        return g_utf8_strlen ((const gchar *) self->data + start, end - start);
+    }
+
+    return end - start;
+}
+
+static gchar * request_large_text_view_get_line_text (RequestLargeTextView * self, gsize start, gsize end) {
+    while (end > start && (self->data[end - 1] == '\n' || self->data[end - 1] == '\r')) {
+        end--;
+    }
+
+    const gchar * line = (const gchar *) self->data + start;
+
+    if (!self->is_utf8) {
+        gchar * text = g_convert_with_fallback (line, end - start, "UTF-8", self->charset, "?", NULL, NULL, NULL);
+        if (text != NULL) {
+            return text;
+        }
+    }
+
+    return g_utf8_make_valid (line, end - start);
+}
+
+static void request_large_text_view_measure_font (RequestLargeTextView * self) {
+    PangoLayout * layout = gtk_widget_create_pango_layout (GTK_WIDGET (self), "0");
+    pango_layout_get_pixel_size (layout, &self->char_width, &self->line_height);
+    g_object_unref (layout);
+
+    self->char_width = MAX (self->char_width, 1);
+    self->line_height = MAX (self->line_height, 1);
+}
+
+static gint request_large_text_view_get_gutter_width (RequestLargeTextView * self) {
+    gint digits = 1;
+    for (guint64 n = self->n_lines; n >= 10; n /= 10) {
+        digits++;
+    }
+
+    return (digits + 2) * self->char_width;
+}
+
+static void request_large_text_view_update_adjustments (RequestLargeTextView * self) {
+    gint width = gtk_widget_get_width (GTK_WIDGET (self));
+    gint height = gtk_widget_get_height (GTK_WIDGET (self));
+
+    if (self->vadjustment != NULL) {
+        gdouble upper = (gdouble) self->n_lines * self->line_height;
+        gdouble value = MIN (gtk_adjustment_get_value (self->vadjustment), MAX (upper - height, 0));
+
+        gtk_adjustment_configure (self->vadjustment, value, 0, MAX (upper, height), self->line_height, height * 0.9, height);
+    }
+
+    if (self->hadjustment != NULL) {
+        gint text_width = request_large_text_view_get_gutter_width (self) + (gint) self->max_line_length * self->char_width;
+        gdouble value = MIN (gtk_adjustment_get_value (self->hadjustment), MAX (text_width - width, 0));
+
+        gtk_adjustment_configure (self->hadjustment, value, 0, MAX (text_width, width), self->char_width, width * 0.9, width);
+    }
+}
+
+static void request_large_text_view_on_adjustment_changed (GtkAdjustment * adjustment, gpointer data) {
+    (void) adjustment;
+    RequestLargeTextView * self = data;
+
+    gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+static void request_large_text_view_set_adjustment (RequestLargeTextView * self, GtkAdjustment ** target, GtkAdjustment * adjustment) {
+    if (*target == adjustment) {
+        return;
+    }
+
+    if (*target != NULL) {
+        g_signal_handlers_disconnect_by_func (*target, request_large_text_view_on_adjustment_changed, self);
+        g_object_unref (*target);
+    }
+
+    if (adjustment == NULL) {
+        adjustment = gtk_adjustment_new (0, 0, 0, 0, 0, 0);
+    }
+
+    *target = g_object_ref_sink (adjustment);
+    g_signal_connect (adjustment, "value-changed", G_CALLBACK (request_large_text_view_on_adjustment_changed), self);
+
+    request_large_text_view_update_adjustments (self);
+}
+
+static void request_large_text_view_snapshot (GtkWidget * widget, GtkSnapshot * snapshot) {
+    RequestLargeTextView * self = REQUEST_LARGE_TEXT_VIEW (widget);
+    gint width = gtk_widget_get_width (widget);
+    gint height = gtk_widget_get_height (widget);
+
+    if (self->n_lines == 0 || self->checkpoints->len == 0) {
+        return;
+    }
+
+    GdkRGBA color;
+    gtk_style_context_get_color (gtk_widget_get_style_context (widget), &color);
+    GdkRGBA gutter_color = color;
+    gutter_color.alpha *= 0.5;
+    GdkRGBA selection_color = { 0.96, 0.76, 0.07, 0.5 };
+
+    gdouble vvalue = self->vadjustment != NULL ? gtk_adjustment_get_value (self->vadjustment) : 0;
+    gdouble hvalue = self->hadjustment != NULL ? gtk_adjustment_get_value (self->hadjustment) : 0;
+    gint gutter_width = request_large_text_view_get_gutter_width (self);
+
+    guint64 line = (guint64) (vvalue / self->line_height);
+    gdouble y = line * (gdouble) self->line_height - vvalue;
+
+    if (line >= self->n_lines) {
+        return;
+    }
+
+    PangoLayout * layout = gtk_widget_create_pango_layout (widget, NULL);
+    gsize offset = request_large_text_view_get_line_offset (self, line);
+
+    for (; line < self->n_lines && y < height; line++, y += self->line_height) {
+        gsize end = request_large_text_view_next_line (self->data, self->length, offset);
+        gchar * text = request_large_text_view_get_line_text (self, offset, end);
+        gchar number[32];
+
+        pango_layout_set_text (layout, text, -1);
+        gtk_snapshot_push_clip (snapshot, &GRAPHENE_RECT_INIT (gutter_width, 0, MAX (width - gutter_width, 0), height));
+
+        if (self->has_selection && self->selection_start < end && self->selection_end > offset) {
+            gsize start_column = request_large_text_view_count_columns (self, offset, MAX (self->selection_start, offset));
+            gsize n_columns = request_large_text_view_count_columns (self, MAX (self->selection_start, offset), MIN (self->selection_end, end));
+            gdouble x = gutter_width - hvalue + (gdouble) start_column * self->char_width;
+
+            gtk_snapshot_append_color (snapshot, &selection_color, &GRAPHENE_RECT_INIT (x, y, MAX (n_columns, 1) * self->char_width, self->line_height));
+        }
+
+        gtk_snapshot_save (snapshot);
+        gtk_snapshot_translate (snapshot, &GRAPHENE_POINT_INIT (gutter_width - hvalue, y));
+        gtk_snapshot_append_layout (snapshot, layout, &color);
+        gtk_snapshot_restore (snapshot);
+        gtk_snapshot_pop (snapshot);
+
+        g_snprintf (number, sizeof (number), "%" G_GUINT64_FORMAT, line + 1);
+        pango_layout_set_text (layout, number, -1);
+        gtk_snapshot_save (snapshot);
+        gtk_snapshot_translate (snapshot, &GRAPHENE_POINT_INIT (self->char_width, y));
+        gtk_snapshot_append_layout (snapshot, layout, &gutter_color);
+        gtk_snapshot_restore (snapshot);
+
+        g_free (text);
+        offset = end;
+    }
+
+    g_object_unref (layout);
+}
+
+static void request_large_text_view_size_allocate (GtkWidget * widget, int width, int height, int baseline) {
+    (void) width;
+    (void) height;
+    (void) baseline;
+    RequestLargeTextView * self = REQUEST_LARGE_TEXT_VIEW (widget);
+
+    request_large_text_view_update_adjustments (self);
+}
+
+static void request_large_text_view_css_changed (GtkWidget * widget, GtkCssStyleChange * change) {
+    RequestLargeTextView * self = REQUEST_LARGE_TEXT_VIEW (widget);
+
+    GTK_WIDGET_CLASS (request_large_text_view_parent_class)->css_changed (widget, change);
+
+    request_large_text_view_measure_font (self);
+    request_large_text_view_update_adjustments (self);
+}
+
+static void request_large_text_view_get_property (GObject * object, guint prop_id, GValue * value, GParamSpec * pspec) {
+    RequestLargeTextView * self = REQUEST_LARGE_TEXT_VIEW (object);
+
+    switch (prop_id) {
+        case PROP_HADJUSTMENT:
+            g_value_set_object (value, self->hadjustment);
+            break;
+        case PROP_VADJUSTMENT:
+            g_value_set_object (value, self->vadjustment);
+            break;
+        case PROP_HSCROLL_POLICY:
+            g_value_set_enum (value, self->hscroll_policy);
+            break;
+        case PROP_VSCROLL_POLICY:
+            g_value_set_enum (value, self->vscroll_policy);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+}
+
+static void request_large_text_view_set_property (GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec) {
+    RequestLargeTextView * self = REQUEST_LARGE_TEXT_VIEW (object);
+
+    switch (prop_id) {
+        case PROP_HADJUSTMENT:
+            request_large_text_view_set_adjustment (self, &self->hadjustment, g_value_get_object (value));
+            break;
+        case PROP_VADJUSTMENT:
+            request_large_text_view_set_adjustment (self, &self->vadjustment, g_value_get_object (value));
+            break;
+        case PROP_HSCROLL_POLICY:
+            self->hscroll_policy = g_value_get_enum (value);
+            gtk_widget_queue_resize (GTK_WIDGET (self));
+            break;
+        case PROP_VSCROLL_POLICY:
+            self->vscroll_policy = g_value_get_enum (value);
+            gtk_widget_queue_resize (GTK_WIDGET (self));
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+}
+
+static void request_large_text_view_dispose (GObject * object) {
+    RequestLargeTextView * self = REQUEST_LARGE_TEXT_VIEW (object);
+
+    request_large_text_view_clear (self);
+
+    if (self->hadjustment != NULL) {
+        g_signal_handlers_disconnect_by_func (self->hadjustment, request_large_text_view_on_adjustment_changed, self);
+        g_clear_object (&self->hadjustment);
+    }
+
+    if (self->vadjustment != NULL) {
+        g_signal_handlers_disconnect_by_func (self->vadjustment, request_large_text_view_on_adjustment_changed, self);
+        g_clear_object (&self->vadjustment);
+    }
+
+    G_OBJECT_CLASS (request_large_text_view_parent_class)->dispose (object);
+}
+
+static void request_large_text_view_finalize (GObject * object) {
+    RequestLargeTextView * self = REQUEST_LARGE_TEXT_VIEW (object);
+
+    g_array_unref (self->checkpoints);
+
+    G_OBJECT_CLASS (request_large_text_view_parent_class)->finalize (object);
+}
+
+static void request_large_text_view_class_init (RequestLargeTextViewClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
+    GtkWidgetClass * widget_class = GTK_WIDGET_CLASS (klass);
+
+    object_class->dispose = request_large_text_view_dispose;
+    object_class->finalize = request_large_text_view_finalize;
+    object_class->get_property = request_large_text_view_get_property;
+    object_class->set_property = request_large_text_view_set_property;
+
+    widget_class->snapshot = request_large_text_view_snapshot;
+    widget_class->size_allocate = request_large_text_view_size_allocate;
+    widget_class->css_changed = request_large_text_view_css_changed;
+
+    g_object_class_override_property (object_class, PROP_HADJUSTMENT, "hadjustment");
+    g_object_class_override_property (object_class, PROP_VADJUSTMENT, "vadjustment");
+    g_object_class_override_property (object_class, PROP_HSCROLL_POLICY, "hscroll-policy");
+    g_object_class_override_property (object_class, PROP_VSCROLL_POLICY, "vscroll-policy");
+
+    gtk_widget_class_set_css_name (widget_class, "textview");
+}
+
+static void request_large_text_view_init (RequestLargeTextView * self) {
+    self->checkpoints = g_array_new (FALSE, FALSE, sizeof (guint64));
+
+    GtkStyleContext * context = gtk_widget_get_style_context (GTK_WIDGET (self));
+    gtk_style_context_add_class (context, "monospace");
+
+    gtk_widget_set_hexpand (GTK_WIDGET (self), TRUE);
+    gtk_widget_set_vexpand (GTK_WIDGET (self), TRUE);
+    gtk_widget_set_overflow (GTK_WIDGET (self), GTK_OVERFLOW_HIDDEN);
+
+    request_large_text_view_measure_font (self);
+}
+
+RequestLargeTextView * request_large_text_view_new (void) {
+    return g_object_new (REQUEST_TYPE_LARGE_TEXT_VIEW, NULL);
+}
+
+void request_large_text_view_clear (RequestLargeTextView * self) {
+    g_return_if_fail (REQUEST_IS_LARGE_TEXT_VIEW (self));
+
+    if (self->index_cancellable != NULL) {
+        g_cancellable_cancel (self->index_cancellable);
+        g_clear_object (&self->index_cancellable);
+    }
+
+    g_clear_pointer (&self->bytes, g_bytes_unref);
+    g_clear_pointer (&self->charset, g_free);
+    self->data = NULL;
+    self->length = 0;
+
+    g_array_set_size (self->checkpoints, 0);
+    self->n_lines = 0;
+    self->max_line_length = 0;
+    self->has_selection = FALSE;
+
+    request_large_text_view_update_adjustments (self);
+    gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+/**
+ * Shows body, decoded from charset. The lines are indexed in the background and
+ * appear as the index grows.
+ *
+ * Lines are split on '\n' bytes, which only works for charsets compatible with
+ * ASCII (i.e. not UTF-16 or UTF-32).
+ */
+void request_large_text_view_set_body (RequestLargeTextView * self, RequestBodyStore * body, const gchar * charset) {
+    GError * error = NULL;
+
+    g_return_if_fail (REQUEST_IS_LARGE_TEXT_VIEW (self));
+    g_return_if_fail (REQUEST_IS_BODY_STORE (body));
+
+    request_large_text_view_clear (self);
+
+    self->bytes = request_body_store_get_bytes (body, &error);
+    if (self->bytes == NULL) {
+        g_warning ("Cannot read response body: %s\n", error->message);
+        g_error_free (error);
+        return;
+    }
+
+    self->data = g_bytes_get_data (self->bytes, &self->length);
+    self->charset = g_strdup (charset != NULL ? charset : "UTF-8");
+    self->is_utf8 = g_ascii_strcasecmp (self->charset, "UTF-8") == 0 || g_ascii_strcasecmp (self->charset, "UTF8") == 0;
+    self->index_cancellable = g_cancellable_new ();
+
+    GTask * task = g_task_new (self, self->index_cancellable, NULL, NULL);
+    g_task_set_task_data (task, g_bytes_ref (self->bytes), (GDestroyNotify) g_bytes_unref);
+    g_task_run_in_thread (task, request_large_text_view_index_thread);
+    g_object_unref (task);
+}
+
+guint64 request_large_text_view_get_n_lines (RequestLargeTextView * self) {
+    g_return_val_if_fail (REQUEST_IS_LARGE_TEXT_VIEW (self), 0);
+
+    return self->n_lines;
+}
+
+/**
+ * Highlights the length bytes at offset and scrolls them into view.
+ */
+void request_large_text_view_select (RequestLargeTextView * self, guint64 offset, guint64 length) {
+    g_return_if_fail (REQUEST_IS_LARGE_TEXT_VIEW (self));
+
+    self->has_selection = TRUE;
+    self->selection_start = offset;
+    self->selection_end = offset + length;
+
+    if (self->checkpoints->len > 0 && offset < self->length) {
+        gsize line_offset;
+        guint64 line = request_large_text_view_get_line_at_offset (self, offset, &line_offset);
+
+        // Center the line, and keep the start of the range visible
+        if (self->vadjustment != NULL) {
+            gdouble page_size = gtk_adjustment_get_page_size (self->vadjustment);
+            gtk_adjustment_set_value (self->vadjustment, (gdouble) line * self->line_height - (page_size - self->line_height) / 2);
+        }
+
+        if (self->hadjustment != NULL) {
+            gdouble x = (gdouble) request_large_text_view_count_columns (self, line_offset, offset) * self->char_width;
+            gdouble value = gtk_adjustment_get_value (self->hadjustment);
+            gdouble page_size = gtk_adjustment_get_page_size (self->hadjustment) - request_large_text_view_get_gutter_width (self);
+
+            if (x < value || x > value + page_size - self->char_width) {
+                gtk_adjustment_set_value (self->hadjustment, x - page_size / 3);
+            }
+        }
+    }
+
+    gtk_widget_queue_draw (GTK_WIDGET (self));
+}
@@ -0,0 +1,36 @@
+/* request-large-text-view.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gtk-4.0/gtk/gtk.h>
+
+#include "request-body-store.h"
+
+G_BEGIN_DECLS
+
+#define REQUEST_TYPE_LARGE_TEXT_VIEW (request_large_text_view_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestLargeTextView, request_large_text_view, REQUEST, LARGE_TEXT_VIEW, GtkWidget)
+
+RequestLargeTextView * request_large_text_view_new (void);
+void request_large_text_view_set_body (RequestLargeTextView * self, RequestBodyStore * body, const gchar * charset);
+void request_large_text_view_clear (RequestLargeTextView * self);
+guint64 request_large_text_view_get_n_lines (RequestLargeTextView * self);
+void request_large_text_view_select (RequestLargeTextView * self, guint64 offset, guint64 length);
+
+G_END_DECLS
@@ -0,0 +1,224 @@
+/* request-load-test-popover.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtk-4.0/gtk/gtk.h>
+
+#include "request-load-test-popover.h"
+#include "request-load-test.h"
+#include "request-timings.h"
+
+struct _RequestLoadTestPopover {
+    GtkPopover parent_instance;
+
+    /* Template widgets */
+    GtkComboBoxText * mode_selector;
+    GtkSpinButton * value_spin;
+    GtkSpinButton * duration_spin;
+    GtkButton * start_button;
+    GtkProgressBar * progress_bar;
+    GtkLabel * requests_label;
+    GtkLabel * throughput_label;
+    GtkLabel * p50_label;
+    GtkLabel * p90_label;
+    GtkLabel * p99_label;
+    GtkLabel * p999_label;
+    GtkLabel * max_label;
+    GtkLabel * errors_label;
+
+    RequestLoadTest * load_test;
+};
+
+G_DEFINE_TYPE (RequestLoadTestPopover, request_load_test_popover, GTK_TYPE_POPOVER);
+
+static void request_load_test_popover_set_duration_label (GtkLabel * label, gint64 duration) {
+    gchar * text = request_timings_format_duration (duration);
+    gtk_label_set_text (label, text);
+    g_free (text);
+}
+
+static gint request_load_test_popover_compare_errors (gconstpointer a, gconstpointer b, gpointer data) {
+    GHashTable * errors = data;
+
+    guint count_a = GPOINTER_TO_UINT (g_hash_table_lookup (errors, a));
+    guint count_b = GPOINTER_TO_UINT (g_hash_table_lookup (errors, b));
+
+    return count_a == count_b ? g_strcmp0 (a, b) : (count_a < count_b ? 1 : -1);
+}
+
+/**
+ * Lists the number of errors followed by their breakdown, most frequent first.
+ */
+static gchar * request_load_test_popover_format_errors (RequestLoadTest * load_test) {
+    guint64 completed = request_load_test_get_completed_count (load_test);
+    guint64 error_count = request_load_test_get_error_count (load_test);
+
+    if (error_count == 0) {
+        return g_strdup ("0");
+    }
+
+    GString * text = g_string_new (NULL);
+    g_string_printf (text, "%" G_GUINT64_FORMAT " (%.1f%%)", error_count, 100.0 * error_count / MAX (completed, 1));
+
+    GHashTable * errors = request_load_test_get_errors (load_test);
+    GList * kinds = g_list_sort_with_data (g_hash_table_get_keys (errors), request_load_test_popover_compare_errors, errors);
+
+    for (GList * kind = kinds; kind != NULL; kind = kind->next) {
+        g_string_append_printf (text, "\n%s: %u", (const gchar *) kind->data, GPOINTER_TO_UINT (g_hash_table_lookup (errors, kind->data)));
+    }
+
+    g_list_free (kinds);
+
+    return g_string_free (text, FALSE);
+}
+
+static void request_load_test_popover_on_progress (RequestLoadTest * load_test, gpointer data) {
+    RequestLoadTestPopover * self = data;
+    g_return_if_fail (self != NULL);
+
+    const RequestHistogram * histogram = request_load_test_get_histogram (load_test);
+
+    gtk_progress_bar_set_fraction (self->progress_bar, request_load_test_get_progress (load_test));
+
+    gchar * requests = g_strdup_printf ("%" G_GUINT64_FORMAT, request_load_test_get_completed_count (load_test));
+    gtk_label_set_text (self->requests_label, requests);
+    g_free (requests);
+
+    gchar * throughput = g_strdup_printf ("%.1f req/s", request_load_test_get_throughput (load_test));
+    gtk_label_set_text (self->throughput_label, throughput);
+    g_free (throughput);
+
+    request_load_test_popover_set_duration_label (self->p50_label, request_histogram_get_value_at_percentile (histogram, 50));
+    request_load_test_popover_set_duration_label (self->p90_label, request_histogram_get_value_at_percentile (histogram, 90));
+    request_load_test_popover_set_duration_label (self->p99_label, request_histogram_get_value_at_percentile (histogram, 99));
+    request_load_test_popover_set_duration_label (self->p999_label, request_histogram_get_value_at_percentile (histogram, 99.9));
+    request_load_test_popover_set_duration_label (self->max_label, request_histogram_get_max (histogram));
+
+    gchar * errors = request_load_test_popover_format_errors (load_test);
+    gtk_label_set_text (self->errors_label, errors);
+    g_free (errors);
+}
+
+static void request_load_test_popover_set_is_running (RequestLoadTestPopover * self, gboolean is_running) {
+    gtk_button_set_label (self->start_button, is_running ? "Stop" : "Start"); // FIXME: Handle translations
+    gtk_widget_set_sensitive (GTK_WIDGET (self->mode_selector), !is_running);
+    gtk_widget_set_sensitive (GTK_WIDGET (self->value_spin), !is_running);
+    gtk_widget_set_sensitive (GTK_WIDGET (self->duration_spin), !is_running);
+}
+
+static void request_load_test_popover_on_finished (RequestLoadTest * load_test, gpointer data) {
+    (void) load_test;
+    RequestLoadTestPopover * self = data;
+    g_return_if_fail (self != NULL);
+
+    request_load_test_popover_set_is_running (self, FALSE);
+}
+
+static void request_load_test_popover_on_start_clicked (GtkButton * button, gpointer data) {
+    (void) button;
+    RequestLoadTestPopover * self = data;
+    g_return_if_fail (self != NULL);
+
+    if (self->load_test != NULL && request_load_test_is_running (self->load_test)) {
+        request_load_test_stop (self->load_test);
+        return;
+    }
+
+    // Whoever owns the request runs the test with a prepared copy of it
+    g_signal_emit_by_name (self, LOAD_TEST_REQUESTED_SIGNAL);
+}
+
+static void request_load_test_popover_dispose (GObject * object) {
+    RequestLoadTestPopover * self = REQUEST_LOAD_TEST_POPOVER (object);
+
+    if (self->load_test != NULL) {
+        g_signal_handlers_disconnect_by_data (self->load_test, self);
+        request_load_test_stop (self->load_test);
+        g_clear_object (&self->load_test);
+    }
+
+    G_OBJECT_CLASS (request_load_test_popover_parent_class)->dispose (object);
+}
+
+static void request_load_test_popover_class_init (RequestLoadTestPopoverClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
+    GtkWidgetClass * widget_class = GTK_WIDGET_CLASS (klass);
+
+    object_class->dispose = request_load_test_popover_dispose;
+
+    gtk_widget_class_set_template_from_resource (widget_class, "/com/github/guillotjulien/request/resources/ui/request-load-test-popover.ui");
+    gtk_widget_class_bind_template_child (widget_class, RequestLoadTestPopover, mode_selector);
+    gtk_widget_class_bind_template_child (widget_class, RequestLoadTestPopover, value_spin);
+    gtk_widget_class_bind_template_child (widget_class, RequestLoadTestPopover, duration_spin);
+    gtk_widget_class_bind_template_child (widget_class, RequestLoadTestPopover, start_button);
+    gtk_widget_class_bind_template_child (widget_class, RequestLoadTestPopover, progress_bar);
+    gtk_widget_class_bind_template_child (widget_class, RequestLoadTestPopover, requests_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestLoadTestPopover, throughput_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestLoadTestPopover, p50_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestLoadTestPopover, p90_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestLoadTestPopover, p99_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestLoadTestPopover, p999_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestLoadTestPopover, max_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestLoadTestPopover, errors_label);
+
+    // Declare our own signals
+    g_signal_new (LOAD_TEST_REQUESTED_SIGNAL, REQUEST_TYPE_LOAD_TEST_POPOVER, G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+}
+
+static void request_load_test_popover_init (RequestLoadTestPopover * self) {
+    gtk_widget_init_template (GTK_WIDGET (self));
+
+    g_return_if_fail (GTK_IS_WIDGET (self->mode_selector));
+    g_return_if_fail (GTK_IS_WIDGET (self->start_button));
+    g_return_if_fail (GTK_IS_WIDGET (self->progress_bar));
+
+    g_signal_connect (self->start_button, "clicked", G_CALLBACK (request_load_test_popover_on_start_clicked), self);
+}
+
+RequestLoadTestPopover * request_load_test_popover_new (void) {
+    return g_object_new (REQUEST_TYPE_LOAD_TEST_POPOVER, NULL);
+}
+
+/**
+ * Starts a load test sending copies of template with the parameters chosen in
+ * the popover, replacing the results of the previous run.
+ */
+void request_load_test_popover_run (RequestLoadTestPopover * self, SoupMessage * template) {
+    g_return_if_fail (REQUEST_IS_LOAD_TEST_POPOVER (self));
+    g_return_if_fail (SOUP_IS_MESSAGE (template));
+
+    if (self->load_test != NULL) {
+        g_signal_handlers_disconnect_by_data (self->load_test, self);
+        request_load_test_stop (self->load_test);
+        g_clear_object (&self->load_test);
+    }
+
+    RequestLoadTestMode mode = g_strcmp0 (gtk_combo_box_get_active_id (GTK_COMBO_BOX (self->mode_selector)), "rate") == 0
+        ? LOAD_TEST_MODE_RATE
+        : LOAD_TEST_MODE_CONCURRENCY;
+
+    guint value = (guint) gtk_spin_button_get_value_as_int (self->value_spin);
+    guint duration = (guint) gtk_spin_button_get_value_as_int (self->duration_spin);
+
+    self->load_test = request_load_test_new (template);
+    g_signal_connect_object (self->load_test, LOAD_TEST_PROGRESS_SIGNAL, G_CALLBACK (request_load_test_popover_on_progress), self, 0);
+    g_signal_connect_object (self->load_test, LOAD_TEST_FINISHED_SIGNAL, G_CALLBACK (request_load_test_popover_on_finished), self, 0);
+
+    gtk_progress_bar_set_fraction (self->progress_bar, 0);
+    request_load_test_popover_set_is_running (self, TRUE);
+
+    request_load_test_start (self->load_test, mode, value, duration);
+}
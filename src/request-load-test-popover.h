@@ -0,0 +1,34 @@
+/* request-load-test-popover.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gtk-4.0/gtk/gtk.h>
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+#define REQUEST_TYPE_LOAD_TEST_POPOVER (request_load_test_popover_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestLoadTestPopover, request_load_test_popover, REQUEST, LOAD_TEST_POPOVER, GtkPopover)
+
+#define LOAD_TEST_REQUESTED_SIGNAL "load-test-requested"
+
+RequestLoadTestPopover * request_load_test_popover_new (void);
+void request_load_test_popover_run (RequestLoadTestPopover * self, SoupMessage * template);
+
+G_END_DECLS
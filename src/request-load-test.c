@@ -0,0 +1,419 @@
+/* request-load-test.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <libsoup/soup.h>
+
+#include "request-load-test.h"
+
+#define LOAD_TEST_HIGHEST_LATENCY (10 * 60 * G_USEC_PER_SEC) // anything slower is clamped
+#define LOAD_TEST_SIGNIFICANT_DIGITS 3
+#define LOAD_TEST_PROGRESS_INTERVAL 250 // ms
+#define LOAD_TEST_TICK_INTERVAL 1 // ms
+#define LOAD_TEST_RATE_MAX_CONNECTIONS 256
+
+struct _RequestLoadTest {
+    GObject parent_instance;
+
+    SoupMessage * template; // never sent, copied for each request
+
+    // Kept apart from the default session so the test neither competes with
+    // nor pollutes the connections used by the regular requests.
+    SoupSession * session;
+
+    RequestLoadTestMode mode;
+    guint value;
+    gint64 start_time;
+    gint64 end_time;
+    gint64 last_completion;
+    gint64 next_send; // intended start of the next request in rate mode
+    gint64 interval; // between two requests in rate mode
+
+    guint in_flight;
+    guint64 completed;
+    guint64 errors;
+    gdouble latency_sum;
+    RequestHistogram * histogram;
+    GHashTable * errors_by_kind;
+
+    guint tick_source_id;
+    guint progress_source_id;
+    gboolean is_running;
+    gboolean is_stopping;
+};
+
+typedef struct LoadTestRequest {
+    RequestLoadTest * self;
+    gint64 intended_start;
+} LoadTestRequest;
+
+G_DEFINE_TYPE (RequestLoadTest, request_load_test, G_TYPE_OBJECT);
+
+static void request_load_test_send (RequestLoadTest * self, gint64 intended_start);
+
+static void request_load_test_clear_sources (RequestLoadTest * self) {
+    if (self->tick_source_id != 0) {
+        g_source_remove (self->tick_source_id);
+        self->tick_source_id = 0;
+    }
+
+    if (self->progress_source_id != 0) {
+        g_source_remove (self->progress_source_id);
+        self->progress_source_id = 0;
+    }
+}
+
+static void request_load_test_check_finished (RequestLoadTest * self) {
+    if (!self->is_running || self->in_flight > 0) {
+        return;
+    }
+
+    gboolean is_scheduling_done = self->mode == LOAD_TEST_MODE_CONCURRENCY
+        ? g_get_monotonic_time () >= self->end_time
+        : self->next_send >= self->end_time;
+
+    if (!self->is_stopping && !is_scheduling_done) {
+        return;
+    }
+
+    request_load_test_clear_sources (self);
+    self->is_running = FALSE;
+    self->is_stopping = FALSE;
+
+    g_signal_emit_by_name (self, LOAD_TEST_PROGRESS_SIGNAL);
+    g_signal_emit_by_name (self, LOAD_TEST_FINISHED_SIGNAL);
+}
+
+static void request_load_test_record_error (RequestLoadTest * self, SoupMessage * msg) {
+    gchar * kind;
+    if (SOUP_STATUS_IS_TRANSPORT_ERROR (msg->status_code)) {
+        kind = g_strdup (soup_status_get_phrase (msg->status_code));
+    } else {
+        kind = g_strdup_printf ("%u %s", msg->status_code, msg->reason_phrase != NULL ? msg->reason_phrase : soup_status_get_phrase (msg->status_code));
+    }
+
+    guint count = GPOINTER_TO_UINT (g_hash_table_lookup (self->errors_by_kind, kind));
+    g_hash_table_insert (self->errors_by_kind, kind, GUINT_TO_POINTER (count + 1));
+
+    self->errors++;
+}
+
+static void request_load_test_on_response (SoupSession * session, SoupMessage * msg, gpointer data) {
+    (void) session;
+    LoadTestRequest * request = data;
+    RequestLoadTest * self = request->self;
+
+    gint64 now = g_get_monotonic_time ();
+    self->in_flight--;
+
+    // Requests aborted by a stop say nothing about the server
+    if (!(self->is_stopping && msg->status_code == SOUP_STATUS_CANCELLED)) {
+        gint64 latency = now - request->intended_start;
+
+        self->completed++;
+        self->last_completion = now;
+
+        if (self->mode == LOAD_TEST_MODE_RATE) {
+            // Latency runs from the scheduled start, so time spent waiting
+            // behind slow responses is already accounted for.
+            request_histogram_record_value (self->histogram, latency);
+        } else {
+            // Each connection waits for its response before sending the next
+            // request, so a stall hides the requests it would have sent.
+            // Back-fill them using the mean latency as the expected interval.
+            self->latency_sum += (gdouble) latency;
+            request_histogram_record_corrected_value (self->histogram, latency, (gint64) (self->latency_sum / self->completed));
+        }
+
+        if (SOUP_STATUS_IS_TRANSPORT_ERROR (msg->status_code) || msg->status_code >= 400) {
+            request_load_test_record_error (self, msg);
+        }
+    }
+
+    if (self->mode == LOAD_TEST_MODE_CONCURRENCY && self->is_running && !self->is_stopping && now < self->end_time) {
+        request_load_test_send (self, now);
+    }
+
+    request_load_test_check_finished (self);
+
+    g_object_unref (self);
+    g_free (request);
+}
+
+static void request_load_test_copy_header (const gchar * name, const gchar * value, gpointer data) {
+    soup_message_headers_append (data, name, value);
+}
+
+/**
+ * Returns a new message with the method, URL, headers and body of the
+ * template. Body chunks are shared, not copied, files stay mapped once.
+ */
+static SoupMessage * request_load_test_copy_template (RequestLoadTest * self) {
+    SoupMessage * msg = soup_message_new_from_uri (self->template->method, soup_message_get_uri (self->template));
+
+    soup_message_headers_foreach (self->template->request_headers, request_load_test_copy_header, msg->request_headers);
+
+    // A complete body ends with an empty chunk
+    goffset offset = 0;
+    for (;;) {
+        SoupBuffer * chunk = soup_message_body_get_chunk (self->template->request_body, offset);
+        if (chunk == NULL || chunk->length == 0) {
+            g_clear_pointer (&chunk, soup_buffer_free);
+            break;
+        }
+
+        offset += chunk->length;
+        soup_message_body_append_buffer (msg->request_body, chunk);
+        soup_buffer_free (chunk);
+    }
+
+    soup_message_body_complete (msg->request_body);
+
+    return msg;
+}
+
+static void request_load_test_send (RequestLoadTest * self, gint64 intended_start) {
+    SoupMessage * msg = request_load_test_copy_template (self);
+
+    // Only the latency matters, don't keep the bodies around
+    soup_message_body_set_accumulate (msg->response_body, FALSE);
+
+    LoadTestRequest * request = g_new0 (LoadTestRequest, 1);
+    request->self = g_object_ref (self);
+    request->intended_start = intended_start;
+
+    self->in_flight++;
+    soup_session_queue_message (self->session, msg, request_load_test_on_response, request);
+}
+
+/**
+ * Sends every request whose turn has come since the last tick, each one keeping
+ * its scheduled start even if the main loop was late.
+ */
+static gboolean request_load_test_on_tick (gpointer data) {
+    RequestLoadTest * self = data;
+
+    gint64 now = g_get_monotonic_time ();
+    while (self->next_send <= now && self->next_send < self->end_time) {
+        request_load_test_send (self, self->next_send);
+        self->next_send += self->interval;
+    }
+
+    if (self->next_send >= self->end_time) {
+        self->tick_source_id = 0;
+        request_load_test_check_finished (self);
+
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean request_load_test_on_progress (gpointer data) {
+    RequestLoadTest * self = data;
+
+    g_signal_emit_by_name (self, LOAD_TEST_PROGRESS_SIGNAL);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void request_load_test_dispose (GObject * object) {
+    RequestLoadTest * self = REQUEST_LOAD_TEST (object);
+
+    request_load_test_clear_sources (self);
+    if (self->session != NULL) {
+        soup_session_abort (self->session);
+    }
+
+    g_clear_object (&self->session);
+
+    G_OBJECT_CLASS (request_load_test_parent_class)->dispose (object);
+}
+
+static void request_load_test_finalize (GObject * object) {
+    RequestLoadTest * self = REQUEST_LOAD_TEST (object);
+
+    g_object_unref (self->template);
+    request_histogram_free (self->histogram);
+    g_hash_table_destroy (self->errors_by_kind);
+
+    G_OBJECT_CLASS (request_load_test_parent_class)->finalize (object);
+}
+
+static void request_load_test_class_init (RequestLoadTestClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = request_load_test_dispose;
+    object_class->finalize = request_load_test_finalize;
+
+    // Declare our own signals
+    g_signal_new (LOAD_TEST_PROGRESS_SIGNAL, REQUEST_TYPE_LOAD_TEST, G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+    g_signal_new (LOAD_TEST_FINISHED_SIGNAL, REQUEST_TYPE_LOAD_TEST, G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+}
+
+static void request_load_test_init (RequestLoadTest * self) {
+    self->histogram = request_histogram_new (LOAD_TEST_HIGHEST_LATENCY, LOAD_TEST_SIGNIFICANT_DIGITS);
+    self->errors_by_kind = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+/**
+ * Creates a load test firing copies of template, with its headers and body.
+ * template itself is never sent.
+ */
+RequestLoadTest * request_load_test_new (SoupMessage * template) {
+    g_return_val_if_fail (SOUP_IS_MESSAGE (template), NULL);
+
+    RequestLoadTest * self = g_object_new (REQUEST_TYPE_LOAD_TEST, NULL);
+    self->template = g_object_ref (template);
+
+    return self;
+}
+
+/**
+ * Runs the test for duration seconds. In concurrency mode value is the number
+ * of requests kept in flight, in rate mode the number of requests started per
+ * second whatever the server latency. Results of a previous run are discarded.
+ */
+void request_load_test_start (RequestLoadTest * self, RequestLoadTestMode mode, guint value, guint duration) {
+    g_return_if_fail (REQUEST_IS_LOAD_TEST (self));
+    g_return_if_fail (value > 0);
+    g_return_if_fail (duration > 0);
+
+    if (self->is_running) {
+        return;
+    }
+
+    request_histogram_reset (self->histogram);
+    g_hash_table_remove_all (self->errors_by_kind);
+    self->completed = 0;
+    self->errors = 0;
+    self->latency_sum = 0;
+
+    guint max_conns = mode == LOAD_TEST_MODE_CONCURRENCY ? value : LOAD_TEST_RATE_MAX_CONNECTIONS;
+
+    g_clear_object (&self->session);
+    self->session = soup_session_new_with_options (
+        SOUP_SESSION_MAX_CONNS, max_conns,
+        SOUP_SESSION_MAX_CONNS_PER_HOST, max_conns,
+        NULL);
+
+    self->mode = mode;
+    self->value = value;
+    self->start_time = g_get_monotonic_time ();
+    self->end_time = self->start_time + (gint64) duration * G_USEC_PER_SEC;
+    self->last_completion = self->start_time;
+    self->is_running = TRUE;
+    self->is_stopping = FALSE;
+
+    if (mode == LOAD_TEST_MODE_CONCURRENCY) {
+        for (guint i = 0; i < value; i++) {
+            request_load_test_send (self, self->start_time);
+        }
+    } else {
+        self->interval = MAX (G_USEC_PER_SEC / value, 1);
+        self->next_send = self->start_time;
+        self->tick_source_id = g_timeout_add (LOAD_TEST_TICK_INTERVAL, request_load_test_on_tick, self);
+    }
+
+    self->progress_source_id = g_timeout_add (LOAD_TEST_PROGRESS_INTERVAL, request_load_test_on_progress, self);
+}
+
+/**
+ * Aborts the requests in flight. Results gathered so far are kept.
+ */
+void request_load_test_stop (RequestLoadTest * self) {
+    g_return_if_fail (REQUEST_IS_LOAD_TEST (self));
+
+    if (!self->is_running || self->is_stopping) {
+        return;
+    }
+
+    self->is_stopping = TRUE;
+
+    if (self->tick_source_id != 0) {
+        g_source_remove (self->tick_source_id);
+        self->tick_source_id = 0;
+    }
+
+    soup_session_abort (self->session);
+    request_load_test_check_finished (self);
+}
+
+gboolean request_load_test_is_running (RequestLoadTest * self) {
+    g_return_val_if_fail (REQUEST_IS_LOAD_TEST (self), FALSE);
+
+    return self->is_running;
+}
+
+/**
+ * Returns the elapsed fraction of the test duration, between 0 and 1.
+ */
+gdouble request_load_test_get_progress (RequestLoadTest * self) {
+    g_return_val_if_fail (REQUEST_IS_LOAD_TEST (self), 0);
+
+    if (!self->is_running) {
+        return self->completed > 0 ? 1 : 0;
+    }
+
+    gdouble elapsed = (gdouble) (g_get_monotonic_time () - self->start_time);
+    return CLAMP (elapsed / (self->end_time - self->start_time), 0, 1);
+}
+
+/**
+ * Returns the latencies, in µs.
+ */
+const RequestHistogram * request_load_test_get_histogram (RequestLoadTest * self) {
+    g_return_val_if_fail (REQUEST_IS_LOAD_TEST (self), NULL);
+
+    return self->histogram;
+}
+
+guint64 request_load_test_get_completed_count (RequestLoadTest * self) {
+    g_return_val_if_fail (REQUEST_IS_LOAD_TEST (self), 0);
+
+    return self->completed;
+}
+
+guint64 request_load_test_get_error_count (RequestLoadTest * self) {
+    g_return_val_if_fail (REQUEST_IS_LOAD_TEST (self), 0);
+
+    return self->errors;
+}
+
+/**
+ * Returns the number of completed requests per second.
+ */
+gdouble request_load_test_get_throughput (RequestLoadTest * self) {
+    g_return_val_if_fail (REQUEST_IS_LOAD_TEST (self), 0);
+
+    gint64 end = self->is_running ? g_get_monotonic_time () : self->last_completion;
+    gint64 elapsed = end - self->start_time;
+    if (elapsed <= 0) {
+        return 0;
+    }
+
+    return (gdouble) self->completed * G_USEC_PER_SEC / elapsed;
+}
+
+/**
+ * Returns the number of failed requests keyed by status, transport errors
+ * included.
+ */
+GHashTable * request_load_test_get_errors (RequestLoadTest * self) {
+    g_return_val_if_fail (REQUEST_IS_LOAD_TEST (self), NULL);
+
+    return self->errors_by_kind;
+}
@@ -0,0 +1,49 @@
+/* request-load-test.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <libsoup/soup.h>
+
+#include "request-histogram.h"
+
+G_BEGIN_DECLS
+
+#define REQUEST_TYPE_LOAD_TEST (request_load_test_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestLoadTest, request_load_test, REQUEST, LOAD_TEST, GObject)
+
+#define LOAD_TEST_PROGRESS_SIGNAL "progress"
+#define LOAD_TEST_FINISHED_SIGNAL "finished"
+
+typedef enum RequestLoadTestMode {
+    LOAD_TEST_MODE_CONCURRENCY, // fixed number of requests in flight
+    LOAD_TEST_MODE_RATE, // constant number of requests sent per second
+} RequestLoadTestMode;
+
+RequestLoadTest * request_load_test_new (SoupMessage * template);
+void request_load_test_start (RequestLoadTest * self, RequestLoadTestMode mode, guint value, guint duration);
+void request_load_test_stop (RequestLoadTest * self);
+gboolean request_load_test_is_running (RequestLoadTest * self);
+gdouble request_load_test_get_progress (RequestLoadTest * self);
+const RequestHistogram * request_load_test_get_histogram (RequestLoadTest * self);
+guint64 request_load_test_get_completed_count (RequestLoadTest * self);
+guint64 request_load_test_get_error_count (RequestLoadTest * self);
+gdouble request_load_test_get_throughput (RequestLoadTest * self);
+GHashTable * request_load_test_get_errors (RequestLoadTest * self);
+
+G_END_DECLS
@@ -0,0 +1,366 @@
+/* request-mock-server.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <libsoup/soup.h>
+#include <string.h>
+
+#include "request-mock-server.h"
+
+#define MOCK_PATTERN_SIZE (64 * 1024) // biggest chunk written at once
+#define MOCK_TICK 50 // ms between two chunks when the bandwidth is limited
+#define MOCK_STREAM_CHUNK_SIZE 4096
+#define MOCK_DRIP_BYTES 10
+#define MOCK_DRIP_DURATION 2000 // ms
+#define MOCK_DRIP_MAX_CHUNKS 100
+
+/**
+ * Serves canned responses on localhost, in process, so that the streaming,
+ * timing and load test code can be exercised without a live service:
+ *
+ *   /                 routes below, as JSON
+ *   /json             a small fixed JSON document
+ *   /bytes/N          N bytes of text with a Content-Length
+ *   /stream/N         N bytes of text, chunked (?chunk=SIZE, default 4096)
+ *   /drip             ?bytes=N spread over ?duration=MS (default 10 over 2000)
+ *   /status/CODE      an empty response with that status
+ *
+ * Every route accepts ?delay=MS before the response starts and ?rate=BYTES
+ * per second for the body, overriding the latency and bandwidth of the server.
+ */
+struct _RequestMockServer {
+    GObject parent_instance;
+
+    SoupServer * server;
+    gchar * url;
+    guint latency; // ms
+    guint64 bandwidth; // bytes per second, 0 for unlimited
+};
+
+/**
+ * A response being written, freed once its message is finished (completed or
+ * the client went away).
+ */
+typedef struct RequestMockResponse {
+    SoupServer * server;
+    SoupMessage * msg;
+
+    const gchar * data; // written over and over until length is reached
+    gsize data_length;
+    guint64 length;
+    guint64 written;
+
+    gsize chunk_size;
+    guint interval; // ms between chunks, 0 to write as fast as the client reads
+    guint source_id;
+} RequestMockResponse;
+
+G_DEFINE_TYPE (RequestMockServer, request_mock_server, G_TYPE_OBJECT);
+
+static const gchar mock_index[] =
+    "{\n"
+    "    \"routes\": [\"/json\", \"/bytes/{n}\", \"/stream/{n}?chunk={size}\", \"/drip?bytes={n}&duration={ms}\", \"/status/{code}\"],\n"
+    "    \"parameters\": [\"delay={ms}\", \"rate={bytes per second}\"]\n"
+    "}\n";
+
+static const gchar mock_json[] =
+    "{\"id\":42,\"name\":\"Mock product\",\"price\":19.99,\"tags\":[\"mock\",\"local\"],"
+    "\"stock\":{\"available\":true,\"count\":7},\"description\":null}";
+
+/**
+ * Returns MOCK_PATTERN_SIZE bytes of numbered text lines, generated once.
+ */
+static const gchar * request_mock_server_get_pattern (void) {
+    static gchar * pattern = NULL;
+
+    if (g_once_init_enter (&pattern)) {
+        GString * text = g_string_sized_new (MOCK_PATTERN_SIZE + 64);
+        for (guint line = 0; text->len < MOCK_PATTERN_SIZE; line++) {
+            g_string_append_printf (text, "%06u abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ\n", line);
+        }
+
+        g_string_truncate (text, MOCK_PATTERN_SIZE);
+        g_once_init_leave (&pattern, g_string_free (text, FALSE));
+    }
+
+    return pattern;
+}
+
+static guint64 request_mock_server_get_param (GHashTable * query, const gchar * name, guint64 fallback) {
+    const gchar * value = query != NULL ? g_hash_table_lookup (query, name) : NULL;
+    if (value == NULL || !g_ascii_isdigit (*value)) {
+        return fallback;
+    }
+
+    return g_ascii_strtoull (value, NULL, 10);
+}
+
+static void request_mock_response_free (RequestMockResponse * response) {
+    if (response->source_id != 0) {
+        g_source_remove (response->source_id);
+    }
+
+    g_signal_handlers_disconnect_by_data (response->msg, response);
+    g_object_unref (response->msg);
+    g_object_unref (response->server);
+    g_free (response);
+}
+
+/**
+ * Appends the next chunk of the body, and completes it after the last one.
+ */
+static void request_mock_response_write (RequestMockResponse * response) {
+    if (response->written < response->length) {
+        gsize offset = response->written % response->data_length;
+        gsize length = MIN (MIN (response->chunk_size, response->data_length - offset), response->length - response->written);
+
+        soup_message_body_append (response->msg->response_body, SOUP_MEMORY_STATIC, response->data + offset, length);
+        response->written += length;
+    }
+
+    if (response->written == response->length) {
+        soup_message_body_complete (response->msg->response_body);
+    }
+
+    soup_server_unpause_message (response->server, response->msg);
+}
+
+static gboolean request_mock_response_on_tick (gpointer data) {
+    RequestMockResponse * response = data;
+
+    response->source_id = 0;
+    request_mock_response_write (response);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void request_mock_response_on_wrote_chunk (SoupMessage * msg, gpointer data) {
+    (void) msg;
+    RequestMockResponse * response = data;
+
+    if (response->written == response->length) {
+        return; // already completed
+    }
+
+    if (response->interval == 0) {
+        request_mock_response_write (response);
+    } else if (response->source_id == 0) {
+        response->source_id = g_timeout_add (response->interval, request_mock_response_on_tick, response);
+    }
+}
+
+static void request_mock_response_on_finished (SoupMessage * msg, gpointer data) {
+    (void) msg;
+
+    request_mock_response_free (data);
+}
+
+static gboolean request_mock_response_on_delay (gpointer data) {
+    RequestMockResponse * response = data;
+
+    response->source_id = 0;
+    request_mock_response_write (response);
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * Paces the body to bandwidth bytes per second, in chunks written every
+ * MOCK_TICK ms (or more often when the chunks would be too big).
+ */
+static void request_mock_response_set_bandwidth (RequestMockResponse * response, guint64 bandwidth) {
+    if (bandwidth == 0) {
+        return;
+    }
+
+    response->chunk_size = CLAMP (bandwidth * MOCK_TICK / 1000, 1, MOCK_PATTERN_SIZE);
+    response->interval = (guint) (response->chunk_size * 1000 / bandwidth);
+}
+
+static void request_mock_server_handle (SoupServer * server, SoupMessage * msg, const char * path, GHashTable * query, SoupClientContext * client, gpointer data) {
+    (void) client;
+    RequestMockServer * self = data;
+
+    RequestMockResponse * response = g_new0 (RequestMockResponse, 1);
+    response->server = g_object_ref (server);
+    response->msg = g_object_ref (msg);
+    response->data = request_mock_server_get_pattern ();
+    response->data_length = MOCK_PATTERN_SIZE;
+    response->chunk_size = MOCK_PATTERN_SIZE;
+
+    const gchar * content_type = "text/plain; charset=utf-8";
+    guint status = SOUP_STATUS_OK;
+    SoupEncoding encoding = SOUP_ENCODING_CONTENT_LENGTH;
+
+    if (g_strcmp0 (path, "/") == 0 || g_strcmp0 (path, "/json") == 0) {
+        response->data = g_strcmp0 (path, "/") == 0 ? mock_index : mock_json;
+        response->data_length = strlen (response->data);
+        response->length = response->data_length;
+        content_type = "application/json";
+    } else if (g_str_has_prefix (path, "/bytes/")) {
+        response->length = g_ascii_strtoull (path + strlen ("/bytes/"), NULL, 10);
+    } else if (g_str_has_prefix (path, "/stream/")) {
+        response->length = g_ascii_strtoull (path + strlen ("/stream/"), NULL, 10);
+        response->chunk_size = CLAMP (request_mock_server_get_param (query, "chunk", MOCK_STREAM_CHUNK_SIZE), 1, MOCK_PATTERN_SIZE);
+        encoding = SOUP_ENCODING_CHUNKED;
+    } else if (g_strcmp0 (path, "/drip") == 0) {
+        response->length = request_mock_server_get_param (query, "bytes", MOCK_DRIP_BYTES);
+
+        guint64 duration = request_mock_server_get_param (query, "duration", MOCK_DRIP_DURATION);
+        guint64 chunks = CLAMP (response->length, 1, MOCK_DRIP_MAX_CHUNKS);
+
+        response->chunk_size = CLAMP ((response->length + chunks - 1) / chunks, 1, MOCK_PATTERN_SIZE);
+        response->interval = (guint) (duration / chunks);
+    } else if (g_str_has_prefix (path, "/status/")) {
+        status = (guint) g_ascii_strtoull (path + strlen ("/status/"), NULL, 10);
+        if (status < 100 || status > 599) {
+            status = SOUP_STATUS_BAD_REQUEST;
+        }
+    } else {
+        status = SOUP_STATUS_NOT_FOUND;
+    }
+
+    // Drip has its own pace
+    if (g_strcmp0 (path, "/drip") != 0) {
+        request_mock_response_set_bandwidth (response, request_mock_server_get_param (query, "rate", self->bandwidth));
+    }
+
+    soup_message_set_status (msg, status);
+    soup_message_headers_set_encoding (msg->response_headers, encoding);
+    if (encoding == SOUP_ENCODING_CONTENT_LENGTH) {
+        soup_message_headers_set_content_length (msg->response_headers, response->length);
+    }
+
+    if (response->length > 0) {
+        soup_message_headers_set_content_type (msg->response_headers, content_type, NULL);
+    }
+
+    // Responses must be fresh for the timings to mean something
+    soup_message_headers_replace (msg->response_headers, "Cache-Control", "no-store");
+
+    // Big bodies must not be kept in memory once written
+    soup_message_body_set_accumulate (msg->response_body, FALSE);
+
+    g_signal_connect (msg, "wrote-chunk", G_CALLBACK (request_mock_response_on_wrote_chunk), response);
+    g_signal_connect (msg, "finished", G_CALLBACK (request_mock_response_on_finished), response);
+
+    guint64 delay = request_mock_server_get_param (query, "delay", self->latency);
+    if (delay > 0) {
+        soup_server_pause_message (server, msg);
+        response->source_id = g_timeout_add ((guint) delay, request_mock_response_on_delay, response);
+    } else {
+        request_mock_response_write (response);
+    }
+}
+
+static void request_mock_server_dispose (GObject * object) {
+    RequestMockServer * self = REQUEST_MOCK_SERVER (object);
+
+    request_mock_server_stop (self);
+
+    G_OBJECT_CLASS (request_mock_server_parent_class)->dispose (object);
+}
+
+static void request_mock_server_class_init (RequestMockServerClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = request_mock_server_dispose;
+}
+
+static void request_mock_server_init (RequestMockServer * self) {
+    (void) self;
+}
+
+RequestMockServer * request_mock_server_new (void) {
+    return g_object_new (REQUEST_TYPE_MOCK_SERVER, NULL);
+}
+
+/**
+ * Listens on 127.0.0.1, on any free port when port is 0. The URL to reach the
+ * server is then returned by request_mock_server_get_url.
+ */
+gboolean request_mock_server_start (RequestMockServer * self, guint port, GError ** error) {
+    g_return_val_if_fail (REQUEST_IS_MOCK_SERVER (self), FALSE);
+    g_return_val_if_fail (self->server == NULL, FALSE);
+
+    SoupServer * server = soup_server_new (SOUP_SERVER_SERVER_HEADER, "request-mock ", NULL);
+    soup_server_add_handler (server, NULL, request_mock_server_handle, self, NULL);
+
+    if (!soup_server_listen_local (server, port, SOUP_SERVER_LISTEN_IPV4_ONLY, error)) {
+        g_object_unref (server);
+        return FALSE;
+    }
+
+    GSList * uris = soup_server_get_uris (server);
+    self->url = soup_uri_to_string (uris->data, FALSE);
+    g_slist_free_full (uris, (GDestroyNotify) soup_uri_free);
+
+    self->server = server;
+
+    return TRUE;
+}
+
+/**
+ * Closes the listening socket and every connection, responses being written
+ * are aborted.
+ */
+void request_mock_server_stop (RequestMockServer * self) {
+    g_return_if_fail (REQUEST_IS_MOCK_SERVER (self));
+
+    if (self->server == NULL) {
+        return;
+    }
+
+    soup_server_disconnect (self->server);
+    g_clear_object (&self->server);
+    g_clear_pointer (&self->url, g_free);
+}
+
+gboolean request_mock_server_is_running (RequestMockServer * self) {
+    g_return_val_if_fail (REQUEST_IS_MOCK_SERVER (self), FALSE);
+
+    return self->server != NULL;
+}
+
+/**
+ * Returns the base URL of the server, e.g. http://127.0.0.1:34567/, or NULL
+ * when it is not running.
+ */
+const gchar * request_mock_server_get_url (RequestMockServer * self) {
+    g_return_val_if_fail (REQUEST_IS_MOCK_SERVER (self), NULL);
+
+    return self->url;
+}
+
+/**
+ * Sets the delay in ms before every response starts, unless the request asks
+ * for its own.
+ */
+void request_mock_server_set_latency (RequestMockServer * self, guint latency) {
+    g_return_if_fail (REQUEST_IS_MOCK_SERVER (self));
+
+    self->latency = latency;
+}
+
+/**
+ * Limits every response body to bandwidth bytes per second, 0 for unlimited,
+ * unless the request asks for its own rate.
+ */
+void request_mock_server_set_bandwidth (RequestMockServer * self, guint64 bandwidth) {
+    g_return_if_fail (REQUEST_IS_MOCK_SERVER (self));
+
+    self->bandwidth = bandwidth;
+}
@@ -0,0 +1,36 @@
+/* request-mock-server.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+#define REQUEST_TYPE_MOCK_SERVER (request_mock_server_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestMockServer, request_mock_server, REQUEST, MOCK_SERVER, GObject)
+
+RequestMockServer * request_mock_server_new (void);
+gboolean request_mock_server_start (RequestMockServer * self, guint port, GError ** error);
+void request_mock_server_stop (RequestMockServer * self);
+gboolean request_mock_server_is_running (RequestMockServer * self);
+const gchar * request_mock_server_get_url (RequestMockServer * self);
+void request_mock_server_set_latency (RequestMockServer * self, guint latency);
+void request_mock_server_set_bandwidth (RequestMockServer * self, guint64 bandwidth);
+
+G_END_DECLS
@@ -0,0 +1,150 @@
+/* request-prewarm.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <libsoup/soup.h>
+
+#include "request-prewarm.h"
+#include "request-settings.h"
+#include "request-timings.h"
+
+#define DEFAULT_IDLE_TIMEOUT 60 // seconds, same as the session
+
+/**
+ * What was done ahead of time for an origin.
+ */
+typedef struct RequestPrewarmOrigin {
+    gint64 warmed_at;
+    gboolean is_in_flight;
+    gboolean is_preconnected;
+    RequestTimings preconnect; // valid when is_preconnected
+} RequestPrewarmOrigin;
+
+// scheme://host:port -> RequestPrewarmOrigin
+static GHashTable * origins = NULL;
+
+static gchar * request_prewarm_get_origin (SoupURI * uri) {
+    return g_strdup_printf ("%s://%s:%u", soup_uri_get_scheme (uri), soup_uri_get_host (uri), soup_uri_get_port (uri));
+}
+
+static void request_prewarm_on_preconnected (SoupSession * session, SoupMessage * msg, gpointer data) {
+    (void) session;
+    gchar * origin = data;
+
+    RequestPrewarmOrigin * prewarm = g_hash_table_lookup (origins, origin);
+    RequestTimings * timings = request_timings_get (msg);
+
+    if (prewarm != NULL) {
+        prewarm->is_in_flight = FALSE;
+
+        // Only a response proves the connection is open, and kept alive
+        if (!SOUP_STATUS_IS_TRANSPORT_ERROR (msg->status_code) && timings != NULL && !request_timings_get_connection_reused (timings)) {
+            prewarm->is_preconnected = TRUE;
+            prewarm->preconnect = *timings;
+        }
+    }
+
+    g_free (origin);
+}
+
+/**
+ * Warms up the connection to the origin of url before it is requested: its
+ * host name is resolved and, when preconnect is set, a HEAD request opens a
+ * connection (TCP and TLS) that stays in the session pool for the real
+ * request. Origins warmed less than an idle timeout ago are skipped.
+ */
+void request_prewarm_url (SoupSession * session, const gchar * url, gboolean preconnect) {
+    g_return_if_fail (SOUP_IS_SESSION (session));
+    g_return_if_fail (url != NULL);
+
+    SoupURI * uri = soup_uri_new (url);
+    if (!SOUP_URI_VALID_FOR_HTTP (uri)) {
+        g_clear_pointer (&uri, soup_uri_free);
+        return;
+    }
+
+    if (origins == NULL) {
+        origins = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    }
+
+    gchar * origin = request_prewarm_get_origin (uri);
+    RequestPrewarmOrigin * prewarm = g_hash_table_lookup (origins, origin);
+
+    gint64 now = g_get_monotonic_time ();
+    gint64 idle_timeout = (gint64) request_settings_get_int ("idle-timeout", DEFAULT_IDLE_TIMEOUT) * G_USEC_PER_SEC;
+
+    if (prewarm != NULL && (prewarm->is_in_flight || now - prewarm->warmed_at < idle_timeout)) {
+        g_free (origin);
+        soup_uri_free (uri);
+        return;
+    }
+
+    if (prewarm == NULL) {
+        prewarm = g_new0 (RequestPrewarmOrigin, 1);
+        g_hash_table_insert (origins, g_strdup (origin), prewarm);
+    }
+
+    prewarm->warmed_at = now;
+    prewarm->is_preconnected = FALSE;
+
+    if (request_settings_get_boolean ("prefetch-dns", TRUE)) {
+        soup_session_prefetch_dns (session, soup_uri_get_host (uri), NULL, NULL, NULL);
+    }
+
+    if (preconnect) {
+        // Opening the connection needs a request, HEAD on the root is the
+        // cheapest one most servers answer.
+        soup_uri_set_path (uri, "/");
+        soup_uri_set_query (uri, NULL);
+        soup_uri_set_fragment (uri, NULL);
+
+        SoupMessage * msg = soup_message_new_from_uri (SOUP_METHOD_HEAD, uri);
+        soup_message_set_flags (msg, SOUP_MESSAGE_NO_REDIRECT);
+        request_timings_attach (msg);
+
+        prewarm->is_in_flight = TRUE;
+        soup_session_queue_message (session, msg, request_prewarm_on_preconnected, g_strdup (origin));
+    }
+
+    g_free (origin);
+    soup_uri_free (uri);
+}
+
+/**
+ * Marks the timings of msg as preconnected when it reused the connection a
+ * preconnect opened. Call it once the response headers arrived.
+ */
+void request_prewarm_claim (SoupMessage * msg) {
+    g_return_if_fail (SOUP_IS_MESSAGE (msg));
+
+    RequestTimings * timings = request_timings_get (msg);
+    // Responses from the HTTP cache never went on the network (sending is 0)
+    if (origins == NULL || timings == NULL || timings->sending == 0 || !request_timings_get_connection_reused (timings)) {
+        return;
+    }
+
+    gchar * origin = request_prewarm_get_origin (soup_message_get_uri (msg));
+    RequestPrewarmOrigin * prewarm = g_hash_table_lookup (origins, origin);
+    g_free (origin);
+
+    if (prewarm == NULL || !prewarm->is_preconnected) {
+        return;
+    }
+
+    // Only the first request gets the preconnected connection
+    request_timings_set_preconnected (timings, &prewarm->preconnect);
+    prewarm->is_preconnected = FALSE;
+}
@@ -17,11 +17,12 @@
 
 #include <gtk-4.0/gtk/gtk.h>
 #include <libsoup/soup.h>
-#include <inttypes.h>
 
 #include "request-response-bar.h"
-
-typedef struct _RequestResponseBarPrivate RequestResponseBarPrivate;
+#include "request-timings.h"
+#include "request-timing-waterfall.h"
+#include "request-cache.h"
+#include "request-format.h"
 
 struct _RequestResponseBar {
     GtkBox parent_instance;
@@ -29,30 +30,34 @@ struct _RequestResponseBar {
     /* Template widgets */
     GtkBox * request_bar;
     GtkLabel * request_code_label;
+    RequestTimingWaterfall * request_waterfall;
     GtkLabel * request_duration_label;
     GtkLabel * request_size_label;
-
-    RequestResponseBarPrivate * priv;
+    GtkLabel * request_connection_label;
+    GtkLabel * request_cache_label;
+    GtkLabel * request_error_label;
 };
 
 struct _RequestResponseBarClass {
     GtkBoxClass parent_class;
 };
 
-struct _RequestResponseBarPrivate {
-    gint64 request_start_time;
-};
-
-G_DEFINE_TYPE_WITH_CODE (RequestResponseBar, request_response_bar, GTK_TYPE_BOX, G_ADD_PRIVATE (RequestResponseBar));
+G_DEFINE_TYPE (RequestResponseBar, request_response_bar, GTK_TYPE_BOX);
 
 static void request_response_bar_class_init (RequestResponseBarClass * klass) {
     GtkWidgetClass * widget_class = GTK_WIDGET_CLASS (klass);
 
+    g_type_ensure (REQUEST_TYPE_TIMING_WATERFALL); // ensure waterfall type is known before instanciating the template
+
     gtk_widget_class_set_template_from_resource (widget_class, "/com/github/guillotjulien/request/resources/ui/request-response-bar.ui");
     gtk_widget_class_bind_template_child (widget_class, RequestResponseBar, request_bar);
     gtk_widget_class_bind_template_child (widget_class, RequestResponseBar, request_code_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestResponseBar, request_waterfall);
     gtk_widget_class_bind_template_child (widget_class, RequestResponseBar, request_duration_label);
     gtk_widget_class_bind_template_child (widget_class, RequestResponseBar, request_size_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestResponseBar, request_connection_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestResponseBar, request_cache_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestResponseBar, request_error_label);
 }
 
 static void request_response_bar_init (RequestResponseBar * self) {
@@ -62,46 +67,40 @@ static void request_response_bar_init (RequestResponseBar * self) {
     // Validate that we retrieved our widgets
     g_return_if_fail (GTK_IS_WIDGET (self->request_bar));
     g_return_if_fail (GTK_IS_WIDGET (self->request_code_label));
+    g_return_if_fail (GTK_IS_WIDGET (self->request_waterfall));
     g_return_if_fail (GTK_IS_WIDGET (self->request_duration_label));
     g_return_if_fail (GTK_IS_WIDGET (self->request_size_label));
+    g_return_if_fail (GTK_IS_WIDGET (self->request_connection_label));
+    g_return_if_fail (GTK_IS_WIDGET (self->request_cache_label));
+    g_return_if_fail (GTK_IS_WIDGET (self->request_error_label));
 
     gtk_widget_set_opacity (GTK_WIDGET (self->request_bar), 0);
 }
 
+RequestResponseBar * request_response_bar_new (void) {
+    return g_object_new (REQUEST_TYPE_RESPONSE_BAR, NULL);
+}
+
 /**
- * Returns size as a string from raw content length and add the appropriate
- * prefix at the end of the string.
- * If the body is compressed, we return the COMPRESSED size.
+ * Switches between the details of a response and the error message of a
+ * request that could not be sent.
  */
-static char * request_response_bar_get_response_size (goffset raw_length) {
-    const char * sizes[] = { "TB", "GB", "MB", "KB", "B" };
-    const uint64_t exbibytes = 1024ULL * 1024ULL * 1024ULL * 1024ULL;
-
-    guint64 length = (guint64) floor (raw_length / 8);
-    uint64_t multiplier = exbibytes;
-    for (unsigned long i = 0; i < sizeof (sizes) / sizeof (*(sizes)); i++, multiplier /= 1024) {
-        if (length < multiplier)
-            continue;
-        if (length % multiplier == 0)
-            return g_strdup_printf ("%" PRIu64 " %s", length / multiplier, sizes[i]);
-        else
-            return g_strdup_printf ("%.2f %s", (float) length / multiplier, sizes[i]);
+static void request_response_bar_set_is_error (RequestResponseBar * self, gboolean is_error) {
+    gtk_widget_set_visible (GTK_WIDGET (self->request_waterfall), !is_error);
+    gtk_widget_set_visible (GTK_WIDGET (self->request_duration_label), !is_error);
+    gtk_widget_set_visible (GTK_WIDGET (self->request_size_label), !is_error);
+    gtk_widget_set_visible (GTK_WIDGET (self->request_error_label), is_error);
+
+    if (is_error) {
+        gtk_widget_set_visible (GTK_WIDGET (self->request_connection_label), FALSE);
+        gtk_widget_set_visible (GTK_WIDGET (self->request_cache_label), FALSE);
     }
-
-    return "0 B";
-}
-
-RequestResponseBar * request_response_bar_new (void) {
-    return g_object_new (REQUEST_TYPE_RESPONSE_BAR, NULL);
 }
 
 void request_response_bar_on_message_begin (SoupMessage * msg, RequestResponseBar * self) {
     (void) msg;
     g_return_if_fail (self != NULL);
 
-    RequestResponseBarPrivate * priv = request_response_bar_get_instance_private (self);
-    priv->request_start_time = g_get_real_time ();
-
     GtkStyleContext * context = gtk_widget_get_style_context (GTK_WIDGET (self->request_code_label));
 
     g_return_if_fail (context != NULL);
@@ -114,16 +113,44 @@ void request_response_bar_on_message_begin (SoupMessage * msg, RequestResponseBa
     gtk_widget_set_opacity (GTK_WIDGET (self->request_bar), 0);
 }
 
-void request_response_bar_on_message_received (SoupMessage * msg, RequestResponseBar * self) {
+/**
+ * Shows why a request was not sent, e.g. its body file can't be read.
+ */
+void request_response_bar_show_error (RequestResponseBar * self, const gchar * message) {
+    g_return_if_fail (REQUEST_IS_RESPONSE_BAR (self));
+    g_return_if_fail (message != NULL);
+
+    GtkStyleContext * context = gtk_widget_get_style_context (GTK_WIDGET (self->request_code_label));
+
+    gtk_style_context_remove_class (context, "success");
+    gtk_style_context_remove_class (context, "warning");
+    gtk_style_context_add_class (context, "error");
+
+    gtk_label_set_markup (self->request_code_label, "<span weight='600'>Not sent</span>"); // FIXME: Handle translations
+    gtk_label_set_label (self->request_error_label, message);
+    gtk_widget_set_tooltip_text (GTK_WIDGET (self->request_error_label), message);
+
+    request_response_bar_set_is_error (self, TRUE);
+    gtk_widget_set_opacity (GTK_WIDGET (self->request_bar), 1);
+}
+
+/**
+ * Shows the outcome of msg, whose body took wire_length bytes on the wire and
+ * decoded_length once its Content-Encoding was removed.
+ */
+void request_response_bar_on_message_received (SoupMessage * msg, goffset wire_length, goffset decoded_length, RequestResponseBar * self) {
     g_return_if_fail (msg != NULL);
     g_return_if_fail (self != NULL);
     g_return_if_fail (GTK_IS_WIDGET (self->request_code_label));
     g_return_if_fail (GTK_IS_WIDGET (self->request_duration_label));
     g_return_if_fail (GTK_IS_WIDGET (self->request_size_label));
+    g_return_if_fail (GTK_IS_WIDGET (self->request_connection_label));
+    g_return_if_fail (GTK_IS_WIDGET (self->request_cache_label));
 
-    RequestResponseBarPrivate * priv = request_response_bar_get_instance_private (self);
     GtkStyleContext * context = gtk_widget_get_style_context (GTK_WIDGET (self->request_code_label));
 
+    request_response_bar_set_is_error (self, FALSE);
+
     gchar * status_code = g_strdup_printf ("%u", msg->status_code);
     if (strcmp (status_code, "2") != 0) { // libsoup return 2 on error
         switch (status_code[0]) {
@@ -145,21 +172,28 @@ void request_response_bar_on_message_received (SoupMessage * msg, RequestRespons
         gtk_style_context_add_class (context, "error");
     }
 
-    if (priv->request_start_time == ((gint64) 0)) {
-        gtk_label_set_label (self->request_duration_label, "0 ms");
-    } else {
-        gint64 duration = 0LL;
-        duration = (g_get_real_time () - priv->request_start_time) / 1000;
-        if (duration > ((gint64) 1000)) {
-            gtk_label_set_label (self->request_duration_label, g_strdup_printf ("%g s", (gdouble) (duration / 1000)));
-        } else {
-            gtk_label_set_label (self->request_duration_label, g_strdup_printf ("%g ms", (gdouble) duration));
-        }
-    }
+    const RequestTimings * timings = request_timings_get (msg);
+    gint64 duration = timings != NULL ? request_timings_get_total (timings) : 0;
 
-    priv->request_start_time = (gint64) 0;
+    gchar * formatted_duration = request_timings_format_duration (duration);
+    gtk_label_set_label (self->request_duration_label, formatted_duration);
+    g_free (formatted_duration);
 
-    gtk_label_set_label (self->request_size_label, request_response_bar_get_response_size (msg->response_body->length));
+    request_timing_waterfall_set_timings (self->request_waterfall, timings);
+
+    gchar * size = request_format_transfer_size (wire_length, decoded_length);
+    gtk_label_set_label (self->request_size_label, size);
+    g_free (size);
+
+    RequestCacheSource cache_source = request_cache_get_source (msg);
+    gtk_label_set_label (self->request_cache_label, request_cache_get_source_name (cache_source));
+    gtk_widget_set_visible (GTK_WIDGET (self->request_cache_label), request_cache_is_enabled ());
+
+    // A transport error or a cache hit never got a connection, reused or not
+    gtk_widget_set_visible (GTK_WIDGET (self->request_connection_label), timings != NULL && !SOUP_STATUS_IS_TRANSPORT_ERROR (msg->status_code) && cache_source == CACHE_SOURCE_NETWORK);
+    if (timings != NULL) {
+        gtk_label_set_label (self->request_connection_label, request_timings_get_connection_reused (timings) ? "Reused connection" : "New connection"); // FIXME: Handle translations
+    }
 
     gtk_widget_set_opacity (GTK_WIDGET (self->request_bar), 1);
 
@@ -27,6 +27,7 @@ G_DECLARE_FINAL_TYPE (RequestResponseBar, request_response_bar, REQUEST, RESPONS
 
 RequestResponseBar * request_response_bar_new (void);
 void request_response_bar_on_message_begin (SoupMessage * msg, RequestResponseBar * self);
-void request_response_bar_on_message_received (SoupMessage * msg, RequestResponseBar * self);
+void request_response_bar_show_error (RequestResponseBar * self, const gchar * message);
+void request_response_bar_on_message_received (SoupMessage * msg, goffset wire_length, goffset decoded_length, RequestResponseBar * self);
 
 G_END_DECLS
\ No newline at end of file
@@ -20,14 +20,46 @@
 #include "request-response-panel.h"
 #include "request-header-list.h"
 #include "request-source-view.h"
+#include "request-large-text-view.h"
+#include "request-json-tree-view.h"
+#include "request-search.h"
+#include "request-diff.h"
+#include "request-diff-view.h"
 
 struct _RequestResponsePanel {
     GObject parent_instance;
 
     GtkNotebook * container;
+    GtkStack * view_stack;
+    GtkStack * body_stack;
+    GtkWidget * view_switcher;
+
+    // Search in the body
+    GtkSearchBar * search_bar;
+    GtkEditable * search_entry;
+    GtkToggleButton * regex_button;
+    GtkLabel * search_label;
+    GBytes * body;
+    gboolean is_large_body;
+    RequestSearch * search;
+    guint current_match;
+
+    // Diff against a pinned response
+    GtkWidget * diff_page;
+    GtkToggleButton * pin_button;
+    RequestDiffView * body_diff_view;
+    RequestDiffView * headers_diff_view;
+    GBytes * headers_text;
+    gboolean is_json_body;
+    GBytes * pinned_body;
+    GBytes * pinned_headers_text;
+    gboolean is_pinned_json_body;
+    GCancellable * diff_cancellable;
 
     RequestHeaderList * header_list;
     RequestSourceView * source_view;
+    RequestLargeTextView * large_text_view;
+    RequestJsonTreeView * json_tree_view;
 };
 
 struct _RequestResponsePanelClass {
@@ -36,12 +68,310 @@ struct _RequestResponsePanelClass {
 
 G_DEFINE_TYPE (RequestResponsePanel, request_response_panel, G_TYPE_OBJECT);
 
+#define NO_MATCH G_MAXUINT
+
+static void request_response_panel_finalize (GObject * object) {
+    RequestResponsePanel * self = REQUEST_RESPONSE_PANEL (object);
+
+    if (self->search != NULL) {
+        request_search_cancel (self->search);
+        g_clear_object (&self->search);
+    }
+
+    if (self->diff_cancellable != NULL) {
+        g_cancellable_cancel (self->diff_cancellable);
+        g_clear_object (&self->diff_cancellable);
+    }
+
+    g_clear_pointer (&self->body, g_bytes_unref);
+    g_clear_pointer (&self->headers_text, g_bytes_unref);
+    g_clear_pointer (&self->pinned_body, g_bytes_unref);
+    g_clear_pointer (&self->pinned_headers_text, g_bytes_unref);
+
+    G_OBJECT_CLASS (request_response_panel_parent_class)->finalize (object);
+}
+
 static void request_response_panel_class_init (RequestResponsePanelClass * klass) {
-    (void) klass;
+    G_OBJECT_CLASS (klass)->finalize = request_response_panel_finalize;
 }
 
 static void request_response_panel_init (RequestResponsePanel * self) {
-    (void) self;
+    self->current_match = NO_MATCH;
+}
+
+static void request_response_panel_update_search_label (RequestResponsePanel * self) {
+    if (self->search == NULL) {
+        gtk_label_set_text (self->search_label, "");
+        return;
+    }
+
+    guint n_matches = request_search_get_n_matches (self->search);
+    gboolean is_complete = request_search_is_complete (self->search);
+
+    // FIXME: Handle translations
+    if (n_matches == 0) {
+        gtk_label_set_text (self->search_label, is_complete ? "No matches" : "Searching…");
+        return;
+    }
+
+    gchar * text = g_strdup_printf ("%u of %u%s", self->current_match + 1, n_matches,
+                                    request_search_is_truncated (self->search) ? "+" : is_complete ? "" : "…");
+    gtk_label_set_text (self->search_label, text);
+    g_free (text);
+}
+
+/**
+ * Scrolls the current match into view, in whichever view shows the body.
+ */
+static void request_response_panel_show_match (RequestResponsePanel * self) {
+    const RequestSearchMatch * match = request_search_get_match (self->search, self->current_match);
+    g_return_if_fail (match != NULL);
+
+    gtk_stack_set_visible_child_name (self->view_stack, "text");
+
+    if (self->is_large_body) {
+        request_large_text_view_select (self->large_text_view, match->offset, match->length);
+    } else {
+        request_source_view_select_range (self->source_view, match->line, match->column, match->length);
+    }
+
+    request_response_panel_update_search_label (self);
+}
+
+static void request_response_panel_on_search_updated (RequestSearch * search, gpointer data) {
+    (void) search;
+    RequestResponsePanel * self = data;
+
+    // Jump to the first match as soon as it is found
+    if (self->current_match == NO_MATCH && request_search_get_n_matches (self->search) > 0) {
+        self->current_match = 0;
+        request_response_panel_show_match (self);
+        return;
+    }
+
+    request_response_panel_update_search_label (self);
+}
+
+static void request_response_panel_stop_search (RequestResponsePanel * self) {
+    if (self->search != NULL) {
+        g_signal_handlers_disconnect_by_func (self->search, request_response_panel_on_search_updated, self);
+        request_search_cancel (self->search);
+        g_clear_object (&self->search);
+    }
+
+    self->current_match = NO_MATCH;
+    gtk_widget_remove_css_class (GTK_WIDGET (self->search_entry), "error");
+    request_response_panel_update_search_label (self);
+}
+
+/**
+ * Searches the body for the text of the search entry, replacing the previous
+ * search.
+ */
+static void request_response_panel_run_search (RequestResponsePanel * self) {
+    request_response_panel_stop_search (self);
+
+    const gchar * pattern = gtk_editable_get_text (self->search_entry);
+    if (self->body == NULL || pattern == NULL || *pattern == '\0' || !gtk_search_bar_get_search_mode (self->search_bar)) {
+        return;
+    }
+
+    GError * error = NULL;
+    RequestSearchMode mode = gtk_toggle_button_get_active (self->regex_button) ? SEARCH_MODE_REGEX : SEARCH_MODE_LITERAL;
+
+    self->search = request_search_new (self->body, pattern, mode, &error);
+    if (self->search == NULL) {
+        gtk_widget_add_css_class (GTK_WIDGET (self->search_entry), "error");
+        gtk_label_set_text (self->search_label, "Invalid expression"); // FIXME: Handle translations
+        g_error_free (error);
+        return;
+    }
+
+    g_signal_connect (self->search, SEARCH_UPDATED_SIGNAL, G_CALLBACK (request_response_panel_on_search_updated), self);
+    request_search_start (self->search);
+    request_response_panel_update_search_label (self);
+}
+
+static void request_response_panel_move_match (RequestResponsePanel * self, gint direction) {
+    if (self->search == NULL || request_search_get_n_matches (self->search) == 0) {
+        return;
+    }
+
+    // Wraps around, the count may still grow
+    guint n_matches = request_search_get_n_matches (self->search);
+    self->current_match = (self->current_match + n_matches + direction) % n_matches;
+
+    request_response_panel_show_match (self);
+}
+
+static void request_response_panel_on_search_changed (GtkWidget * widget, gpointer data) {
+    (void) widget;
+
+    request_response_panel_run_search (data);
+}
+
+static void request_response_panel_on_next_match (GtkWidget * widget, gpointer data) {
+    (void) widget;
+
+    request_response_panel_move_match (data, 1);
+}
+
+static void request_response_panel_on_previous_match (GtkWidget * widget, gpointer data) {
+    (void) widget;
+
+    request_response_panel_move_match (data, -1);
+}
+
+static void request_response_panel_on_search_mode_changed (GObject * object, GParamSpec * pspec, gpointer data) {
+    (void) object;
+    (void) pspec;
+
+    request_response_panel_run_search (data);
+}
+
+static gboolean request_response_panel_on_find_shortcut (GtkWidget * widget, GVariant * args, gpointer data) {
+    (void) widget;
+    (void) args;
+    RequestResponsePanel * self = data;
+
+    gtk_search_bar_set_search_mode (self->search_bar, TRUE);
+    gtk_widget_grab_focus (GTK_WIDGET (self->search_entry));
+
+    return TRUE;
+}
+
+/**
+ * Builds the search bar of the body page: literal or regex search in the raw
+ * body, with the number of matches and next/previous navigation.
+ */
+static GtkWidget * request_response_panel_create_search_bar (RequestResponsePanel * self) {
+    GtkWidget * entry = gtk_search_entry_new ();
+    gtk_widget_set_hexpand (entry, TRUE);
+    self->search_entry = GTK_EDITABLE (entry);
+
+    GtkWidget * regex_button = gtk_toggle_button_new_with_label (".*");
+    gtk_widget_set_tooltip_text (regex_button, "Regular expression"); // FIXME: Handle translations
+    self->regex_button = GTK_TOGGLE_BUTTON (regex_button);
+
+    GtkWidget * label = gtk_label_new (NULL);
+    gtk_widget_add_css_class (label, "dim-label");
+    self->search_label = GTK_LABEL (label);
+
+    GtkWidget * previous_button = gtk_button_new_from_icon_name ("go-up-symbolic");
+    gtk_widget_set_tooltip_text (previous_button, "Previous match"); // FIXME: Handle translations
+
+    GtkWidget * next_button = gtk_button_new_from_icon_name ("go-down-symbolic");
+    gtk_widget_set_tooltip_text (next_button, "Next match"); // FIXME: Handle translations
+
+    GtkWidget * box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_box_append (GTK_BOX (box), entry);
+    gtk_box_append (GTK_BOX (box), regex_button);
+    gtk_box_append (GTK_BOX (box), label);
+    gtk_box_append (GTK_BOX (box), previous_button);
+    gtk_box_append (GTK_BOX (box), next_button);
+
+    GtkWidget * search_bar = gtk_search_bar_new ();
+    gtk_search_bar_set_child (GTK_SEARCH_BAR (search_bar), box);
+    gtk_search_bar_connect_entry (GTK_SEARCH_BAR (search_bar), self->search_entry);
+    gtk_search_bar_set_show_close_button (GTK_SEARCH_BAR (search_bar), TRUE);
+    self->search_bar = GTK_SEARCH_BAR (search_bar);
+
+    g_signal_connect (entry, "search-changed", G_CALLBACK (request_response_panel_on_search_changed), self);
+    g_signal_connect (entry, "activate", G_CALLBACK (request_response_panel_on_next_match), self);
+    g_signal_connect (entry, "next-match", G_CALLBACK (request_response_panel_on_next_match), self);
+    g_signal_connect (entry, "previous-match", G_CALLBACK (request_response_panel_on_previous_match), self);
+    g_signal_connect (regex_button, "toggled", G_CALLBACK (request_response_panel_on_search_changed), self);
+    g_signal_connect (next_button, "clicked", G_CALLBACK (request_response_panel_on_next_match), self);
+    g_signal_connect (previous_button, "clicked", G_CALLBACK (request_response_panel_on_previous_match), self);
+    g_signal_connect (search_bar, "notify::search-mode-enabled", G_CALLBACK (request_response_panel_on_search_mode_changed), self);
+
+    return search_bar;
+}
+
+static void on_diff_ready (GObject * source_object, GAsyncResult * result, gpointer data) {
+    (void) source_object;
+    GError * error = NULL;
+
+    RequestDiff * diff = request_diff_new_finish (result, &error);
+    if (diff == NULL) {
+        // Replaced by a newer response or unpinned, the view may be gone
+        g_error_free (error);
+        return;
+    }
+
+    request_diff_view_set_diff (REQUEST_DIFF_VIEW (data), diff);
+    request_diff_unref (diff);
+}
+
+/**
+ * Compares the current response with the pinned one, on worker threads.
+ */
+static void request_response_panel_run_diff (RequestResponsePanel * self) {
+    if (self->diff_cancellable != NULL) {
+        g_cancellable_cancel (self->diff_cancellable);
+        g_clear_object (&self->diff_cancellable);
+    }
+
+    request_diff_view_set_diff (self->body_diff_view, NULL);
+    request_diff_view_set_diff (self->headers_diff_view, NULL);
+
+    if (self->pinned_body == NULL || self->body == NULL) {
+        return;
+    }
+
+    self->diff_cancellable = g_cancellable_new ();
+    request_diff_new_async (self->pinned_body, self->body, self->is_pinned_json_body || self->is_json_body, self->diff_cancellable, on_diff_ready, self->body_diff_view);
+
+    if (self->pinned_headers_text != NULL && self->headers_text != NULL) {
+        request_diff_new_async (self->pinned_headers_text, self->headers_text, FALSE, self->diff_cancellable, on_diff_ready, self->headers_diff_view);
+    }
+}
+
+static void request_response_panel_on_pin_toggled (GtkToggleButton * button, gpointer data) {
+    RequestResponsePanel * self = data;
+    gboolean is_pinned = gtk_toggle_button_get_active (button);
+
+    g_clear_pointer (&self->pinned_body, g_bytes_unref);
+    g_clear_pointer (&self->pinned_headers_text, g_bytes_unref);
+
+    if (is_pinned && self->body != NULL) {
+        self->pinned_body = g_bytes_ref (self->body);
+        self->pinned_headers_text = self->headers_text != NULL ? g_bytes_ref (self->headers_text) : NULL;
+        self->is_pinned_json_body = self->is_json_body;
+    }
+
+    gtk_widget_set_visible (self->diff_page, self->pinned_body != NULL);
+    request_response_panel_run_diff (self);
+}
+
+static gint request_response_panel_compare_headers (gconstpointer a, gconstpointer b) {
+    return g_ascii_strcasecmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+/**
+ * Builds the diff page: the body and the headers of the current response
+ * against the pinned one.
+ */
+static GtkWidget * request_response_panel_create_diff_page (RequestResponsePanel * self) {
+    self->body_diff_view = request_diff_view_new ();
+    gtk_widget_set_vexpand (GTK_WIDGET (self->body_diff_view), TRUE);
+
+    self->headers_diff_view = request_diff_view_new ();
+    gtk_widget_set_vexpand (GTK_WIDGET (self->headers_diff_view), TRUE);
+
+    GtkStack * stack = GTK_STACK (gtk_stack_new ());
+    gtk_stack_add_titled (stack, GTK_WIDGET (self->body_diff_view), "body", "Body"); // FIXME: Handle translations
+    gtk_stack_add_titled (stack, GTK_WIDGET (self->headers_diff_view), "headers", "Headers"); // FIXME: Handle translations
+
+    GtkWidget * switcher = gtk_stack_switcher_new ();
+    gtk_stack_switcher_set_stack (GTK_STACK_SWITCHER (switcher), stack);
+    gtk_widget_set_halign (switcher, GTK_ALIGN_CENTER);
+
+    GtkWidget * box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+    gtk_box_append (GTK_BOX (box), switcher);
+    gtk_box_append (GTK_BOX (box), GTK_WIDGET (stack));
+
+    return box;
 }
 
 RequestResponsePanel * request_response_panel_new (void) {
@@ -49,18 +379,82 @@ RequestResponsePanel * request_response_panel_new (void) {
     GtkWidget * notebook = gtk_notebook_new ();
     self->container = GTK_NOTEBOOK (notebook);
 
-    self->header_list = request_header_list_new ();
+    self->header_list = request_header_list_new_readonly ();
     g_return_if_fail (self->header_list != NULL);
 
     self->source_view = request_source_view_new (TRUE);
     g_return_if_fail (self->source_view != NULL);
 
+    self->large_text_view = request_large_text_view_new ();
+    g_return_if_fail (self->large_text_view != NULL);
+
+    // Bodies too large for the source view are shown by the large text view
+    GtkWidget * large_text_scroll_view = gtk_scrolled_window_new ();
+    gtk_scrolled_window_set_child (GTK_SCROLLED_WINDOW (large_text_scroll_view), GTK_WIDGET (self->large_text_view));
+
+    self->body_stack = GTK_STACK (gtk_stack_new ());
+    gtk_stack_add_named (self->body_stack, GTK_WIDGET (self->source_view), "source");
+    gtk_stack_add_named (self->body_stack, large_text_scroll_view, "large");
+
+    // JSON bodies can also be browsed as a tree
+    self->json_tree_view = request_json_tree_view_new ();
+    gtk_widget_set_vexpand (GTK_WIDGET (self->json_tree_view), TRUE);
+
+    self->view_stack = GTK_STACK (gtk_stack_new ());
+    gtk_stack_add_titled (self->view_stack, GTK_WIDGET (self->body_stack), "text", "Text"); // FIXME: Handle translations
+    gtk_stack_add_titled (self->view_stack, GTK_WIDGET (self->json_tree_view), "tree", "Tree"); // FIXME: Handle translations
+
+    self->view_switcher = gtk_stack_switcher_new ();
+    gtk_stack_switcher_set_stack (GTK_STACK_SWITCHER (self->view_switcher), self->view_stack);
+    gtk_widget_set_halign (self->view_switcher, GTK_ALIGN_CENTER);
+    gtk_widget_set_hexpand (self->view_switcher, TRUE);
+    gtk_widget_set_visible (self->view_switcher, FALSE);
+
+    GtkWidget * search_bar = request_response_panel_create_search_bar (self);
+
+    GtkWidget * find_button = gtk_toggle_button_new ();
+    gtk_button_set_icon_name (GTK_BUTTON (find_button), "edit-find-symbolic");
+    gtk_widget_set_tooltip_text (find_button, "Search in the body"); // FIXME: Handle translations
+    gtk_widget_set_halign (find_button, GTK_ALIGN_END);
+    g_object_bind_property (find_button, "active", search_bar, "search-mode-enabled", G_BINDING_BIDIRECTIONAL | G_BINDING_SYNC_CREATE);
+
+    // Pinning keeps the response to compare the next ones with
+    GtkWidget * pin_button = gtk_toggle_button_new ();
+    gtk_button_set_icon_name (GTK_BUTTON (pin_button), "view-pin-symbolic");
+    gtk_widget_set_tooltip_text (pin_button, "Pin this response to compare the next ones with it"); // FIXME: Handle translations
+    gtk_widget_set_sensitive (pin_button, FALSE);
+    g_signal_connect (pin_button, "toggled", G_CALLBACK (request_response_panel_on_pin_toggled), self);
+    self->pin_button = GTK_TOGGLE_BUTTON (pin_button);
+
+    GtkWidget * body_toolbar = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+    gtk_box_append (GTK_BOX (body_toolbar), self->view_switcher);
+    gtk_box_append (GTK_BOX (body_toolbar), pin_button);
+    gtk_box_append (GTK_BOX (body_toolbar), find_button);
+
+    GtkWidget * body_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+    gtk_box_append (GTK_BOX (body_box), body_toolbar);
+    gtk_box_append (GTK_BOX (body_box), search_bar);
+    gtk_box_append (GTK_BOX (body_box), GTK_WIDGET (self->view_stack));
+
+    // Ctrl+F opens the search bar from anywhere in the body page
+    GtkEventController * shortcuts = gtk_shortcut_controller_new ();
+    gtk_shortcut_controller_set_scope (GTK_SHORTCUT_CONTROLLER (shortcuts), GTK_SHORTCUT_SCOPE_LOCAL);
+    gtk_shortcut_controller_add_shortcut (GTK_SHORTCUT_CONTROLLER (shortcuts),
+                                          gtk_shortcut_new (gtk_shortcut_trigger_parse_string ("<Control>f"),
+                                                            gtk_callback_action_new (request_response_panel_on_find_shortcut, self, NULL)));
+    gtk_widget_add_controller (body_box, shortcuts);
+
     // TODO: Create a RequestLabelWithBadge widget
     GtkWidget * body_label = gtk_label_new ("Body"); // FIXME: Handle translations
     GtkWidget * header_list_label = gtk_label_new ("Headers"); // FIXME: Handle translations
+    GtkWidget * diff_label = gtk_label_new ("Diff"); // FIXME: Handle translations
 
-    gtk_notebook_append_page (self->container, GTK_WIDGET (self->source_view), GTK_WIDGET (body_label));
+    self->diff_page = request_response_panel_create_diff_page (self);
+    gtk_widget_set_visible (self->diff_page, FALSE);
+
+    gtk_notebook_append_page (self->container, body_box, GTK_WIDGET (body_label));
     gtk_notebook_append_page (self->container, GTK_WIDGET (request_header_list_get_view (self->header_list)), GTK_WIDGET (header_list_label));
+    gtk_notebook_append_page (self->container, self->diff_page, diff_label);
 
     return self;
 }
@@ -77,12 +471,94 @@ RequestSourceView * request_response_panel_get_source_view (RequestResponsePanel
     return self->source_view;
 }
 
-void request_response_panel_set_headers (RequestResponsePanel * self, GSList * headers) {
-    request_header_list_empty (self->header_list); // clear previous headers
-    while (headers != NULL) {
-        RequestHeaderListRow * row = (RequestHeaderListRow *) headers->data;
-        headers = headers->next;
+RequestLargeTextView * request_response_panel_get_large_text_view (RequestResponsePanel * self) {
+    return self->large_text_view;
+}
 
-        request_header_list_add_row (self->header_list, row);
+/**
+ * Switches the body page between the source view and the large text view.
+ */
+void request_response_panel_set_is_large_body (RequestResponsePanel * self, gboolean is_large_body) {
+    self->is_large_body = is_large_body;
+    gtk_stack_set_visible_child_name (self->body_stack, is_large_body ? "large" : "source");
+
+    if (!is_large_body) {
+        request_large_text_view_clear (self->large_text_view); // release the body
     }
 }
+
+void request_response_panel_set_headers (RequestResponsePanel * self, SoupMessageHeaders * headers) {
+    request_header_list_set_headers (self->header_list, headers);
+
+    // Kept as sorted "Name: value" lines for the diff, the order of the
+    // headers is rarely meaningful
+    g_clear_pointer (&self->headers_text, g_bytes_unref);
+    self->is_json_body = FALSE;
+    if (headers == NULL) {
+        return;
+    }
+
+    // JSON bodies are compared once beautified
+    const gchar * content_type = soup_message_headers_get_content_type (headers, NULL);
+    self->is_json_body = content_type != NULL && g_strstr_len (content_type, -1, "json") != NULL;
+
+    GPtrArray * lines = g_ptr_array_new_with_free_func (g_free);
+    SoupMessageHeadersIter iter;
+    const gchar * name;
+    const gchar * value;
+
+    soup_message_headers_iter_init (&iter, headers);
+    while (soup_message_headers_iter_next (&iter, &name, &value)) {
+        g_ptr_array_add (lines, g_strdup_printf ("%s: %s\n", name, value));
+    }
+
+    g_ptr_array_sort (lines, request_response_panel_compare_headers);
+
+    GString * text = g_string_new (NULL);
+    for (guint i = 0; i < lines->len; i++) {
+        g_string_append (text, g_ptr_array_index (lines, i));
+    }
+
+    self->headers_text = g_string_free_to_bytes (text);
+    g_ptr_array_unref (lines);
+}
+
+/**
+ * Offers the tree view of the body when index is set, hides it otherwise.
+ */
+void request_response_panel_set_json_index (RequestResponsePanel * self, RequestJsonIndex * index) {
+    request_json_tree_view_set_index (self->json_tree_view, index);
+    gtk_widget_set_visible (self->view_switcher, index != NULL);
+
+    if (index == NULL) {
+        gtk_stack_set_visible_child_name (self->view_stack, "text");
+    }
+}
+
+/**
+ * Switches the body page between the text and the tree of a JSON body.
+ */
+void request_response_panel_show_json_tree (RequestResponsePanel * self, gboolean show_tree) {
+    gtk_stack_set_visible_child_name (self->view_stack, show_tree ? "tree" : "text");
+}
+
+/**
+ * Sets the raw body searched by the search bar, NULL while no complete body is
+ * available. A search in progress is run again on the new body, and the body
+ * is compared with the pinned one if any.
+ */
+void request_response_panel_set_body (RequestResponsePanel * self, GBytes * body) {
+    g_clear_pointer (&self->body, g_bytes_unref);
+
+    if (body != NULL) {
+        self->body = g_bytes_ref (body);
+    }
+
+    gtk_widget_set_sensitive (GTK_WIDGET (self->pin_button), self->body != NULL || self->pinned_body != NULL);
+
+    request_response_panel_run_search (self);
+
+    // Cleared until the new body is complete, the diff of the previous one
+    // must not be shown against it
+    request_response_panel_run_diff (self);
+}
@@ -21,6 +21,8 @@
 
 #include "request-header-list.h"
 #include "request-source-view.h"
+#include "request-large-text-view.h"
+#include "request-json-index.h"
 
 G_BEGIN_DECLS
 
@@ -32,6 +34,11 @@ RequestResponsePanel * request_response_panel_new (void);
 GtkWidget * request_response_panel_get_view (RequestResponsePanel * self);
 RequestHeaderList * request_response_panel_get_header_list_view (RequestResponsePanel * self);
 RequestSourceView * request_response_panel_get_source_view (RequestResponsePanel * self);
-void request_response_panel_set_headers (RequestResponsePanel * self, GSList * headers);
+RequestLargeTextView * request_response_panel_get_large_text_view (RequestResponsePanel * self);
+void request_response_panel_set_is_large_body (RequestResponsePanel * self, gboolean is_large_body);
+void request_response_panel_set_json_index (RequestResponsePanel * self, RequestJsonIndex * index);
+void request_response_panel_show_json_tree (RequestResponsePanel * self, gboolean show_tree);
+void request_response_panel_set_body (RequestResponsePanel * self, GBytes * body);
+void request_response_panel_set_headers (RequestResponsePanel * self, SoupMessageHeaders * headers);
 
 G_END_DECLS
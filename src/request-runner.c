@@ -0,0 +1,460 @@
+/* request-runner.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <libsoup/soup.h>
+#include <jansson.h>
+#include <string.h>
+
+#include "request-runner.h"
+#include "request-histogram.h"
+#include "request-mock-server.h"
+#include "request-session.h"
+#include "request-timings.h"
+#include "request-transfer.h"
+#include "request-upload.h"
+#include "request-url.h"
+
+#define RUNNER_HIGHEST_LATENCY (10 * 60 * G_USEC_PER_SEC) // anything slower is clamped
+#define RUNNER_SIGNIFICANT_DIGITS 3
+
+// Keys of the phases in the JSON report, same order as RequestTimingPhase
+static const gchar * phase_keys[TIMING_PHASE_COUNT] = {
+    "queue", "dns", "connect", "tls", "send", "wait", "download",
+};
+
+typedef struct RequestRunner {
+    GMainLoop * loop;
+    SoupSession * session;
+
+    gchar * method;
+    gchar * url;
+    const gchar * base_url; // of the mock server, NULL when not started
+    GHashTable * headers;
+    gchar * body;
+    gsize body_length;
+    gchar * body_file;
+    gboolean is_chunked;
+    GPtrArray * form; // name, value, name, value...
+    gchar * directory; // of the request file, for relative paths
+
+    guint repeat;
+    guint iteration;
+    guint failures;
+    guint64 received_length;
+    guint64 decoded_length;
+    gint64 phase_totals[TIMING_PHASE_COUNT];
+    RequestHistogram * latencies;
+    GHashTable * statuses; // status code -> count
+} RequestRunner;
+
+static gchar * runner_file = NULL;
+static gint runner_repeat = 1;
+static gchar * runner_json_out = NULL;
+static gboolean runner_mock = FALSE;
+static gint runner_mock_port = 0;
+static gint runner_mock_latency = 0;
+static gint runner_mock_bandwidth = 0;
+
+static GOptionEntry runner_entries[] = {
+    { "run", 0, 0, G_OPTION_ARG_FILENAME, &runner_file, "Send the request saved in FILE without opening a window", "FILE" },
+    { "repeat", 0, 0, G_OPTION_ARG_INT, &runner_repeat, "Number of times the request is sent (default: 1)", "N" },
+    { "json-out", 0, 0, G_OPTION_ARG_FILENAME, &runner_json_out, "Write latency statistics to FILE as JSON", "FILE" },
+    { "mock", 0, 0, G_OPTION_ARG_NONE, &runner_mock, "Start the local mock server, URLs starting with / in FILE are sent to it", NULL },
+    { "mock-port", 0, 0, G_OPTION_ARG_INT, &runner_mock_port, "Port of the mock server (default: any free port)", "PORT" },
+    { "mock-latency", 0, 0, G_OPTION_ARG_INT, &runner_mock_latency, "Delay in ms before each mock response", "MS" },
+    { "mock-bandwidth", 0, 0, G_OPTION_ARG_INT, &runner_mock_bandwidth, "Speed in KB/s of the mock responses, like the mock-bandwidth setting (default: unlimited)", "KB" },
+    { NULL },
+};
+
+/**
+ * Loads a request saved as JSON:
+ *
+ *   { "method": "POST", "url": "https://...", "headers": { "Name": "value" }, "body": "..." }
+ *
+ * or, to upload a file without loading it, "body_file": "path" (relative to
+ * the request file) with "chunked": true for chunked framing, or a
+ * multipart/form-data body with "form": { "name": "value", "file": "@path" }.
+ *
+ * Only url is mandatory, method defaults to GET. A url starting with / is
+ * relative to the mock server.
+ */
+static gboolean request_runner_load (RequestRunner * self, const gchar * path, GError ** error) {
+    gchar * contents;
+    gsize length;
+
+    if (!g_file_get_contents (path, &contents, &length, error)) {
+        return FALSE;
+    }
+
+    json_error_t json_error;
+    json_t * json = json_loadb (contents, length, 0, &json_error);
+    g_free (contents);
+
+    if (json == NULL) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "%s: invalid JSON at line %d, column %d: %s", path, json_error.line, json_error.column, json_error.text);
+        return FALSE;
+    }
+
+    if (!json_is_object (json)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "%s: expected an object", path);
+        json_decref (json);
+        return FALSE;
+    }
+
+    const char * method = json_string_value (json_object_get (json, "method"));
+    const char * url = json_string_value (json_object_get (json, "url"));
+    if (url == NULL) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "%s: missing \"url\"", path);
+        json_decref (json);
+        return FALSE;
+    }
+
+    if (url[0] == '/' && self->base_url != NULL) {
+        gchar * absolute = g_strconcat (self->base_url, url + 1, NULL); // base_url ends with a /
+        self->url = request_url_normalize (absolute, error);
+        g_free (absolute);
+    } else {
+        self->url = request_url_normalize (url, error);
+    }
+    if (self->url == NULL) {
+        json_decref (json);
+        return FALSE;
+    }
+
+    self->method = g_ascii_strup (method != NULL ? method : "GET", -1);
+
+    const char * key;
+    json_t * value;
+    json_object_foreach (json_object_get (json, "headers"), key, value) {
+        if (json_is_string (value)) {
+            g_hash_table_insert (self->headers, g_strdup (key), g_strdup (json_string_value (value)));
+        }
+    }
+
+    json_t * body = json_object_get (json, "body");
+    if (json_is_string (body)) {
+        self->body_length = json_string_length (body);
+        self->body = g_malloc (self->body_length);
+        memcpy (self->body, json_string_value (body), self->body_length);
+    }
+
+    self->directory = g_path_get_dirname (path);
+
+    json_object_foreach (json_object_get (json, "form"), key, value) {
+        if (json_is_string (value)) {
+            g_ptr_array_add (self->form, g_strdup (key));
+            g_ptr_array_add (self->form, g_strdup (json_string_value (value)));
+        }
+    }
+
+    const char * body_file = json_string_value (json_object_get (json, "body_file"));
+    if (body_file != NULL) {
+        self->body_file = g_path_is_absolute (body_file) ? g_strdup (body_file) : g_build_filename (self->directory, body_file, NULL);
+        self->is_chunked = json_is_true (json_object_get (json, "chunked"));
+
+        if (!g_file_test (self->body_file, G_FILE_TEST_IS_REGULAR)) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "%s: no such file \"%s\"", path, self->body_file);
+            json_decref (json);
+            return FALSE;
+        }
+    }
+
+    json_decref (json);
+
+    return TRUE;
+}
+
+static SoupMessage * request_runner_build_message (RequestRunner * self) {
+    SoupMessage * msg = soup_message_new (self->method, self->url);
+
+    GHashTableIter iter;
+    gpointer name, value;
+    g_hash_table_iter_init (&iter, self->headers);
+    while (g_hash_table_iter_next (&iter, &name, &value)) {
+        soup_message_headers_append (msg->request_headers, name, value);
+    }
+
+    if (self->form->len > 0) {
+        SoupMultipart * form = request_upload_form_new ();
+        GError * error = NULL;
+
+        for (guint i = 0; i + 1 < self->form->len; i += 2) {
+            if (!request_upload_form_append (form, self->form->pdata[i], self->form->pdata[i + 1], self->directory, &error)) {
+                g_printerr ("%s\n", error->message); // the field is left out
+                g_clear_error (&error);
+            }
+        }
+
+        request_upload_set_form (msg, form);
+        soup_multipart_free (form);
+    } else if (self->body_file != NULL) {
+        GError * error = NULL;
+        if (!request_upload_set_file (msg, self->body_file, self->is_chunked ? UPLOAD_FRAMING_CHUNKED : UPLOAD_FRAMING_CONTENT_LENGTH, &error)) {
+            g_printerr ("%s\n", error->message); // sent without a body, the server tells what it thinks of it
+            g_error_free (error);
+        }
+    } else if (self->body != NULL) {
+        // Content-Type stays the one from the file, if any
+        soup_message_body_append (msg->request_body, SOUP_MEMORY_STATIC, self->body, self->body_length);
+    }
+
+    return msg;
+}
+
+static void request_runner_send_next (RequestRunner * self);
+
+static void request_runner_on_completed (RequestTransfer * transfer, gpointer data) {
+    RequestRunner * self = data;
+    SoupMessage * msg = request_transfer_get_message (transfer);
+    const GError * error = request_transfer_get_error (transfer);
+    RequestTimings * timings = request_timings_get (msg);
+
+    self->iteration++;
+
+    gint64 total = timings != NULL ? request_timings_get_total (timings) : 0;
+    gchar * formatted = request_timings_format_duration (total);
+
+    if (error != NULL) {
+        self->failures++;
+        g_printerr ("%u: %s\n", self->iteration, error->message);
+    } else {
+        if (msg->status_code < 200 || msg->status_code >= 400) {
+            self->failures++;
+        }
+
+        request_histogram_record_value (self->latencies, total);
+        for (gint phase = 0; phase < TIMING_PHASE_COUNT; phase++) {
+            self->phase_totals[phase] += request_timings_get_phase_duration (timings, phase);
+        }
+
+        guint count = GPOINTER_TO_UINT (g_hash_table_lookup (self->statuses, GUINT_TO_POINTER (msg->status_code)));
+        g_hash_table_insert (self->statuses, GUINT_TO_POINTER (msg->status_code), GUINT_TO_POINTER (count + 1));
+
+        self->received_length += request_transfer_get_received_length (transfer);
+        self->decoded_length += request_transfer_get_decoded_length (transfer);
+
+        g_print ("%u: %u %s, %s\n", self->iteration, msg->status_code, msg->reason_phrase, formatted);
+    }
+
+    g_free (formatted);
+
+    if (self->iteration < self->repeat) {
+        request_runner_send_next (self);
+    } else {
+        g_main_loop_quit (self->loop);
+    }
+}
+
+static void request_runner_send_next (RequestRunner * self) {
+    SoupMessage * msg = request_runner_build_message (self);
+    RequestTransfer * transfer = request_transfer_new (self->session, msg);
+    g_object_unref (msg);
+
+    g_signal_connect (transfer, TRANSFER_COMPLETED_SIGNAL, G_CALLBACK (request_runner_on_completed), self);
+    request_transfer_start (transfer);
+
+    // The transfer keeps itself alive until it completes
+    g_object_unref (transfer);
+}
+
+static void request_runner_print_summary (RequestRunner * self) {
+    const gchar * labels[] = { "min", "p50", "p90", "p99", "p99.9", "max" };
+    gint64 values[] = {
+        request_histogram_get_min (self->latencies),
+        request_histogram_get_value_at_percentile (self->latencies, 50),
+        request_histogram_get_value_at_percentile (self->latencies, 90),
+        request_histogram_get_value_at_percentile (self->latencies, 99),
+        request_histogram_get_value_at_percentile (self->latencies, 99.9),
+        request_histogram_get_max (self->latencies),
+    };
+
+    g_print ("\n%u requests, %u failed\n", self->repeat, self->failures);
+
+    for (gsize i = 0; i < G_N_ELEMENTS (labels); i++) {
+        gchar * formatted = request_timings_format_duration (values[i]);
+        g_print ("%-6s %s\n", labels[i], formatted);
+        g_free (formatted);
+    }
+}
+
+static gboolean request_runner_write_json (RequestRunner * self, const gchar * path, GError ** error) {
+    json_t * latency = json_pack ("{s:I, s:f, s:I, s:I, s:I, s:I, s:I}",
+        "min", (json_int_t) request_histogram_get_min (self->latencies),
+        "mean", request_histogram_get_mean (self->latencies),
+        "p50", (json_int_t) request_histogram_get_value_at_percentile (self->latencies, 50),
+        "p90", (json_int_t) request_histogram_get_value_at_percentile (self->latencies, 90),
+        "p99", (json_int_t) request_histogram_get_value_at_percentile (self->latencies, 99),
+        "p99.9", (json_int_t) request_histogram_get_value_at_percentile (self->latencies, 99.9),
+        "max", (json_int_t) request_histogram_get_max (self->latencies));
+
+    gint64 succeeded = request_histogram_get_total_count (self->latencies);
+    json_t * phases = json_object ();
+    for (gint phase = 0; phase < TIMING_PHASE_COUNT; phase++) {
+        json_int_t mean = succeeded > 0 ? self->phase_totals[phase] / succeeded : 0;
+        json_object_set_new (phases, phase_keys[phase], json_integer (mean));
+    }
+
+    json_t * statuses = json_object ();
+    GHashTableIter iter;
+    gpointer code, count;
+    g_hash_table_iter_init (&iter, self->statuses);
+    while (g_hash_table_iter_next (&iter, &code, &count)) {
+        gchar * key = g_strdup_printf ("%u", GPOINTER_TO_UINT (code));
+        json_object_set_new (statuses, key, json_integer (GPOINTER_TO_UINT (count)));
+        g_free (key);
+    }
+
+    // Durations are in µs
+    json_t * report = json_pack ("{s:s, s:s, s:i, s:i, s:I, s:I, s:o, s:o, s:o}",
+        "method", self->method,
+        "url", self->url,
+        "requests", (int) self->repeat,
+        "failures", (int) self->failures,
+        "received_bytes", (json_int_t) self->received_length,
+        "decoded_bytes", (json_int_t) self->decoded_length,
+        "latency_us", latency,
+        "phases_mean_us", phases,
+        "status_codes", statuses);
+
+    gboolean is_written = json_dump_file (report, path, JSON_INDENT (4) | JSON_PRESERVE_ORDER) == 0;
+    json_decref (report);
+
+    if (!is_written) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Cannot write %s", path);
+    }
+
+    return is_written;
+}
+
+static void request_runner_clear (RequestRunner * self) {
+    g_free (self->method);
+    g_free (self->url);
+    g_free (self->body);
+    g_free (self->body_file);
+    g_free (self->directory);
+    g_ptr_array_free (self->form, TRUE);
+    g_hash_table_destroy (self->headers);
+    g_hash_table_destroy (self->statuses);
+    request_histogram_free (self->latencies);
+}
+
+/**
+ * Returns whether the command line asks for a headless run, in which case
+ * request_runner_main() must be used instead of starting the application.
+ */
+gboolean request_runner_is_requested (int argc, char * argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp (argv[i], "--run") == 0 || g_str_has_prefix (argv[i], "--run=") || strcmp (argv[i], "--mock") == 0) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Sends the saved request --repeat times, one after the other, with the same
+ * session and timing code as the window, then prints the latency distribution.
+ * GTK is never initialized so it runs on machines without a display.
+ *
+ * With --mock the mock server runs in the same process, and keeps serving
+ * until interrupted when there is no request to send.
+ */
+int request_runner_main (int argc, char * argv[]) {
+    GError * error = NULL;
+
+    GOptionContext * context = g_option_context_new ("- send a saved request");
+    g_option_context_add_main_entries (context, runner_entries, NULL);
+
+    gboolean is_parsed = g_option_context_parse (context, &argc, &argv, &error);
+    g_option_context_free (context);
+
+    if (!is_parsed) {
+        g_printerr ("%s\n", error->message);
+        g_error_free (error);
+        return RUNNER_STATUS_INVALID_INPUT;
+    }
+
+    if ((runner_file == NULL && !runner_mock) || runner_repeat < 1) {
+        g_printerr ("--run needs a file and --repeat must be at least 1\n");
+        return RUNNER_STATUS_INVALID_INPUT;
+    }
+
+    RequestMockServer * mock = NULL;
+    if (runner_mock) {
+        mock = request_mock_server_new ();
+        request_mock_server_set_latency (mock, (guint) MAX (runner_mock_latency, 0));
+        request_mock_server_set_bandwidth (mock, (guint64) MAX (runner_mock_bandwidth, 0) * 1024);
+
+        if (!request_mock_server_start (mock, (guint) CLAMP (runner_mock_port, 0, G_MAXUINT16), &error)) {
+            g_printerr ("Could not start the mock server: %s\n", error->message);
+            g_error_free (error);
+            g_object_unref (mock);
+            return RUNNER_STATUS_INVALID_INPUT;
+        }
+
+        g_printerr ("Mock server listening on %s\n", request_mock_server_get_url (mock));
+    }
+
+    if (runner_file == NULL) {
+        GMainLoop * loop = g_main_loop_new (NULL, FALSE);
+        g_main_loop_run (loop);
+        g_main_loop_unref (loop);
+        g_object_unref (mock);
+        return RUNNER_STATUS_SUCCESS;
+    }
+
+    RequestRunner self = { 0 };
+    self.headers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    self.statuses = g_hash_table_new (g_direct_hash, g_direct_equal);
+    self.form = g_ptr_array_new_with_free_func (g_free);
+    self.latencies = request_histogram_new (RUNNER_HIGHEST_LATENCY, RUNNER_SIGNIFICANT_DIGITS);
+    self.repeat = (guint) runner_repeat;
+    self.base_url = mock != NULL ? request_mock_server_get_url (mock) : NULL;
+
+    if (!request_runner_load (&self, runner_file, &error)) {
+        g_printerr ("%s\n", error->message);
+        g_clear_error (&error);
+        request_runner_clear (&self);
+        g_clear_object (&mock);
+        return RUNNER_STATUS_INVALID_INPUT;
+    }
+
+    // Same pooled session as the window, minus the header dump on stdout
+    self.session = request_session_get_default ();
+    soup_session_remove_feature_by_type (self.session, SOUP_TYPE_LOGGER);
+
+    self.loop = g_main_loop_new (NULL, FALSE);
+    request_runner_send_next (&self);
+    g_main_loop_run (self.loop);
+    g_main_loop_unref (self.loop);
+
+    request_runner_print_summary (&self);
+
+    int status = self.failures > 0 ? RUNNER_STATUS_REQUEST_FAILED : RUNNER_STATUS_SUCCESS;
+
+    if (runner_json_out != NULL && !request_runner_write_json (&self, runner_json_out, &error)) {
+        g_printerr ("%s\n", error->message);
+        g_clear_error (&error);
+        status = RUNNER_STATUS_INVALID_INPUT;
+    }
+
+    request_runner_clear (&self);
+    g_clear_object (&mock);
+
+    return status;
+}
@@ -0,0 +1,36 @@
+/* request-runner.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Exit statuses of the headless runner.
+ */
+typedef enum RequestRunnerStatus {
+    RUNNER_STATUS_SUCCESS = 0, // every request got a 2xx or 3xx response
+    RUNNER_STATUS_REQUEST_FAILED = 1, // at least one request failed or got a 4xx/5xx
+    RUNNER_STATUS_INVALID_INPUT = 2, // bad arguments or unreadable request file
+} RequestRunnerStatus;
+
+gboolean request_runner_is_requested (int argc, char * argv[]);
+int request_runner_main (int argc, char * argv[]);
+
+G_END_DECLS
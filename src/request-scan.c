@@ -0,0 +1,565 @@
+/* request-scan.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "request-scan.h"
+
+#if (defined (__x86_64__) || defined (__i386__)) && (defined (__GNUC__) || defined (__clang__))
+#define HAVE_SCAN_X86 1
+#include <immintrin.h>
+#else
+#define HAVE_SCAN_X86 0
+#endif
+
+/**
+ * Byte class scanners for JSON and body search.
+ *
+ * Most kernels return the offset of the first byte of a class: the end of a
+ * run of plain string characters, of whitespace, or the next structural
+ * character. The others find a substring and count newlines. The SIMD versions classify 16 (SSE2) or 32 (AVX2) bytes per
+ * iteration and hand the tail over to the scalar version. The fastest one the
+ * CPU supports is picked the first time a kernel runs.
+ */
+typedef struct RequestScanKernels {
+    RequestScanImplementation implementation;
+    gsize (* string) (const guint8 * data, gsize length);
+    gsize (* whitespace) (const guint8 * data, gsize length, gsize * n_newlines, gsize * line_start);
+    gsize (* structural) (const guint8 * data, gsize length);
+    gsize (* find) (const guint8 * data, gsize length, const guint8 * needle, gsize needle_length);
+    gsize (* newlines) (const guint8 * data, gsize length, gsize * line_start);
+} RequestScanKernels;
+
+static inline gboolean request_scan_is_whitespace (guint8 c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Scalar
+
+static gsize request_scan_string_scalar (const guint8 * data, gsize length) {
+    gsize i = 0;
+    while (i < length && data[i] != '"' && data[i] != '\\' && data[i] >= 0x20) {
+        i++;
+    }
+
+    return i;
+}
+
+static gsize request_scan_whitespace_scalar (const guint8 * data, gsize length, gsize * n_newlines, gsize * line_start) {
+    gsize i = 0;
+    while (i < length && request_scan_is_whitespace (data[i])) {
+        if (data[i] == '\n') {
+            (*n_newlines)++;
+            *line_start = i + 1;
+        }
+        i++;
+    }
+
+    return i;
+}
+
+static gsize request_scan_structural_scalar (const guint8 * data, gsize length) {
+    gsize i = 0;
+    while (i < length) {
+        guint8 c = data[i];
+        if (c == '"' || c == ',' || (c | 0x20) == '{' || (c | 0x20) == '}') { // also [ and ]
+            break;
+        }
+        i++;
+    }
+
+    return i;
+}
+
+static gsize request_scan_find_scalar (const guint8 * data, gsize length, const guint8 * needle, gsize needle_length) {
+    gsize i = 0;
+
+    // Candidates are found on the first byte
+    while (i + needle_length <= length) {
+        const guint8 * first = memchr (data + i, needle[0], length - needle_length - i + 1);
+        if (first == NULL) {
+            break;
+        }
+
+        i = first - data;
+        if (memcmp (data + i + 1, needle + 1, needle_length - 1) == 0) {
+            return i;
+        }
+        i++;
+    }
+
+    return length;
+}
+
+static gsize request_scan_newlines_scalar (const guint8 * data, gsize length, gsize * line_start) {
+    gsize n_newlines = 0;
+    const guint8 * end = data + length;
+    const guint8 * newline = data;
+
+    while ((newline = memchr (newline, '\n', end - newline)) != NULL) {
+        n_newlines++;
+        newline++;
+        *line_start = newline - data;
+    }
+
+    return n_newlines;
+}
+
+static const RequestScanKernels request_scan_scalar = {
+    SCAN_IMPLEMENTATION_SCALAR,
+    request_scan_string_scalar,
+    request_scan_whitespace_scalar,
+    request_scan_structural_scalar,
+    request_scan_find_scalar,
+    request_scan_newlines_scalar,
+};
+
+#if HAVE_SCAN_X86
+
+// SSE2
+
+__attribute__ ((target ("sse2")))
+static gsize request_scan_string_sse2 (const guint8 * data, gsize length) {
+    const __m128i quote = _mm_set1_epi8 ('"');
+    const __m128i backslash = _mm_set1_epi8 ('\\');
+    const __m128i control = _mm_set1_epi8 (0x1F);
+    gsize i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128 ((const __m128i *) (data + i));
+        __m128i matches = _mm_or_si128 (_mm_cmpeq_epi8 (block, quote), _mm_cmpeq_epi8 (block, backslash));
+        matches = _mm_or_si128 (matches, _mm_cmpeq_epi8 (_mm_max_epu8 (block, control), control)); // <= 0x1F
+
+        guint mask = (guint) _mm_movemask_epi8 (matches);
+        if (mask != 0) {
+            return i + __builtin_ctz (mask);
+        }
+    }
+
+    return i + request_scan_string_scalar (data + i, length - i);
+}
+
+__attribute__ ((target ("sse2")))
+static gsize request_scan_whitespace_sse2 (const guint8 * data, gsize length, gsize * n_newlines, gsize * line_start) {
+    const __m128i space = _mm_set1_epi8 (' ');
+    const __m128i newline = _mm_set1_epi8 ('\n');
+    const __m128i carriage_return = _mm_set1_epi8 ('\r');
+    const __m128i tab = _mm_set1_epi8 ('\t');
+    gsize i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128 ((const __m128i *) (data + i));
+        __m128i newlines = _mm_cmpeq_epi8 (block, newline);
+        __m128i matches = _mm_or_si128 (_mm_cmpeq_epi8 (block, space), newlines);
+        matches = _mm_or_si128 (matches, _mm_or_si128 (_mm_cmpeq_epi8 (block, carriage_return), _mm_cmpeq_epi8 (block, tab)));
+
+        guint others = ~(guint) _mm_movemask_epi8 (matches) & 0xFFFF;
+        guint newline_mask = (guint) _mm_movemask_epi8 (newlines);
+        gsize end = others != 0 ? (gsize) __builtin_ctz (others) : 16;
+
+        // Only count the newlines before the end of the run
+        newline_mask &= (guint) ((1u << end) - 1);
+        if (newline_mask != 0) {
+            *n_newlines += __builtin_popcount (newline_mask);
+            *line_start = i + (31 - __builtin_clz (newline_mask)) + 1;
+        }
+
+        if (others != 0) {
+            return i + end;
+        }
+    }
+
+    gsize line_start_tail = 0;
+    gsize n_newlines_tail = 0;
+    gsize end = i + request_scan_whitespace_scalar (data + i, length - i, &n_newlines_tail, &line_start_tail);
+
+    if (n_newlines_tail > 0) {
+        *n_newlines += n_newlines_tail;
+        *line_start = i + line_start_tail;
+    }
+
+    return end;
+}
+
+__attribute__ ((target ("sse2")))
+static gsize request_scan_structural_sse2 (const guint8 * data, gsize length) {
+    const __m128i quote = _mm_set1_epi8 ('"');
+    const __m128i comma = _mm_set1_epi8 (',');
+    const __m128i open = _mm_set1_epi8 ('{');
+    const __m128i close = _mm_set1_epi8 ('}');
+    const __m128i lower = _mm_set1_epi8 (0x20); // [ and ] become { and }
+    gsize i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128 ((const __m128i *) (data + i));
+        __m128i folded = _mm_or_si128 (block, lower);
+        __m128i matches = _mm_or_si128 (_mm_cmpeq_epi8 (block, quote), _mm_cmpeq_epi8 (block, comma));
+        matches = _mm_or_si128 (matches, _mm_or_si128 (_mm_cmpeq_epi8 (folded, open), _mm_cmpeq_epi8 (folded, close)));
+
+        guint mask = (guint) _mm_movemask_epi8 (matches);
+        if (mask != 0) {
+            return i + __builtin_ctz (mask);
+        }
+    }
+
+    return i + request_scan_structural_scalar (data + i, length - i);
+}
+
+/**
+ * Candidates are positions where both the first and the last byte of needle
+ * match, only those are compared in full.
+ */
+__attribute__ ((target ("sse2")))
+static gsize request_scan_find_sse2 (const guint8 * data, gsize length, const guint8 * needle, gsize needle_length) {
+    const __m128i first = _mm_set1_epi8 ((gchar) needle[0]);
+    const __m128i last = _mm_set1_epi8 ((gchar) needle[needle_length - 1]);
+    gsize i = 0;
+
+    for (; i + needle_length - 1 + 16 <= length; i += 16) {
+        __m128i block_first = _mm_loadu_si128 ((const __m128i *) (data + i));
+        __m128i block_last = _mm_loadu_si128 ((const __m128i *) (data + i + needle_length - 1));
+        guint mask = (guint) _mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi8 (block_first, first), _mm_cmpeq_epi8 (block_last, last)));
+
+        while (mask != 0) {
+            gsize candidate = i + __builtin_ctz (mask);
+            if (needle_length <= 2 || memcmp (data + candidate + 1, needle + 1, needle_length - 2) == 0) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    gsize tail = request_scan_find_scalar (data + i, length - i, needle, needle_length);
+
+    return tail == length - i ? length : i + tail;
+}
+
+__attribute__ ((target ("sse2")))
+static gsize request_scan_newlines_sse2 (const guint8 * data, gsize length, gsize * line_start) {
+    const __m128i newline = _mm_set1_epi8 ('\n');
+    gsize n_newlines = 0;
+    gsize i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        guint mask = (guint) _mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i *) (data + i)), newline));
+        if (mask != 0) {
+            n_newlines += __builtin_popcount (mask);
+            *line_start = i + (31 - __builtin_clz (mask)) + 1;
+        }
+    }
+
+    gsize line_start_tail = 0;
+    gsize n_newlines_tail = request_scan_newlines_scalar (data + i, length - i, &line_start_tail);
+    if (n_newlines_tail > 0) {
+        *line_start = i + line_start_tail;
+    }
+
+    return n_newlines + n_newlines_tail;
+}
+
+static const RequestScanKernels request_scan_sse2 = {
+    SCAN_IMPLEMENTATION_SSE2,
+    request_scan_string_sse2,
+    request_scan_whitespace_sse2,
+    request_scan_structural_sse2,
+    request_scan_find_sse2,
+    request_scan_newlines_sse2,
+};
+
+// AVX2
+
+__attribute__ ((target ("avx2")))
+static gsize request_scan_string_avx2 (const guint8 * data, gsize length) {
+    const __m256i quote = _mm256_set1_epi8 ('"');
+    const __m256i backslash = _mm256_set1_epi8 ('\\');
+    const __m256i control = _mm256_set1_epi8 (0x1F);
+    gsize i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256 ((const __m256i *) (data + i));
+        __m256i matches = _mm256_or_si256 (_mm256_cmpeq_epi8 (block, quote), _mm256_cmpeq_epi8 (block, backslash));
+        matches = _mm256_or_si256 (matches, _mm256_cmpeq_epi8 (_mm256_max_epu8 (block, control), control));
+
+        guint32 mask = (guint32) _mm256_movemask_epi8 (matches);
+        if (mask != 0) {
+            return i + __builtin_ctz (mask);
+        }
+    }
+
+    return i + request_scan_string_scalar (data + i, length - i);
+}
+
+__attribute__ ((target ("avx2")))
+static gsize request_scan_whitespace_avx2 (const guint8 * data, gsize length, gsize * n_newlines, gsize * line_start) {
+    const __m256i space = _mm256_set1_epi8 (' ');
+    const __m256i newline = _mm256_set1_epi8 ('\n');
+    const __m256i carriage_return = _mm256_set1_epi8 ('\r');
+    const __m256i tab = _mm256_set1_epi8 ('\t');
+    gsize i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256 ((const __m256i *) (data + i));
+        __m256i newlines = _mm256_cmpeq_epi8 (block, newline);
+        __m256i matches = _mm256_or_si256 (_mm256_cmpeq_epi8 (block, space), newlines);
+        matches = _mm256_or_si256 (matches, _mm256_or_si256 (_mm256_cmpeq_epi8 (block, carriage_return), _mm256_cmpeq_epi8 (block, tab)));
+
+        guint32 others = ~(guint32) _mm256_movemask_epi8 (matches);
+        guint32 newline_mask = (guint32) _mm256_movemask_epi8 (newlines);
+        gsize end = others != 0 ? (gsize) __builtin_ctz (others) : 32;
+
+        // Only count the newlines before the end of the run
+        if (end < 32) {
+            newline_mask &= (1u << end) - 1;
+        }
+
+        if (newline_mask != 0) {
+            *n_newlines += __builtin_popcount (newline_mask);
+            *line_start = i + (31 - __builtin_clz (newline_mask)) + 1;
+        }
+
+        if (others != 0) {
+            return i + end;
+        }
+    }
+
+    gsize line_start_tail = 0;
+    gsize n_newlines_tail = 0;
+    gsize end = i + request_scan_whitespace_scalar (data + i, length - i, &n_newlines_tail, &line_start_tail);
+
+    if (n_newlines_tail > 0) {
+        *n_newlines += n_newlines_tail;
+        *line_start = i + line_start_tail;
+    }
+
+    return end;
+}
+
+__attribute__ ((target ("avx2")))
+static gsize request_scan_structural_avx2 (const guint8 * data, gsize length) {
+    const __m256i quote = _mm256_set1_epi8 ('"');
+    const __m256i comma = _mm256_set1_epi8 (',');
+    const __m256i open = _mm256_set1_epi8 ('{');
+    const __m256i close = _mm256_set1_epi8 ('}');
+    const __m256i lower = _mm256_set1_epi8 (0x20); // [ and ] become { and }
+    gsize i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256 ((const __m256i *) (data + i));
+        __m256i folded = _mm256_or_si256 (block, lower);
+        __m256i matches = _mm256_or_si256 (_mm256_cmpeq_epi8 (block, quote), _mm256_cmpeq_epi8 (block, comma));
+        matches = _mm256_or_si256 (matches, _mm256_or_si256 (_mm256_cmpeq_epi8 (folded, open), _mm256_cmpeq_epi8 (folded, close)));
+
+        guint32 mask = (guint32) _mm256_movemask_epi8 (matches);
+        if (mask != 0) {
+            return i + __builtin_ctz (mask);
+        }
+    }
+
+    return i + request_scan_structural_scalar (data + i, length - i);
+}
+
+__attribute__ ((target ("avx2")))
+static gsize request_scan_find_avx2 (const guint8 * data, gsize length, const guint8 * needle, gsize needle_length) {
+    const __m256i first = _mm256_set1_epi8 ((gchar) needle[0]);
+    const __m256i last = _mm256_set1_epi8 ((gchar) needle[needle_length - 1]);
+    gsize i = 0;
+
+    for (; i + needle_length - 1 + 32 <= length; i += 32) {
+        __m256i block_first = _mm256_loadu_si256 ((const __m256i *) (data + i));
+        __m256i block_last = _mm256_loadu_si256 ((const __m256i *) (data + i + needle_length - 1));
+        guint32 mask = (guint32) _mm256_movemask_epi8 (_mm256_and_si256 (_mm256_cmpeq_epi8 (block_first, first), _mm256_cmpeq_epi8 (block_last, last)));
+
+        while (mask != 0) {
+            gsize candidate = i + __builtin_ctz (mask);
+            if (needle_length <= 2 || memcmp (data + candidate + 1, needle + 1, needle_length - 2) == 0) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    gsize tail = request_scan_find_scalar (data + i, length - i, needle, needle_length);
+
+    return tail == length - i ? length : i + tail;
+}
+
+__attribute__ ((target ("avx2")))
+static gsize request_scan_newlines_avx2 (const guint8 * data, gsize length, gsize * line_start) {
+    const __m256i newline = _mm256_set1_epi8 ('\n');
+    gsize n_newlines = 0;
+    gsize i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        guint32 mask = (guint32) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (_mm256_loadu_si256 ((const __m256i *) (data + i)), newline));
+        if (mask != 0) {
+            n_newlines += __builtin_popcount (mask);
+            *line_start = i + (31 - __builtin_clz (mask)) + 1;
+        }
+    }
+
+    gsize line_start_tail = 0;
+    gsize n_newlines_tail = request_scan_newlines_scalar (data + i, length - i, &line_start_tail);
+    if (n_newlines_tail > 0) {
+        *line_start = i + line_start_tail;
+    }
+
+    return n_newlines + n_newlines_tail;
+}
+
+static const RequestScanKernels request_scan_avx2 = {
+    SCAN_IMPLEMENTATION_AVX2,
+    request_scan_string_avx2,
+    request_scan_whitespace_avx2,
+    request_scan_structural_avx2,
+    request_scan_find_avx2,
+    request_scan_newlines_avx2,
+};
+
+#endif
+
+static const RequestScanKernels * request_scan_kernels = NULL;
+
+static gboolean request_scan_is_supported (RequestScanImplementation implementation) {
+    switch (implementation) {
+        case SCAN_IMPLEMENTATION_AUTO:
+        case SCAN_IMPLEMENTATION_SCALAR:
+            return TRUE;
+#if HAVE_SCAN_X86
+        case SCAN_IMPLEMENTATION_SSE2:
+            return __builtin_cpu_supports ("sse2");
+        case SCAN_IMPLEMENTATION_AVX2:
+            return __builtin_cpu_supports ("avx2");
+#endif
+        default:
+            return FALSE;
+    }
+}
+
+static const RequestScanKernels * request_scan_get_kernels (RequestScanImplementation implementation) {
+#if HAVE_SCAN_X86
+    if (implementation == SCAN_IMPLEMENTATION_AUTO) {
+        implementation = request_scan_is_supported (SCAN_IMPLEMENTATION_AVX2) ? SCAN_IMPLEMENTATION_AVX2
+            : request_scan_is_supported (SCAN_IMPLEMENTATION_SSE2) ? SCAN_IMPLEMENTATION_SSE2
+            : SCAN_IMPLEMENTATION_SCALAR;
+    }
+
+    switch (implementation) {
+        case SCAN_IMPLEMENTATION_AVX2:
+            return &request_scan_avx2;
+        case SCAN_IMPLEMENTATION_SSE2:
+            return &request_scan_sse2;
+        default:
+            break;
+    }
+#else
+    (void) implementation;
+#endif
+
+    return &request_scan_scalar;
+}
+
+static inline const RequestScanKernels * request_scan_kernels_get (void) {
+    const RequestScanKernels * kernels = g_atomic_pointer_get (&request_scan_kernels);
+
+    if (G_UNLIKELY (kernels == NULL)) {
+        kernels = request_scan_get_kernels (SCAN_IMPLEMENTATION_AUTO);
+        g_atomic_pointer_set (&request_scan_kernels, kernels);
+    }
+
+    return kernels;
+}
+
+/**
+ * Forces the kernels used from now on, e.g. to compare them in benchmarks.
+ * Returns FALSE, keeping the current ones, when the CPU doesn't support them.
+ */
+gboolean request_scan_set_implementation (RequestScanImplementation implementation) {
+    if (!request_scan_is_supported (implementation)) {
+        return FALSE;
+    }
+
+    g_atomic_pointer_set (&request_scan_kernels, request_scan_get_kernels (implementation));
+
+    return TRUE;
+}
+
+RequestScanImplementation request_scan_get_implementation (void) {
+    return request_scan_kernels_get ()->implementation;
+}
+
+const gchar * request_scan_implementation_to_string (RequestScanImplementation implementation) {
+    switch (implementation) {
+        case SCAN_IMPLEMENTATION_SCALAR:
+            return "scalar";
+        case SCAN_IMPLEMENTATION_SSE2:
+            return "sse2";
+        case SCAN_IMPLEMENTATION_AVX2:
+            return "avx2";
+        default:
+            return "auto";
+    }
+}
+
+/**
+ * Returns the offset of the first ", \ or control character of data, or
+ * length when there is none.
+ */
+gsize request_scan_string (const guint8 * data, gsize length) {
+    return request_scan_kernels_get ()->string (data, length);
+}
+
+/**
+ * Returns the offset of the first non-whitespace byte of data, or length when
+ * there is none. Newlines skipped are added to n_newlines and, if any, the
+ * offset following the last one is stored in line_start.
+ */
+gsize request_scan_whitespace (const guint8 * data, gsize length, gsize * n_newlines, gsize * line_start) {
+    return request_scan_kernels_get ()->whitespace (data, length, n_newlines, line_start);
+}
+
+/**
+ * Returns the offset of the first ", comma or bracket of data, or length when
+ * there is none.
+ */
+gsize request_scan_structural (const guint8 * data, gsize length) {
+    return request_scan_kernels_get ()->structural (data, length);
+}
+
+/**
+ * Returns the offset of the first occurrence of needle in data, or length when
+ * there is none.
+ */
+gsize request_scan_find (const guint8 * data, gsize length, const guint8 * needle, gsize needle_length) {
+    if (needle_length == 0) {
+        return 0;
+    }
+
+    if (needle_length > length) {
+        return length;
+    }
+
+    return request_scan_kernels_get ()->find (data, length, needle, needle_length);
+}
+
+/**
+ * Returns the number of newlines in data and, if any, stores the offset
+ * following the last one in line_start.
+ */
+gsize request_scan_newlines (const guint8 * data, gsize length, gsize * line_start) {
+    return request_scan_kernels_get ()->newlines (data, length, line_start);
+}
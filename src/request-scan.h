@@ -0,0 +1,40 @@
+/* request-scan.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum RequestScanImplementation {
+    SCAN_IMPLEMENTATION_AUTO,
+    SCAN_IMPLEMENTATION_SCALAR,
+    SCAN_IMPLEMENTATION_SSE2,
+    SCAN_IMPLEMENTATION_AVX2,
+} RequestScanImplementation;
+
+gboolean request_scan_set_implementation (RequestScanImplementation implementation);
+RequestScanImplementation request_scan_get_implementation (void);
+const gchar * request_scan_implementation_to_string (RequestScanImplementation implementation);
+gsize request_scan_string (const guint8 * data, gsize length);
+gsize request_scan_whitespace (const guint8 * data, gsize length, gsize * n_newlines, gsize * line_start);
+gsize request_scan_structural (const guint8 * data, gsize length);
+gsize request_scan_find (const guint8 * data, gsize length, const guint8 * needle, gsize needle_length);
+gsize request_scan_newlines (const guint8 * data, gsize length, gsize * line_start);
+
+G_END_DECLS
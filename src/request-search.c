@@ -0,0 +1,347 @@
+/* request-search.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gio/gio.h>
+#include <string.h>
+
+#include "request-search.h"
+#include "request-scan.h"
+
+// Amount of body searched between two updates, regular expressions are run on
+// windows of that size pushed to the end of the line
+#define SEARCH_WINDOW_SIZE (16 * 1024 * 1024)
+
+// Windows of regular expressions are cut there even within a line, so that
+// minified bodies are still searched in steps and stay addressable by PCRE
+#define SEARCH_MAX_REGEX_WINDOW_SIZE (4 * SEARCH_WINDOW_SIZE)
+
+// Searching stops past that many matches
+#define SEARCH_MAX_MATCHES 1000000
+
+/**
+ * Search of a literal string or a regular expression in a body.
+ *
+ * The body is searched as raw bytes on a worker thread, wherever
+ * RequestBodyStore keeps it, and matches are published to the main thread in
+ * batches as they are found. Literal strings are searched in windows of
+ * SEARCH_WINDOW_SIZE bytes, matches may span two windows. Regular expressions
+ * don't match across windows, which end at a line end past SEARCH_WINDOW_SIZE
+ * bytes or after SEARCH_MAX_REGEX_WINDOW_SIZE bytes in very long lines.
+ */
+struct _RequestSearch {
+    GObject parent_instance;
+
+    GBytes * bytes;
+    gchar * pattern;
+    RequestSearchMode mode;
+    GRegex * regex;
+    GCancellable * cancellable;
+
+    GArray * matches; // RequestSearchMatch
+    gboolean is_complete;
+    gboolean is_truncated;
+};
+
+typedef struct RequestSearchBatch {
+    RequestSearch * search;
+    GCancellable * cancellable;
+    GArray * matches;
+    gboolean is_complete;
+    gboolean is_truncated;
+} RequestSearchBatch;
+
+/**
+ * Keeps track of the line of the last match to count lines incrementally.
+ */
+typedef struct RequestSearchCursor {
+    gsize offset;
+    guint64 line;
+    gsize line_start;
+} RequestSearchCursor;
+
+G_DEFINE_TYPE (RequestSearch, request_search, G_TYPE_OBJECT);
+
+static void request_search_batch_free (RequestSearchBatch * batch) {
+    g_object_unref (batch->search);
+    g_object_unref (batch->cancellable);
+    g_array_unref (batch->matches);
+    g_free (batch);
+}
+
+static gboolean request_search_on_batch (gpointer data) {
+    RequestSearchBatch * batch = data;
+    RequestSearch * self = batch->search;
+
+    if (g_cancellable_is_cancelled (batch->cancellable)) {
+        return G_SOURCE_REMOVE;
+    }
+
+    g_array_append_vals (self->matches, batch->matches->data, batch->matches->len);
+    self->is_complete = batch->is_complete;
+    self->is_truncated = batch->is_truncated;
+
+    g_signal_emit_by_name (self, SEARCH_UPDATED_SIGNAL);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void request_search_publish_batch (RequestSearch * self, GCancellable * cancellable, GArray * matches, gboolean is_complete, gboolean is_truncated) {
+    RequestSearchBatch * batch = g_new0 (RequestSearchBatch, 1);
+    batch->search = g_object_ref (self);
+    batch->cancellable = g_object_ref (cancellable);
+    batch->matches = matches;
+    batch->is_complete = is_complete;
+    batch->is_truncated = is_truncated;
+
+    g_main_context_invoke_full (NULL, G_PRIORITY_DEFAULT_IDLE, request_search_on_batch, batch, (GDestroyNotify) request_search_batch_free);
+}
+
+static void request_search_add_match (GArray * matches, RequestSearchCursor * cursor, const guint8 * data, gsize offset, gsize length) {
+    gsize line_start = 0;
+    gsize n_newlines = request_scan_newlines (data + cursor->offset, offset - cursor->offset, &line_start);
+
+    if (n_newlines > 0) {
+        cursor->line += n_newlines;
+        cursor->line_start = cursor->offset + line_start;
+    }
+
+    cursor->offset = offset;
+
+    RequestSearchMatch match = { offset, cursor->line, (guint32) MIN (offset - cursor->line_start, G_MAXUINT32), (guint32) MIN (length, G_MAXUINT32) };
+    g_array_append_val (matches, match);
+}
+
+/**
+ * Returns the end of the window starting at offset: SEARCH_WINDOW_SIZE bytes
+ * later, pushed to the end of that line for regular expressions.
+ */
+static gsize request_search_get_window_end (const guint8 * data, gsize length, gsize offset, RequestSearchMode mode) {
+    if (length - offset <= SEARCH_WINDOW_SIZE) {
+        return length;
+    }
+
+    gsize end = offset + SEARCH_WINDOW_SIZE;
+    if (mode == SEARCH_MODE_LITERAL) {
+        return end;
+    }
+
+    gsize max_end = offset + MIN (length - offset, SEARCH_MAX_REGEX_WINDOW_SIZE);
+    const guint8 * newline = memchr (data + end, '\n', max_end - end);
+
+    return newline != NULL ? (gsize) (newline - data) + 1 : max_end;
+}
+
+static void request_search_thread (GTask * task, gpointer source_object, gpointer task_data, GCancellable * cancellable) {
+    (void) task_data;
+    RequestSearch * self = source_object;
+    gsize length;
+    const guint8 * data = g_bytes_get_data (self->bytes, &length);
+    gsize pattern_length = strlen (self->pattern);
+    RequestSearchCursor cursor = { 0, 0, 0 };
+    guint n_matches = 0;
+    gboolean is_truncated = FALSE;
+    gboolean is_cancelled = FALSE;
+    gsize position = 0; // past the last literal match, which may end in the next window
+    gsize offset = 0;
+
+    while (offset < length && !is_truncated) {
+        if (g_cancellable_is_cancelled (cancellable)) {
+            g_task_return_boolean (task, FALSE);
+            return;
+        }
+
+        gsize window_end = request_search_get_window_end (data, length, offset, self->mode);
+        GArray * matches = g_array_new (FALSE, FALSE, sizeof (RequestSearchMatch));
+
+        if (self->mode == SEARCH_MODE_LITERAL) {
+            position = MAX (position, offset);
+
+            // Matches may overlap the end of the window
+            gsize limit = MIN (window_end + pattern_length - 1, length);
+
+            while (position < window_end && !is_truncated) {
+                if (g_cancellable_is_cancelled (cancellable)) {
+                    is_cancelled = TRUE;
+                    break;
+                }
+
+                gsize found = position + request_scan_find (data + position, limit - position, (const guint8 *) self->pattern, pattern_length);
+                if (found >= window_end) {
+                    break;
+                }
+
+                request_search_add_match (matches, &cursor, data, found, pattern_length);
+                is_truncated = ++n_matches >= SEARCH_MAX_MATCHES;
+                position = found + pattern_length;
+            }
+        } else {
+            GMatchInfo * match_info = NULL;
+
+            // Offsets are relative to the window, PCRE can't address more than 2 GB
+            g_regex_match_full (self->regex, (const gchar *) data + offset, window_end - offset, 0, 0, &match_info, NULL);
+
+            while (g_match_info_matches (match_info) && !is_truncated) {
+                if (g_cancellable_is_cancelled (cancellable)) {
+                    is_cancelled = TRUE;
+                    break;
+                }
+
+                gint start;
+                gint end;
+
+                if (g_match_info_fetch_pos (match_info, 0, &start, &end) && end > start) { // empty matches can't be shown
+                    request_search_add_match (matches, &cursor, data, offset + start, end - start);
+                    is_truncated = ++n_matches >= SEARCH_MAX_MATCHES;
+                }
+
+                g_match_info_next (match_info, NULL);
+            }
+
+            g_match_info_free (match_info);
+        }
+
+        if (is_cancelled) {
+            g_array_unref (matches);
+            g_task_return_boolean (task, FALSE);
+            return;
+        }
+
+        offset = window_end;
+        request_search_publish_batch (self, cancellable, matches, offset >= length || is_truncated, is_truncated);
+    }
+
+    if (length == 0) {
+        request_search_publish_batch (self, cancellable, g_array_new (FALSE, FALSE, sizeof (RequestSearchMatch)), TRUE, FALSE);
+    }
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static void request_search_dispose (GObject * object) {
+    RequestSearch * self = REQUEST_SEARCH (object);
+
+    request_search_cancel (self);
+
+    G_OBJECT_CLASS (request_search_parent_class)->dispose (object);
+}
+
+static void request_search_finalize (GObject * object) {
+    RequestSearch * self = REQUEST_SEARCH (object);
+
+    g_bytes_unref (self->bytes);
+    g_free (self->pattern);
+    g_clear_pointer (&self->regex, g_regex_unref);
+    g_array_unref (self->matches);
+
+    G_OBJECT_CLASS (request_search_parent_class)->finalize (object);
+}
+
+static void request_search_class_init (RequestSearchClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = request_search_dispose;
+    object_class->finalize = request_search_finalize;
+
+    // Declare our own signals
+    g_signal_new (SEARCH_UPDATED_SIGNAL, REQUEST_TYPE_SEARCH, G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+}
+
+static void request_search_init (RequestSearch * self) {
+    self->matches = g_array_new (FALSE, FALSE, sizeof (RequestSearchMatch));
+}
+
+/**
+ * Creates a search of pattern in bytes. Fails when pattern is not a valid
+ * regular expression in regex mode.
+ */
+RequestSearch * request_search_new (GBytes * bytes, const gchar * pattern, RequestSearchMode mode, GError ** error) {
+    g_return_val_if_fail (bytes != NULL, NULL);
+    g_return_val_if_fail (pattern != NULL && *pattern != '\0', NULL);
+
+    GRegex * regex = NULL;
+
+    if (mode == SEARCH_MODE_REGEX) {
+        // RAW: the body isn't necessarily UTF-8
+        regex = g_regex_new (pattern, G_REGEX_RAW | G_REGEX_MULTILINE | G_REGEX_OPTIMIZE, 0, error);
+        if (regex == NULL) {
+            return NULL;
+        }
+    }
+
+    RequestSearch * self = g_object_new (REQUEST_TYPE_SEARCH, NULL);
+    self->bytes = g_bytes_ref (bytes);
+    self->pattern = g_strdup (pattern);
+    self->mode = mode;
+    self->regex = regex;
+
+    return self;
+}
+
+/**
+ * Starts searching on a worker thread, SEARCH_UPDATED_SIGNAL is emitted each
+ * time new matches are available and once the search is complete.
+ */
+void request_search_start (RequestSearch * self) {
+    g_return_if_fail (REQUEST_IS_SEARCH (self));
+    g_return_if_fail (self->cancellable == NULL);
+
+    self->cancellable = g_cancellable_new ();
+
+    GTask * task = g_task_new (self, self->cancellable, NULL, NULL);
+    g_task_run_in_thread (task, request_search_thread);
+    g_object_unref (task);
+}
+
+/**
+ * Stops the search, matches found so far are kept.
+ */
+void request_search_cancel (RequestSearch * self) {
+    g_return_if_fail (REQUEST_IS_SEARCH (self));
+
+    if (self->cancellable != NULL) {
+        g_cancellable_cancel (self->cancellable);
+        g_clear_object (&self->cancellable);
+    }
+}
+
+gboolean request_search_is_complete (RequestSearch * self) {
+    g_return_val_if_fail (REQUEST_IS_SEARCH (self), FALSE);
+
+    return self->is_complete;
+}
+
+/**
+ * Returns TRUE when the search stopped at SEARCH_MAX_MATCHES.
+ */
+gboolean request_search_is_truncated (RequestSearch * self) {
+    g_return_val_if_fail (REQUEST_IS_SEARCH (self), FALSE);
+
+    return self->is_truncated;
+}
+
+guint request_search_get_n_matches (RequestSearch * self) {
+    g_return_val_if_fail (REQUEST_IS_SEARCH (self), 0);
+
+    return self->matches->len;
+}
+
+const RequestSearchMatch * request_search_get_match (RequestSearch * self, guint index) {
+    g_return_val_if_fail (REQUEST_IS_SEARCH (self), NULL);
+    g_return_val_if_fail (index < self->matches->len, NULL);
+
+    return &g_array_index (self->matches, RequestSearchMatch, index);
+}
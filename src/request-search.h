@@ -0,0 +1,54 @@
+/* request-search.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define REQUEST_TYPE_SEARCH (request_search_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestSearch, request_search, REQUEST, SEARCH, GObject)
+
+#define SEARCH_UPDATED_SIGNAL "updated"
+
+typedef enum RequestSearchMode {
+    SEARCH_MODE_LITERAL,
+    SEARCH_MODE_REGEX,
+} RequestSearchMode;
+
+/**
+ * Where a match is, both as a byte offset in the body and as a line and a byte
+ * index in that line.
+ */
+typedef struct RequestSearchMatch {
+    guint64 offset;
+    guint64 line;
+    guint32 column;
+    guint32 length;
+} RequestSearchMatch;
+
+RequestSearch * request_search_new (GBytes * bytes, const gchar * pattern, RequestSearchMode mode, GError ** error);
+void request_search_start (RequestSearch * self);
+void request_search_cancel (RequestSearch * self);
+gboolean request_search_is_complete (RequestSearch * self);
+gboolean request_search_is_truncated (RequestSearch * self);
+guint request_search_get_n_matches (RequestSearch * self);
+const RequestSearchMatch * request_search_get_match (RequestSearch * self, guint index);
+
+G_END_DECLS
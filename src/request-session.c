@@ -0,0 +1,60 @@
+/* request-session.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <libsoup/soup.h>
+
+#include "request-session.h"
+#include "request-settings.h"
+#include "request-cache.h"
+
+#define DEFAULT_MAX_CONNECTIONS 32
+#define DEFAULT_MAX_CONNECTIONS_PER_HOST 6
+#define DEFAULT_IDLE_TIMEOUT 60 // seconds
+
+/**
+ * Returns the session shared by every request of the application.
+ *
+ * Keeping a single session alive lets libsoup pool keep-alive connections, so
+ * repeated sends to the same host skip DNS, TCP and TLS setup.
+ */
+SoupSession * request_session_get_default (void) {
+    static SoupSession * session = NULL;
+
+    if (session == NULL) {
+        gint max_conns = request_settings_get_int ("max-connections", DEFAULT_MAX_CONNECTIONS);
+        gint max_conns_per_host = request_settings_get_int ("max-connections-per-host", DEFAULT_MAX_CONNECTIONS_PER_HOST);
+        gint idle_timeout = request_settings_get_int ("idle-timeout", DEFAULT_IDLE_TIMEOUT);
+
+        session = soup_session_new_with_options (
+            SOUP_SESSION_MAX_CONNS, MAX (max_conns, 1),
+            SOUP_SESSION_MAX_CONNS_PER_HOST, CLAMP (max_conns_per_host, 1, MAX (max_conns, 1)),
+            SOUP_SESSION_IDLE_TIMEOUT, (guint) MAX (idle_timeout, 0),
+            NULL);
+
+        // Bodies are decoded by RequestTransfer, which measures their size on
+        // the wire before decoding.
+        soup_session_remove_feature_by_type (session, SOUP_TYPE_CONTENT_DECODER);
+
+        SoupLogger * logger = soup_logger_new (SOUP_LOGGER_LOG_HEADERS, -1);
+        soup_session_add_feature (session, SOUP_SESSION_FEATURE (logger));
+        g_object_unref (logger);
+
+        request_cache_attach (session);
+    }
+
+    return session;
+}
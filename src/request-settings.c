@@ -0,0 +1,95 @@
+/* request-settings.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "request-settings.h"
+
+/**
+ * Returns the application settings, or NULL when the schema is not installed
+ * (e.g. when running straight from the build directory).
+ *
+ * Callers must not unref the returned object.
+ */
+GSettings * request_settings_get_default (void) {
+    static GSettings * settings = NULL;
+    static gboolean is_initialized = FALSE;
+
+    if (!is_initialized) {
+        GSettingsSchemaSource * source = g_settings_schema_source_get_default ();
+        GSettingsSchema * schema = NULL;
+
+        if (source != NULL) {
+            schema = g_settings_schema_source_lookup (source, REQUEST_SETTINGS_SCHEMA_ID, TRUE);
+        }
+
+        if (schema != NULL) {
+            settings = g_settings_new_full (schema, NULL, NULL);
+            g_settings_schema_unref (schema);
+        } else {
+            g_info ("Schema %s not found, using default settings.\n", REQUEST_SETTINGS_SCHEMA_ID);
+        }
+
+        is_initialized = TRUE;
+    }
+
+    return settings;
+}
+
+/**
+ * Returns whether key can be read, an outdated installed schema may not know
+ * about keys added since.
+ */
+static gboolean request_settings_has_key (GSettings * settings, const gchar * key) {
+    GSettingsSchema * schema = NULL;
+    gboolean has_key;
+
+    if (settings == NULL)
+        return FALSE;
+
+    g_object_get (settings, "settings-schema", &schema, NULL);
+    has_key = g_settings_schema_has_key (schema, key);
+    g_settings_schema_unref (schema);
+
+    return has_key;
+}
+
+gint request_settings_get_int (const gchar * key, gint fallback) {
+    GSettings * settings = request_settings_get_default ();
+    if (!request_settings_has_key (settings, key))
+        return fallback;
+
+    return g_settings_get_int (settings, key);
+}
+
+gboolean request_settings_get_boolean (const gchar * key, gboolean fallback) {
+    GSettings * settings = request_settings_get_default ();
+    if (!request_settings_has_key (settings, key))
+        return fallback;
+
+    return g_settings_get_boolean (settings, key);
+}
+
+/**
+ * Binds key to property of object both ways, object keeps its own value when
+ * the key is not available.
+ */
+void request_settings_bind (const gchar * key, gpointer object, const gchar * property) {
+    GSettings * settings = request_settings_get_default ();
+    if (!request_settings_has_key (settings, key))
+        return;
+
+    g_settings_bind (settings, key, object, property, G_SETTINGS_BIND_DEFAULT);
+}
@@ -0,0 +1,31 @@
+/* request-settings.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define REQUEST_SETTINGS_SCHEMA_ID "com.github.guillotjulien.request"
+
+GSettings * request_settings_get_default (void);
+gint request_settings_get_int (const gchar * key, gint fallback);
+gboolean request_settings_get_boolean (const gchar * key, gboolean fallback);
+void request_settings_bind (const gchar * key, gpointer object, const gchar * property);
+
+G_END_DECLS
@@ -17,47 +17,138 @@
 
 #include <gtk-4.0/gtk/gtk.h>
 #include <gtksourceview-5/gtksourceview/gtksource.h>
-#include <jansson.h>
 
 #include "request-source-view.h"
+#include "request-json.h"
 
 struct _RequestSourceView {
     GtkBox parent_instance;
 
     gboolean is_readonly;
     GtkSourceLanguageManager * language_manager;
+    GCancellable * transform_cancellable;
 
     /* Template widgets */
     GtkSourceView * source_view;
     GtkBox * source_toolbar;
     GtkButton * beautify_button;
+    GtkSpinner * transform_spinner;
     GtkComboBox * source_language_selector;
 };
 
+typedef enum RequestSourceViewTransform {
+    TRANSFORM_BEAUTIFY,
+} RequestSourceViewTransform;
+
+typedef struct RequestSourceViewTransformData {
+    RequestSourceViewTransform transform;
+    gchar * text;
+} RequestSourceViewTransformData;
+
 struct _RequestSourceViewClass {
     GtkBoxClass parent_class;
 };
 
 G_DEFINE_TYPE (RequestSourceView, request_source_view, GTK_TYPE_BOX);
 
-static gchar * request_source_view_get_beautified_json (const gchar * text) {
-    json_error_t * error = NULL;
-    json_t * json = json_loads (text, JSON_DECODE_ANY, error);
-    if (json == NULL) { // Don't segfault when beautifying a incorrect JSON: e.g {"a":"a",}
-        return (gchar *) text;
+static void request_source_view_transform_data_free (RequestSourceViewTransformData * data) {
+    g_free (data->text);
+    g_free (data);
+}
+
+static void request_source_view_transform_thread (GTask * task, gpointer source_object, gpointer task_data, GCancellable * cancellable) {
+    (void) source_object;
+    RequestSourceViewTransformData * data = task_data;
+    GError * error = NULL;
+    gchar * result = NULL;
+
+    if (g_cancellable_is_cancelled (cancellable)) {
+        return; // return-on-cancel already completed the task
+    }
+
+    switch (data->transform) {
+        case TRANSFORM_BEAUTIFY:
+            result = request_json_format (data->text, -1, JSON_FORMAT_BEAUTIFY, cancellable, &error);
+            break;
+    }
+
+    if (result == NULL) {
+        g_task_return_error (task, error);
+    } else {
+        g_task_return_pointer (task, result, g_free);
+    }
+}
+
+/**
+ * Runs a JSON transform of text on a worker thread. Large documents can take
+ * seconds to parse, doing it on the main thread would freeze the UI.
+ */
+static void request_source_view_transform_async (RequestSourceView * self, RequestSourceViewTransform transform, gchar * text, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data) {
+    RequestSourceViewTransformData * data = g_new0 (RequestSourceViewTransformData, 1);
+    data->transform = transform;
+    data->text = text;
+
+    GTask * task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_source_tag (task, request_source_view_transform_async);
+    g_task_set_task_data (task, data, (GDestroyNotify) request_source_view_transform_data_free);
+    // The formatter only checks for cancellation between chunks, let a
+    // cancelled caller move on right away
+    g_task_set_return_on_cancel (task, TRUE);
+    g_task_run_in_thread (task, request_source_view_transform_thread);
+    g_object_unref (task);
+}
+
+static gchar * request_source_view_transform_finish (RequestSourceView * self, GAsyncResult * result, GError ** error) {
+    g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+
+    return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void request_source_view_set_is_busy (RequestSourceView * self, gboolean is_busy) {
+    gtk_spinner_set_spinning (self->transform_spinner, is_busy);
+    gtk_widget_set_visible (GTK_WIDGET (self->transform_spinner), is_busy);
+    gtk_button_set_label (self->beautify_button, is_busy ? "Cancel" : "Beautify"); // FIXME: Handle translations
+
+    // Edits made while the worker runs would be overwritten by its result
+    g_object_set (self->source_view, "editable", !is_busy && !self->is_readonly, NULL);
+}
+
+/**
+ * Cancels the transform in progress, if any. Its result will be dropped.
+ */
+static void request_source_view_cancel_transform (RequestSourceView * self) {
+    if (self->transform_cancellable == NULL) {
+        return;
     }
 
-    return (gchar *) json_dumps (json, JSON_INDENT (4) | JSON_PRESERVE_ORDER);
+    g_cancellable_cancel (self->transform_cancellable);
+    g_clear_object (&self->transform_cancellable);
+
+    request_source_view_set_is_busy (self, FALSE);
 }
 
-static gchar * request_source_view_get_minified_json (const gchar * text) {
-    json_error_t * error = NULL;
-    json_t * json = json_loads (text, JSON_DECODE_ANY, error);
-    if (json == NULL) { // Don't segfault when beautifying a incorrect JSON: e.g {"a":"a",}
-        return (gchar *) text;
+static void request_source_view_on_beautified (GObject * source, GAsyncResult * result, gpointer data) {
+    (void) data;
+    RequestSourceView * self = REQUEST_SOURCE_VIEW (source);
+    GError * error = NULL;
+
+    gchar * text = request_source_view_transform_finish (self, result, &error);
+    if (text == NULL) {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            // Invalid JSON is left as is
+            g_info ("Cannot beautify: %s\n", error->message);
+            request_source_view_cancel_transform (self);
+        }
+
+        g_error_free (error);
+        return;
     }
 
-    return (gchar *) json_dumps (json, JSON_COMPACT | JSON_PRESERVE_ORDER);
+    g_clear_object (&self->transform_cancellable);
+    request_source_view_set_is_busy (self, FALSE);
+    request_source_view_set_text (self, text);
+
+    g_free (text);
 }
 
 static void request_source_view_on_beautify_requested (GtkButton * widget, gpointer data) {
@@ -65,8 +156,17 @@ static void request_source_view_on_beautify_requested (GtkButton * widget, gpoin
     RequestSourceView * self = data;
     g_return_if_fail (self != NULL);
 
+    // The button cancels the transform while it runs
+    if (self->transform_cancellable != NULL) {
+        request_source_view_cancel_transform (self);
+        return;
+    }
+
+    self->transform_cancellable = g_cancellable_new ();
+    request_source_view_set_is_busy (self, TRUE);
+
     gchar * text = request_source_view_get_text (self);
-    request_source_view_set_text (self, request_source_view_get_beautified_json (text));
+    request_source_view_transform_async (self, TRANSFORM_BEAUTIFY, text, self->transform_cancellable, request_source_view_on_beautified, NULL);
 }
 
 static void request_source_view_on_source_language_change (GtkComboBox * widget, gpointer data) {
@@ -81,13 +181,28 @@ static void request_source_view_on_source_language_change (GtkComboBox * widget,
     // gtk_source_buffer_set_language ()
 }
 
+static void request_source_view_dispose (GObject * object) {
+    RequestSourceView * self = REQUEST_SOURCE_VIEW (object);
+
+    if (self->transform_cancellable != NULL) {
+        g_cancellable_cancel (self->transform_cancellable);
+        g_clear_object (&self->transform_cancellable);
+    }
+
+    G_OBJECT_CLASS (request_source_view_parent_class)->dispose (object);
+}
+
 static void request_source_view_class_init (RequestSourceViewClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
     GtkWidgetClass * widget_class = GTK_WIDGET_CLASS (klass);
 
+    object_class->dispose = request_source_view_dispose;
+
     gtk_widget_class_set_template_from_resource (widget_class, "/com/github/guillotjulien/request/resources/ui/request-source-view.ui");
     gtk_widget_class_bind_template_child (widget_class, RequestSourceView, source_view);
     gtk_widget_class_bind_template_child (widget_class, RequestSourceView, source_toolbar);
     gtk_widget_class_bind_template_child (widget_class, RequestSourceView, beautify_button);
+    gtk_widget_class_bind_template_child (widget_class, RequestSourceView, transform_spinner);
     gtk_widget_class_bind_template_child (widget_class, RequestSourceView, source_language_selector);
 };
 
@@ -97,6 +212,7 @@ static void request_source_view_init (RequestSourceView * self) {
     g_return_if_fail (GTK_IS_WIDGET (self->source_view));
     g_return_if_fail (GTK_IS_WIDGET (self->source_toolbar));
     g_return_if_fail (GTK_IS_WIDGET (self->beautify_button));
+    g_return_if_fail (GTK_IS_WIDGET (self->transform_spinner));
     g_return_if_fail (GTK_IS_WIDGET (self->source_language_selector));
 
     // Connect widgets signals
@@ -123,9 +239,12 @@ void request_source_view_set_is_readonly (RequestSourceView * self, gboolean is_
     self->is_readonly = is_readonly;
 
     gtk_widget_set_visible (GTK_WIDGET (self->source_toolbar), !is_readonly);
-    g_object_set (self->source_view, "editable", !is_readonly, NULL);
+    g_object_set (self->source_view, "editable", !is_readonly && self->transform_cancellable == NULL, NULL);
 }
 
+/**
+ * Returns the text of the buffer as typed.
+ */
 gchar * request_source_view_get_text (RequestSourceView * self) {
     GtkTextIter start, end;
     GtkTextBuffer * buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (self->source_view));
@@ -133,26 +252,13 @@ gchar * request_source_view_get_text (RequestSourceView * self) {
     gtk_text_buffer_get_start_iter (buffer, &start);
     gtk_text_buffer_get_end_iter (buffer, &end);
 
-    gchar * text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
-
-    switch (request_source_view_get_content_type (self)) {
-        case CONTENT_TYPE_JSON:
-            text = request_source_view_get_minified_json (text);
-            break;
-        case CONTENT_TYPE_XML:
-            /* code */
-            break;
-        case CONTENT_TYPE_YAML:
-            /* code */
-            break;
-        default:
-            break;
-    }
-
-    return text;
+    return gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
 }
 
 void request_source_view_set_text (RequestSourceView * self, gchar * text) {
+    // A pending transform would replace this text with the one it started from
+    request_source_view_cancel_transform (self);
+
     // TODO:
     // 1- guess language
     // 2- set language dropdown to the appropriate value
@@ -164,6 +270,42 @@ void request_source_view_set_text (RequestSourceView * self, gchar * text) {
     gtk_text_view_set_buffer (GTK_TEXT_VIEW (self->source_view), (GtkTextBuffer *) buffer);
 }
 
+/**
+ * Appends text at the end of the current buffer, used to show a body while it
+ * is still being received.
+ */
+void request_source_view_append_text (RequestSourceView * self, const gchar * text, gssize length) {
+    GtkTextIter end;
+    GtkTextBuffer * buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (self->source_view));
+
+    gtk_text_buffer_get_end_iter (buffer, &end);
+    gtk_text_buffer_insert (buffer, &end, text, length);
+}
+
+/**
+ * Selects the length bytes starting at byte index in line and scrolls them
+ * into view.
+ */
+void request_source_view_select_range (RequestSourceView * self, guint64 line, guint32 index, guint32 length) {
+    GtkTextIter start, end;
+    GtkTextBuffer * buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (self->source_view));
+
+    if (line > G_MAXINT || !gtk_text_buffer_get_iter_at_line_index (buffer, &start, (gint) line, (gint) MIN (index, G_MAXINT))) {
+        return; // not loaded (yet)
+    }
+
+    // Move forward character by character, the range may span several lines
+    end = start;
+    for (guint32 consumed = 0; consumed < length && !gtk_text_iter_is_end (&end);) {
+        gchar utf8[6];
+        consumed += g_unichar_to_utf8 (gtk_text_iter_get_char (&end), utf8);
+        gtk_text_iter_forward_char (&end);
+    }
+
+    gtk_text_buffer_select_range (buffer, &start, &end);
+    gtk_text_view_scroll_to_mark (GTK_TEXT_VIEW (self->source_view), gtk_text_buffer_get_insert (buffer), 0.1, TRUE, 0.0, 0.5);
+}
+
 RequestSourceViewContentType request_source_view_get_content_type (RequestSourceView * self) {
     const gchar * select = (gchar *) gtk_combo_box_get_active_id (self->source_language_selector);
     if (strcmp (select, "json") == 0) {
@@ -36,6 +36,8 @@ RequestSourceView * request_source_view_new (gboolean is_readonly);
 void request_source_view_set_is_readonly (RequestSourceView * self, gboolean is_readonly);
 gchar * request_source_view_get_text (RequestSourceView * self);
 void request_source_view_set_text (RequestSourceView * self, gchar * text);
+void request_source_view_append_text (RequestSourceView * self, const gchar * text, gssize length);
+void request_source_view_select_range (RequestSourceView * self, guint64 line, guint32 index, guint32 length);
 RequestSourceViewContentType request_source_view_get_content_type (RequestSourceView * self);
 void request_source_view_set_content_type (RequestSourceView * self, RequestSourceViewContentType content_type);
 
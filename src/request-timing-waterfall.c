@@ -0,0 +1,144 @@
+/* request-timing-waterfall.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtk-4.0/gtk/gtk.h>
+
+#include "request-timing-waterfall.h"
+
+struct _RequestTimingWaterfall {
+    GtkDrawingArea parent_instance;
+
+    gboolean has_timings;
+    RequestTimings timings;
+};
+
+G_DEFINE_TYPE (RequestTimingWaterfall, request_timing_waterfall, GTK_TYPE_DRAWING_AREA);
+
+// Same order as RequestTimingPhase
+static const GdkRGBA phase_colors[TIMING_PHASE_COUNT] = {
+    { 0.75, 0.75, 0.75, 1 }, // queue
+    { 0.16, 0.63, 0.60, 1 }, // DNS
+    { 0.88, 0.55, 0.15, 1 }, // connect
+    { 0.61, 0.35, 0.71, 1 }, // TLS
+    { 0.45, 0.45, 0.45, 1 }, // send
+    { 0.51, 0.73, 0.22, 1 }, // wait
+    { 0.20, 0.52, 0.89, 1 }, // download
+};
+
+/**
+ * Draws each phase as a bar proportional to its share of the total duration,
+ * one after the other. Phases a preconnect did ahead of time are drawn faded.
+ */
+static void request_timing_waterfall_draw (GtkDrawingArea * area, cairo_t * cr, int width, int height, gpointer data) {
+    (void) area;
+    RequestTimingWaterfall * self = data;
+
+    if (!self->has_timings) {
+        return;
+    }
+
+    gint64 total = request_timings_get_total (&self->timings);
+    for (gint phase = 0; phase < TIMING_PHASE_COUNT; phase++) {
+        total += request_timings_get_preconnected_duration (&self->timings, phase);
+    }
+
+    if (total <= 0) {
+        return;
+    }
+
+    gdouble x = 0;
+    for (gint phase = 0; phase < TIMING_PHASE_COUNT; phase++) {
+        GdkRGBA color = phase_colors[phase];
+        gint64 duration = request_timings_get_phase_duration (&self->timings, phase);
+
+        if (duration <= 0) {
+            duration = request_timings_get_preconnected_duration (&self->timings, phase);
+            color.alpha = 0.4;
+        }
+
+        if (duration <= 0) {
+            continue;
+        }
+
+        // Keep very short phases visible
+        gdouble phase_width = MAX ((gdouble) duration / total * width, 1.0);
+
+        gdk_cairo_set_source_rgba (cr, &color);
+        cairo_rectangle (cr, x, 0, MIN (phase_width, width - x), height);
+        cairo_fill (cr);
+
+        x += phase_width;
+        if (x >= width) {
+            break;
+        }
+    }
+}
+
+static void request_timing_waterfall_class_init (RequestTimingWaterfallClass * klass) {
+    (void) klass;
+}
+
+static void request_timing_waterfall_init (RequestTimingWaterfall * self) {
+    gtk_drawing_area_set_content_width (GTK_DRAWING_AREA (self), 160);
+    gtk_drawing_area_set_content_height (GTK_DRAWING_AREA (self), 12);
+    gtk_widget_set_valign (GTK_WIDGET (self), GTK_ALIGN_CENTER);
+    gtk_drawing_area_set_draw_func (GTK_DRAWING_AREA (self), request_timing_waterfall_draw, self, NULL);
+}
+
+RequestTimingWaterfall * request_timing_waterfall_new (void) {
+    return g_object_new (REQUEST_TYPE_TIMING_WATERFALL, NULL);
+}
+
+/**
+ * Shows timings, or nothing when NULL. The breakdown of every phase goes in the
+ * tooltip.
+ */
+void request_timing_waterfall_set_timings (RequestTimingWaterfall * self, const RequestTimings * timings) {
+    g_return_if_fail (REQUEST_IS_TIMING_WATERFALL (self));
+
+    self->has_timings = timings != NULL;
+    if (timings == NULL) {
+        gtk_widget_set_tooltip_text (GTK_WIDGET (self), NULL);
+        gtk_widget_queue_draw (GTK_WIDGET (self));
+        return;
+    }
+
+    self->timings = *timings;
+
+    GString * tooltip = g_string_new (NULL);
+    for (gint phase = 0; phase < TIMING_PHASE_COUNT; phase++) {
+        gint64 duration = request_timings_get_phase_duration (timings, phase);
+        gint64 preconnected = request_timings_get_preconnected_duration (timings, phase);
+        gchar * formatted = request_timings_format_duration (duration > 0 ? duration : preconnected);
+
+        // FIXME: Handle translations
+        g_string_append_printf (tooltip, "%s%s: %s%s", tooltip->len > 0 ? "\n" : "", request_timings_get_phase_name (phase), formatted,
+                                duration <= 0 && preconnected > 0 ? " (preconnected)" : "");
+        g_free (formatted);
+    }
+
+    if (timings->is_preconnected) {
+        g_string_append (tooltip, "\nConnection preconnected"); // FIXME: Handle translations
+    } else if (request_timings_get_connection_reused (timings)) {
+        g_string_append (tooltip, "\nConnection reused"); // FIXME: Handle translations
+    }
+
+    gtk_widget_set_tooltip_text (GTK_WIDGET (self), tooltip->str);
+    g_string_free (tooltip, TRUE);
+
+    gtk_widget_queue_draw (GTK_WIDGET (self));
+}
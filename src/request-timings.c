@@ -0,0 +1,263 @@
+/* request-timings.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <libsoup/soup.h>
+
+#include "request-timings.h"
+
+#define TIMINGS_KEY "request-timings"
+
+static void request_timings_on_network_event (SoupMessage * msg, GSocketClientEvent event, GIOStream * connection, gpointer data) {
+    (void) msg;
+    (void) connection;
+    RequestTimings * self = data;
+    gint64 now = g_get_monotonic_time ();
+
+    // Network events are only emitted while a new connection is being set up,
+    // a message sent over a pooled connection never goes through them.
+    switch (event) {
+        case G_SOCKET_CLIENT_RESOLVING:
+            self->dns_start = now;
+            break;
+        case G_SOCKET_CLIENT_RESOLVED:
+            self->dns_end = now;
+            break;
+        case G_SOCKET_CLIENT_CONNECTING:
+            self->connect_start = now;
+            break;
+        case G_SOCKET_CLIENT_CONNECTED:
+            self->connect_end = now;
+            break;
+        case G_SOCKET_CLIENT_TLS_HANDSHAKING:
+            self->tls_start = now;
+            break;
+        case G_SOCKET_CLIENT_TLS_HANDSHAKED:
+            self->tls_end = now;
+            break;
+        default:
+            break;
+    }
+}
+
+static void request_timings_on_starting (SoupMessage * msg, gpointer data) {
+    (void) msg;
+    RequestTimings * self = data;
+
+    self->sending = g_get_monotonic_time ();
+}
+
+static void request_timings_on_wrote_body (SoupMessage * msg, gpointer data) {
+    (void) msg;
+    RequestTimings * self = data;
+
+    self->request_sent = g_get_monotonic_time ();
+}
+
+static void request_timings_on_got_headers (SoupMessage * msg, gpointer data) {
+    (void) msg;
+    RequestTimings * self = data;
+
+    // Informational responses (1xx) come with their own headers, keep the
+    // time of the final ones.
+    self->first_byte = g_get_monotonic_time ();
+    self->last_byte = self->first_byte;
+}
+
+static void request_timings_on_got_chunk (SoupMessage * msg, SoupBuffer * chunk, gpointer data) {
+    (void) msg;
+    (void) chunk;
+    RequestTimings * self = data;
+
+    self->last_byte = g_get_monotonic_time ();
+}
+
+/**
+ * Starts timing msg, must be called right before the message is sent.
+ */
+RequestTimings * request_timings_attach (SoupMessage * msg) {
+    g_return_val_if_fail (SOUP_IS_MESSAGE (msg), NULL);
+
+    RequestTimings * self = g_new0 (RequestTimings, 1);
+    self->start = g_get_monotonic_time ();
+
+    g_object_set_data_full (G_OBJECT (msg), TIMINGS_KEY, self, g_free);
+
+    g_signal_connect (msg, "network-event", G_CALLBACK (request_timings_on_network_event), self);
+    g_signal_connect (msg, "starting", G_CALLBACK (request_timings_on_starting), self);
+    g_signal_connect (msg, "wrote-body", G_CALLBACK (request_timings_on_wrote_body), self);
+    g_signal_connect (msg, "got-headers", G_CALLBACK (request_timings_on_got_headers), self);
+    g_signal_connect (msg, "got-chunk", G_CALLBACK (request_timings_on_got_chunk), self);
+
+    return self;
+}
+
+RequestTimings * request_timings_get (SoupMessage * msg) {
+    g_return_val_if_fail (SOUP_IS_MESSAGE (msg), NULL);
+
+    return g_object_get_data (G_OBJECT (msg), TIMINGS_KEY);
+}
+
+/**
+ * Records the arrival of body data. Streamed bodies don't emit got-chunk, their
+ * reader reports chunks here instead.
+ */
+void request_timings_mark_body_chunk (SoupMessage * msg) {
+    RequestTimings * self = request_timings_get (msg);
+    if (self == NULL) {
+        return;
+    }
+
+    self->last_byte = g_get_monotonic_time ();
+}
+
+gboolean request_timings_get_connection_reused (const RequestTimings * self) {
+    g_return_val_if_fail (self != NULL, FALSE);
+
+    return self->connect_start == 0;
+}
+
+gint64 request_timings_get_total (const RequestTimings * self) {
+    g_return_val_if_fail (self != NULL, 0);
+
+    if (self->last_byte == 0) {
+        return 0;
+    }
+
+    return self->last_byte - self->start;
+}
+
+/**
+ * Returns when the connection was ready to send the request.
+ */
+static gint64 request_timings_get_connection_ready (const RequestTimings * self) {
+    if (self->tls_end != 0)
+        return self->tls_end;
+    if (self->connect_end != 0)
+        return self->connect_end;
+
+    return 0;
+}
+
+/**
+ * Returns the duration of phase in µs, 0 if the message didn't go through it.
+ */
+gint64 request_timings_get_phase_duration (const RequestTimings * self, RequestTimingPhase phase) {
+    g_return_val_if_fail (self != NULL, 0);
+
+    gint64 connection_ready = request_timings_get_connection_ready (self);
+    gint64 first_step = self->dns_start != 0 ? self->dns_start : self->connect_start;
+
+    switch (phase) {
+        case TIMING_PHASE_QUEUE:
+            // Waiting for a free connection, or for the new one to start
+            if (first_step != 0)
+                return first_step - self->start;
+            if (self->sending != 0)
+                return self->sending - self->start;
+            return 0;
+        case TIMING_PHASE_DNS:
+            if (self->dns_start == 0 || self->dns_end == 0)
+                return 0;
+            return self->dns_end - self->dns_start;
+        case TIMING_PHASE_CONNECT:
+            if (self->connect_start == 0 || self->connect_end == 0)
+                return 0;
+            return (self->tls_start != 0 ? self->tls_start : self->connect_end) - self->connect_start;
+        case TIMING_PHASE_TLS:
+            if (self->tls_start == 0 || self->tls_end == 0)
+                return 0;
+            return self->tls_end - self->tls_start;
+        case TIMING_PHASE_SEND:
+            if (self->request_sent == 0)
+                return 0;
+            if (connection_ready != 0)
+                return self->request_sent - connection_ready;
+            return self->request_sent - (self->sending != 0 ? self->sending : self->start);
+        case TIMING_PHASE_WAIT:
+            if (self->request_sent == 0 || self->first_byte == 0)
+                return 0;
+            return self->first_byte - self->request_sent;
+        case TIMING_PHASE_DOWNLOAD:
+            if (self->first_byte == 0 || self->last_byte == 0)
+                return 0;
+            return self->last_byte - self->first_byte;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Records that self reused the connection preconnect opened, so that the
+ * phases it skipped can still be shown.
+ */
+void request_timings_set_preconnected (RequestTimings * self, const RequestTimings * preconnect) {
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (preconnect != NULL);
+
+    self->is_preconnected = TRUE;
+    self->preconnected_durations[TIMING_PHASE_DNS] = request_timings_get_phase_duration (preconnect, TIMING_PHASE_DNS);
+    self->preconnected_durations[TIMING_PHASE_CONNECT] = request_timings_get_phase_duration (preconnect, TIMING_PHASE_CONNECT);
+    self->preconnected_durations[TIMING_PHASE_TLS] = request_timings_get_phase_duration (preconnect, TIMING_PHASE_TLS);
+}
+
+/**
+ * Returns the duration of phase done ahead of time by a preconnect, 0 when the
+ * request was not preconnected.
+ */
+gint64 request_timings_get_preconnected_duration (const RequestTimings * self, RequestTimingPhase phase) {
+    g_return_val_if_fail (self != NULL, 0);
+    g_return_val_if_fail (phase < TIMING_PHASE_COUNT, 0);
+
+    return self->is_preconnected ? self->preconnected_durations[phase] : 0;
+}
+
+const gchar * request_timings_get_phase_name (RequestTimingPhase phase) {
+    // FIXME: Handle translations
+    switch (phase) {
+        case TIMING_PHASE_QUEUE:
+            return "Queued";
+        case TIMING_PHASE_DNS:
+            return "DNS lookup";
+        case TIMING_PHASE_CONNECT:
+            return "TCP connect";
+        case TIMING_PHASE_TLS:
+            return "TLS handshake";
+        case TIMING_PHASE_SEND:
+            return "Request sent";
+        case TIMING_PHASE_WAIT:
+            return "Waiting (TTFB)";
+        case TIMING_PHASE_DOWNLOAD:
+            return "Content download";
+        default:
+            return "";
+    }
+}
+
+/**
+ * Formats a duration given in µs.
+ */
+gchar * request_timings_format_duration (gint64 duration) {
+    if (duration >= G_USEC_PER_SEC) {
+        return g_strdup_printf ("%.2f s", (gdouble) duration / G_USEC_PER_SEC);
+    }
+
+    if (duration >= 1000) {
+        return g_strdup_printf ("%.2f ms", (gdouble) duration / 1000);
+    }
+
+    return g_strdup_printf ("%" G_GINT64_FORMAT " µs", duration);
+}
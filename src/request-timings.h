@@ -0,0 +1,69 @@
+/* request-timings.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+typedef enum RequestTimingPhase {
+    TIMING_PHASE_QUEUE,
+    TIMING_PHASE_DNS,
+    TIMING_PHASE_CONNECT,
+    TIMING_PHASE_TLS,
+    TIMING_PHASE_SEND,
+    TIMING_PHASE_WAIT,
+    TIMING_PHASE_DOWNLOAD,
+    TIMING_PHASE_COUNT,
+} RequestTimingPhase;
+
+/**
+ * Monotonic timestamps (g_get_monotonic_time, in µs) of the steps a message goes
+ * through, 0 when the step did not happen.
+ */
+typedef struct RequestTimings {
+    gint64 start;
+    gint64 dns_start;
+    gint64 dns_end;
+    gint64 connect_start;
+    gint64 connect_end;
+    gint64 tls_start;
+    gint64 tls_end;
+    gint64 sending;
+    gint64 request_sent;
+    gint64 first_byte;
+    gint64 last_byte;
+
+    // Set when the request reused a connection opened ahead of time, with the
+    // durations (in µs) of the phases it was spared.
+    gboolean is_preconnected;
+    gint64 preconnected_durations[TIMING_PHASE_COUNT];
+} RequestTimings;
+
+RequestTimings * request_timings_attach (SoupMessage * msg);
+RequestTimings * request_timings_get (SoupMessage * msg);
+void request_timings_mark_body_chunk (SoupMessage * msg);
+gboolean request_timings_get_connection_reused (const RequestTimings * self);
+gint64 request_timings_get_total (const RequestTimings * self);
+gint64 request_timings_get_phase_duration (const RequestTimings * self, RequestTimingPhase phase);
+void request_timings_set_preconnected (RequestTimings * self, const RequestTimings * preconnect);
+gint64 request_timings_get_preconnected_duration (const RequestTimings * self, RequestTimingPhase phase);
+const gchar * request_timings_get_phase_name (RequestTimingPhase phase);
+gchar * request_timings_format_duration (gint64 duration);
+
+G_END_DECLS
@@ -0,0 +1,242 @@
+/* request-transfer-progress.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtk-4.0/gtk/gtk.h>
+
+#include "request-transfer-progress.h"
+
+// Labels are refreshed at this pace rather than on every chunk
+#define PROGRESS_REFRESH_INTERVAL 250 // ms
+
+// Without any data for that long the transfer is reported as stalled
+#define PROGRESS_STALL_DELAY (2 * G_USEC_PER_SEC)
+
+// Weight of the last sample in the instantaneous rate
+#define PROGRESS_RATE_SMOOTHING 0.3
+
+struct _RequestTransferProgress {
+    GtkBox parent_instance;
+
+    /* Template widgets */
+    GtkProgressBar * progress_bar;
+    GtkLabel * size_label;
+    GtkLabel * rate_label;
+    GtkButton * cancel_button;
+
+    guint refresh_source_id;
+    gboolean has_headers;
+    goffset expected_length; // -1 when unknown
+    goffset received_length;
+    gint64 first_byte_time;
+    gint64 last_data_time;
+
+    // Previous refresh, for the instantaneous rate
+    goffset last_sample_length;
+    gint64 last_sample_time;
+    gdouble rate;
+};
+
+G_DEFINE_TYPE (RequestTransferProgress, request_transfer_progress, GTK_TYPE_BOX);
+
+static gchar * request_transfer_progress_format_rate (gdouble rate) {
+    gchar * size = g_format_size ((guint64) rate);
+    gchar * formatted = g_strdup_printf ("%s/s", size);
+    g_free (size);
+
+    return formatted;
+}
+
+static void request_transfer_progress_refresh_size (RequestTransferProgress * self) {
+    gchar * received = g_format_size ((guint64) self->received_length);
+
+    if (self->expected_length > 0) {
+        gchar * expected = g_format_size ((guint64) self->expected_length);
+        gchar * text = g_strdup_printf ("%s of %s", received, expected); // FIXME: Handle translations
+
+        gtk_label_set_text (self->size_label, text);
+        gtk_progress_bar_set_fraction (self->progress_bar, CLAMP ((gdouble) self->received_length / self->expected_length, 0, 1));
+
+        g_free (text);
+        g_free (expected);
+    } else {
+        gtk_label_set_text (self->size_label, received);
+        gtk_progress_bar_pulse (self->progress_bar);
+    }
+
+    g_free (received);
+}
+
+static void request_transfer_progress_refresh_rate (RequestTransferProgress * self, gint64 now) {
+    gint64 elapsed = now - self->last_sample_time;
+    if (elapsed > 0) {
+        gdouble sample = (gdouble) (self->received_length - self->last_sample_length) * G_USEC_PER_SEC / elapsed;
+        self->rate = self->rate == 0 ? sample : PROGRESS_RATE_SMOOTHING * sample + (1 - PROGRESS_RATE_SMOOTHING) * self->rate;
+    }
+
+    self->last_sample_length = self->received_length;
+    self->last_sample_time = now;
+
+    if (now - self->last_data_time >= PROGRESS_STALL_DELAY) {
+        gchar * text = g_strdup_printf ("Stalled for %" G_GINT64_FORMAT " s", (now - self->last_data_time) / G_USEC_PER_SEC); // FIXME: Handle translations
+        gtk_label_set_text (self->rate_label, text);
+        g_free (text);
+        return;
+    }
+
+    gdouble average = now > self->first_byte_time ? (gdouble) self->received_length * G_USEC_PER_SEC / (now - self->first_byte_time) : 0;
+
+    gchar * rate = request_transfer_progress_format_rate (self->rate);
+    gchar * average_rate = request_transfer_progress_format_rate (average);
+    GString * text = g_string_new (NULL);
+
+    g_string_printf (text, "%s, average %s", rate, average_rate); // FIXME: Handle translations
+
+    gdouble eta_rate = self->rate > 0 ? self->rate : average;
+    if (self->expected_length > 0 && eta_rate > 0) {
+        goffset remaining = MAX (self->expected_length - self->received_length, 0);
+        g_string_append_printf (text, ", %.0f s left", remaining / eta_rate); // FIXME: Handle translations
+    }
+
+    gtk_label_set_text (self->rate_label, text->str);
+
+    g_string_free (text, TRUE);
+    g_free (rate);
+    g_free (average_rate);
+}
+
+static gboolean request_transfer_progress_on_refresh (gpointer data) {
+    RequestTransferProgress * self = data;
+
+    if (!self->has_headers) {
+        gtk_progress_bar_pulse (self->progress_bar);
+        return G_SOURCE_CONTINUE;
+    }
+
+    request_transfer_progress_refresh_size (self);
+    request_transfer_progress_refresh_rate (self, g_get_monotonic_time ());
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void request_transfer_progress_on_cancel (GtkButton * button, gpointer data) {
+    (void) button;
+    RequestTransferProgress * self = data;
+    g_return_if_fail (self != NULL);
+
+    g_signal_emit_by_name (self, TRANSFER_PROGRESS_CANCEL_SIGNAL);
+}
+
+static void request_transfer_progress_dispose (GObject * object) {
+    RequestTransferProgress * self = REQUEST_TRANSFER_PROGRESS (object);
+
+    g_clear_handle_id (&self->refresh_source_id, g_source_remove);
+
+    G_OBJECT_CLASS (request_transfer_progress_parent_class)->dispose (object);
+}
+
+static void request_transfer_progress_class_init (RequestTransferProgressClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
+    GtkWidgetClass * widget_class = GTK_WIDGET_CLASS (klass);
+
+    object_class->dispose = request_transfer_progress_dispose;
+
+    gtk_widget_class_set_template_from_resource (widget_class, "/com/github/guillotjulien/request/resources/ui/request-transfer-progress.ui");
+    gtk_widget_class_bind_template_child (widget_class, RequestTransferProgress, progress_bar);
+    gtk_widget_class_bind_template_child (widget_class, RequestTransferProgress, size_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestTransferProgress, rate_label);
+    gtk_widget_class_bind_template_child (widget_class, RequestTransferProgress, cancel_button);
+
+    // Declare our own signals
+    g_signal_new (TRANSFER_PROGRESS_CANCEL_SIGNAL, REQUEST_TYPE_TRANSFER_PROGRESS, G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+}
+
+static void request_transfer_progress_init (RequestTransferProgress * self) {
+    gtk_widget_init_template (GTK_WIDGET (self));
+
+    g_return_if_fail (GTK_IS_WIDGET (self->progress_bar));
+    g_return_if_fail (GTK_IS_WIDGET (self->size_label));
+    g_return_if_fail (GTK_IS_WIDGET (self->rate_label));
+    g_return_if_fail (GTK_IS_WIDGET (self->cancel_button));
+
+    gtk_widget_set_visible (GTK_WIDGET (self), FALSE);
+
+    g_signal_connect (self->cancel_button, "clicked", G_CALLBACK (request_transfer_progress_on_cancel), self);
+}
+
+RequestTransferProgress * request_transfer_progress_new (void) {
+    return g_object_new (REQUEST_TYPE_TRANSFER_PROGRESS, NULL);
+}
+
+/**
+ * Shows the progress of a new request, waiting for its response.
+ */
+void request_transfer_progress_start (RequestTransferProgress * self) {
+    g_return_if_fail (REQUEST_IS_TRANSFER_PROGRESS (self));
+
+    self->has_headers = FALSE;
+    self->expected_length = -1;
+    self->received_length = 0;
+    self->rate = 0;
+
+    gtk_progress_bar_set_fraction (self->progress_bar, 0);
+    gtk_label_set_text (self->size_label, "Waiting for response"); // FIXME: Handle translations
+    gtk_label_set_text (self->rate_label, "");
+    gtk_widget_set_visible (GTK_WIDGET (self), TRUE);
+
+    if (self->refresh_source_id == 0) {
+        self->refresh_source_id = g_timeout_add (PROGRESS_REFRESH_INTERVAL, request_transfer_progress_on_refresh, self);
+    }
+}
+
+/**
+ * Starts tracking the body once the headers arrived, expected_length is the
+ * Content-Length or -1 when the server did not announce it.
+ */
+void request_transfer_progress_set_expected_length (RequestTransferProgress * self, goffset expected_length) {
+    g_return_if_fail (REQUEST_IS_TRANSFER_PROGRESS (self));
+
+    gint64 now = g_get_monotonic_time ();
+
+    self->has_headers = TRUE;
+    self->expected_length = expected_length;
+    self->first_byte_time = now;
+    self->last_data_time = now;
+    self->last_sample_time = now;
+    self->last_sample_length = 0;
+
+    request_transfer_progress_refresh_size (self);
+}
+
+/**
+ * Records that received_length bytes of the body arrived so far.
+ */
+void request_transfer_progress_update (RequestTransferProgress * self, goffset received_length) {
+    g_return_if_fail (REQUEST_IS_TRANSFER_PROGRESS (self));
+
+    if (received_length != self->received_length) {
+        self->last_data_time = g_get_monotonic_time ();
+    }
+
+    self->received_length = received_length;
+}
+
+void request_transfer_progress_stop (RequestTransferProgress * self) {
+    g_return_if_fail (REQUEST_IS_TRANSFER_PROGRESS (self));
+
+    g_clear_handle_id (&self->refresh_source_id, g_source_remove);
+    gtk_widget_set_visible (GTK_WIDGET (self), FALSE);
+}
@@ -0,0 +1,36 @@
+/* request-transfer-progress.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gtk-4.0/gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define REQUEST_TYPE_TRANSFER_PROGRESS (request_transfer_progress_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestTransferProgress, request_transfer_progress, REQUEST, TRANSFER_PROGRESS, GtkBox)
+
+#define TRANSFER_PROGRESS_CANCEL_SIGNAL "cancel"
+
+RequestTransferProgress * request_transfer_progress_new (void);
+void request_transfer_progress_start (RequestTransferProgress * self);
+void request_transfer_progress_set_expected_length (RequestTransferProgress * self, goffset expected_length);
+void request_transfer_progress_update (RequestTransferProgress * self, goffset received_length);
+void request_transfer_progress_stop (RequestTransferProgress * self);
+
+G_END_DECLS
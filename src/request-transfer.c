@@ -0,0 +1,290 @@
+/* request-transfer.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <libsoup/soup.h>
+
+#include "request-transfer.h"
+#include "request-timings.h"
+#include "request-content-decoder.h"
+
+// Size of the reads done on the response stream, each one is handed over as a
+// single chunk.
+#define TRANSFER_CHUNK_SIZE (64 * 1024)
+
+#define TRANSFER_KEY "request-transfer"
+
+struct _RequestTransfer {
+    GObject parent_instance;
+
+    SoupSession * session;
+    SoupMessage * msg;
+    GInputStream * stream;
+    GCancellable * cancellable;
+
+    RequestContentDecoder * content_decoder;
+    goffset received_length; // as sent on the wire, still encoded
+    goffset decoded_length;
+    gboolean is_completed;
+    GError * error;
+};
+
+G_DEFINE_TYPE (RequestTransfer, request_transfer, G_TYPE_OBJECT);
+
+static void request_transfer_dispose (GObject * object) {
+    RequestTransfer * self = REQUEST_TRANSFER (object);
+
+    g_clear_object (&self->stream);
+    g_clear_object (&self->cancellable);
+
+    if (self->msg != NULL && g_object_get_data (G_OBJECT (self->msg), TRANSFER_KEY) == self) {
+        g_object_set_data (G_OBJECT (self->msg), TRANSFER_KEY, NULL);
+    }
+
+    g_clear_object (&self->msg);
+    g_clear_object (&self->session);
+
+    G_OBJECT_CLASS (request_transfer_parent_class)->dispose (object);
+}
+
+static void request_transfer_finalize (GObject * object) {
+    RequestTransfer * self = REQUEST_TRANSFER (object);
+
+    g_clear_error (&self->error);
+    request_content_decoder_free (self->content_decoder);
+
+    G_OBJECT_CLASS (request_transfer_parent_class)->finalize (object);
+}
+
+static void request_transfer_class_init (RequestTransferClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = request_transfer_dispose;
+    object_class->finalize = request_transfer_finalize;
+
+    // Declare our own signals
+    g_signal_new (TRANSFER_HEADERS_SIGNAL, REQUEST_TYPE_TRANSFER, G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+    g_signal_new (TRANSFER_CHUNK_SIGNAL, REQUEST_TYPE_TRANSFER, G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_VOID__BOXED, G_TYPE_NONE, 1, G_TYPE_BYTES);
+    g_signal_new (TRANSFER_COMPLETED_SIGNAL, REQUEST_TYPE_TRANSFER, G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+}
+
+static void request_transfer_init (RequestTransfer * self) {
+    self->cancellable = g_cancellable_new ();
+}
+
+RequestTransfer * request_transfer_new (SoupSession * session, SoupMessage * msg) {
+    g_return_val_if_fail (SOUP_IS_SESSION (session), NULL);
+    g_return_val_if_fail (SOUP_IS_MESSAGE (msg), NULL);
+
+    RequestTransfer * self = g_object_new (REQUEST_TYPE_TRANSFER, NULL);
+    self->session = g_object_ref (session);
+    self->msg = g_object_ref (msg);
+
+    // Not a reference, cleared when the transfer goes away
+    g_object_set_data (G_OBJECT (msg), TRANSFER_KEY, self);
+
+    return self;
+}
+
+/**
+ * Takes ownership of error.
+ */
+static void request_transfer_complete (RequestTransfer * self, GError * error) {
+    if (self->is_completed) {
+        g_clear_error (&error);
+        return;
+    }
+
+    self->is_completed = TRUE;
+    self->error = error;
+
+    // Dropping the stream lets libsoup finish the message and give the
+    // connection back to the pool
+    g_clear_object (&self->stream);
+
+    g_signal_emit_by_name (self, TRANSFER_COMPLETED_SIGNAL);
+}
+
+static void request_transfer_read_next (RequestTransfer * self);
+
+static void request_transfer_on_stream_closed (GObject * source, GAsyncResult * result, gpointer data) {
+    RequestTransfer * self = data;
+    GError * error = NULL;
+
+    g_input_stream_close_finish (G_INPUT_STREAM (source), result, &error);
+    request_transfer_complete (self, error);
+
+    g_object_unref (self);
+}
+
+/**
+ * Emits the body data held by chunk, decoded when the response has a
+ * Content-Encoding. is_last flushes the decoder.
+ */
+static gboolean request_transfer_emit_chunk (RequestTransfer * self, GBytes * chunk, gboolean is_last, GError ** error) {
+    if (self->content_decoder == NULL) {
+        if (!is_last) {
+            self->decoded_length += g_bytes_get_size (chunk);
+            g_signal_emit_by_name (self, TRANSFER_CHUNK_SIGNAL, chunk);
+        }
+
+        return TRUE;
+    }
+
+    gsize length;
+    const guint8 * data = g_bytes_get_data (chunk, &length);
+
+    GByteArray * decoded = g_byte_array_new ();
+    if (!request_content_decoder_decode (self->content_decoder, data, length, is_last, decoded, error)) {
+        g_byte_array_unref (decoded);
+        return FALSE;
+    }
+
+    if (decoded->len > 0) {
+        self->decoded_length += decoded->len;
+
+        GBytes * decoded_chunk = g_byte_array_free_to_bytes (decoded);
+        g_signal_emit_by_name (self, TRANSFER_CHUNK_SIGNAL, decoded_chunk);
+        g_bytes_unref (decoded_chunk);
+    } else {
+        g_byte_array_unref (decoded);
+    }
+
+    return TRUE;
+}
+
+static void request_transfer_on_chunk_read (GObject * source, GAsyncResult * result, gpointer data) {
+    RequestTransfer * self = data;
+    GError * error = NULL;
+
+    GBytes * chunk = g_input_stream_read_bytes_finish (G_INPUT_STREAM (source), result, &error);
+    if (chunk == NULL) {
+        request_transfer_complete (self, error);
+        g_object_unref (self);
+        return;
+    }
+
+    gboolean is_last = g_bytes_get_size (chunk) == 0;
+    self->received_length += g_bytes_get_size (chunk);
+
+    if (!is_last) {
+        request_timings_mark_body_chunk (self->msg);
+    }
+
+    if (!request_transfer_emit_chunk (self, chunk, is_last, &error)) {
+        g_bytes_unref (chunk);
+        request_transfer_complete (self, error);
+        g_object_unref (self);
+        return;
+    }
+
+    g_bytes_unref (chunk);
+
+    if (is_last) { // end of stream
+        g_input_stream_close_async (self->stream, G_PRIORITY_DEFAULT, self->cancellable, request_transfer_on_stream_closed, self);
+        return;
+    }
+
+    request_transfer_read_next (self);
+}
+
+static void request_transfer_read_next (RequestTransfer * self) {
+    g_input_stream_read_bytes_async (self->stream, TRANSFER_CHUNK_SIZE, G_PRIORITY_DEFAULT, self->cancellable, request_transfer_on_chunk_read, self);
+}
+
+static void request_transfer_on_sent (GObject * source, GAsyncResult * result, gpointer data) {
+    RequestTransfer * self = data;
+    GError * error = NULL;
+
+    self->stream = soup_session_send_finish (SOUP_SESSION (source), result, &error);
+    if (self->stream == NULL) {
+        request_transfer_complete (self, error);
+        g_object_unref (self);
+        return;
+    }
+
+    self->content_decoder = request_content_decoder_new (self->msg->response_headers);
+
+    g_signal_emit_by_name (self, TRANSFER_HEADERS_SIGNAL);
+
+    request_transfer_read_next (self);
+}
+
+/**
+ * Sends the message and reads the response body as a stream. Chunks are
+ * emitted as soon as they are read and are not kept around, so the memory
+ * used by a transfer does not grow with the size of the response.
+ */
+void request_transfer_start (RequestTransfer * self) {
+    g_return_if_fail (REQUEST_IS_TRANSFER (self));
+
+    request_timings_attach (self->msg);
+
+    // The session doesn't decode bodies itself, so that the size on the wire
+    // can be measured; advertise what we decode instead.
+    if (soup_message_headers_get_one (self->msg->request_headers, "Accept-Encoding") == NULL) {
+        soup_message_headers_append (self->msg->request_headers, "Accept-Encoding", request_content_decoder_get_accept_encoding ());
+    }
+
+    // Keep ourselves alive until the transfer completes
+    soup_session_send_async (self->session, self->msg, self->cancellable, request_transfer_on_sent, g_object_ref (self));
+}
+
+void request_transfer_cancel (RequestTransfer * self) {
+    g_return_if_fail (REQUEST_IS_TRANSFER (self));
+
+    g_cancellable_cancel (self->cancellable);
+}
+
+SoupMessage * request_transfer_get_message (RequestTransfer * self) {
+    g_return_val_if_fail (REQUEST_IS_TRANSFER (self), NULL);
+
+    return self->msg;
+}
+
+/**
+ * Returns the transfer that sends msg, if it is still alive.
+ */
+RequestTransfer * request_transfer_get_from_message (SoupMessage * msg) {
+    g_return_val_if_fail (SOUP_IS_MESSAGE (msg), NULL);
+
+    return g_object_get_data (G_OBJECT (msg), TRANSFER_KEY);
+}
+
+/**
+ * Returns the number of body bytes received on the wire, before content
+ * decoding.
+ */
+goffset request_transfer_get_received_length (RequestTransfer * self) {
+    g_return_val_if_fail (REQUEST_IS_TRANSFER (self), 0);
+
+    return self->received_length;
+}
+
+/**
+ * Returns the number of body bytes emitted so far, after content decoding.
+ */
+goffset request_transfer_get_decoded_length (RequestTransfer * self) {
+    g_return_val_if_fail (REQUEST_IS_TRANSFER (self), 0);
+
+    return self->decoded_length;
+}
+
+const GError * request_transfer_get_error (RequestTransfer * self) {
+    g_return_val_if_fail (REQUEST_IS_TRANSFER (self), NULL);
+
+    return self->error;
+}
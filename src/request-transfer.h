@@ -0,0 +1,41 @@
+/* request-transfer.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+#define REQUEST_TYPE_TRANSFER (request_transfer_get_type ())
+
+G_DECLARE_FINAL_TYPE (RequestTransfer, request_transfer, REQUEST, TRANSFER, GObject)
+
+#define TRANSFER_HEADERS_SIGNAL "headers"
+#define TRANSFER_CHUNK_SIGNAL "chunk"
+#define TRANSFER_COMPLETED_SIGNAL "completed"
+
+RequestTransfer * request_transfer_new (SoupSession * session, SoupMessage * msg);
+void request_transfer_start (RequestTransfer * self);
+void request_transfer_cancel (RequestTransfer * self);
+SoupMessage * request_transfer_get_message (RequestTransfer * self);
+RequestTransfer * request_transfer_get_from_message (SoupMessage * msg);
+goffset request_transfer_get_received_length (RequestTransfer * self);
+goffset request_transfer_get_decoded_length (RequestTransfer * self);
+const GError * request_transfer_get_error (RequestTransfer * self);
+
+G_END_DECLS
@@ -0,0 +1,178 @@
+/* request-upload.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+#include <string.h>
+
+#include "request-upload.h"
+
+#define UPLOAD_CHUNK_SIZE (1024 * 1024) // size of the chunks when the body is chunked
+
+/**
+ * Returns the content of the file at path without reading it: the file is
+ * mapped in memory and the buffer points into the mapping, pages are only
+ * loaded while libsoup writes them to the socket. The mapping is released with
+ * the last buffer referencing it. The file must not be modified until the
+ * message is sent.
+ *
+ * libsoup 2.4 cannot stream a request body from a GInputStream, files that
+ * cannot be mapped (e.g. pipes) are refused.
+ */
+static SoupBuffer * request_upload_map_file (const gchar * path, GError ** error) {
+    GMappedFile * file = g_mapped_file_new (path, FALSE, error);
+    if (file == NULL) {
+        return NULL;
+    }
+
+    return soup_buffer_new_with_owner (g_mapped_file_get_contents (file), g_mapped_file_get_length (file), file, (GDestroyNotify) g_mapped_file_unref);
+}
+
+static gchar * request_upload_guess_mime_type (const gchar * path) {
+    gchar * type = g_content_type_guess (path, NULL, 0, NULL);
+    gchar * mime_type = g_content_type_get_mime_type (type);
+
+    g_free (type);
+
+    return mime_type != NULL ? mime_type : g_strdup ("application/octet-stream");
+}
+
+/**
+ * Sets the content of the file at path as the request body of msg, without
+ * loading it (see request_upload_map_file).
+ */
+gboolean request_upload_set_file (SoupMessage * msg, const gchar * path, RequestUploadFraming framing, GError ** error) {
+    g_return_val_if_fail (SOUP_IS_MESSAGE (msg), FALSE);
+    g_return_val_if_fail (path != NULL, FALSE);
+
+    SoupBuffer * contents = request_upload_map_file (path, error);
+    if (contents == NULL) {
+        return FALSE;
+    }
+
+    gsize length = contents->length;
+
+    soup_message_body_truncate (msg->request_body);
+
+    if (framing == UPLOAD_FRAMING_CHUNKED) {
+        soup_message_headers_set_encoding (msg->request_headers, SOUP_ENCODING_CHUNKED);
+
+        for (gsize offset = 0; offset < length; offset += UPLOAD_CHUNK_SIZE) {
+            SoupBuffer * chunk = soup_buffer_new_subbuffer (contents, offset, MIN (UPLOAD_CHUNK_SIZE, length - offset));
+            soup_message_body_append_buffer (msg->request_body, chunk);
+            soup_buffer_free (chunk);
+        }
+    } else {
+        soup_message_headers_set_content_length (msg->request_headers, length);
+
+        if (length > 0) {
+            soup_message_body_append_buffer (msg->request_body, contents);
+        }
+    }
+
+    soup_message_body_complete (msg->request_body);
+    soup_buffer_free (contents);
+
+    if (soup_message_headers_get_content_type (msg->request_headers, NULL) == NULL) {
+        gchar * mime_type = request_upload_guess_mime_type (path);
+        soup_message_headers_set_content_type (msg->request_headers, mime_type, NULL);
+        g_free (mime_type);
+    }
+
+    return TRUE;
+}
+
+/**
+ * Returns an empty multipart/form-data body, to be filled with
+ * request_upload_form_append.
+ */
+SoupMultipart * request_upload_form_new (void) {
+    return soup_multipart_new (SOUP_FORM_MIME_TYPE_MULTIPART);
+}
+
+/**
+ * Appends a field to form. Like with curl, a value starting with @ is the path
+ * of a file sent as the field content (relative to directory when not NULL),
+ * @@ escapes a text value starting with @.
+ */
+gboolean request_upload_form_append (SoupMultipart * form, const gchar * name, const gchar * value, const gchar * directory, GError ** error) {
+    g_return_val_if_fail (form != NULL, FALSE);
+    g_return_val_if_fail (name != NULL, FALSE);
+    g_return_val_if_fail (value != NULL, FALSE);
+
+    if (value[0] != '@' || value[1] == '@') {
+        soup_multipart_append_form_string (form, name, value[0] == '@' ? value + 1 : value);
+        return TRUE;
+    }
+
+    gchar * path = directory != NULL && !g_path_is_absolute (value + 1) ? g_build_filename (directory, value + 1, NULL) : g_strdup (value + 1);
+    SoupBuffer * contents = request_upload_map_file (path, error);
+
+    if (contents == NULL) {
+        g_free (path);
+        return FALSE;
+    }
+
+    gchar * filename = g_path_get_basename (path);
+    gchar * mime_type = request_upload_guess_mime_type (path);
+
+    soup_multipart_append_form_file (form, name, filename, mime_type, contents);
+
+    g_free (mime_type);
+    g_free (filename);
+    soup_buffer_free (contents);
+    g_free (path);
+
+    return TRUE;
+}
+
+/**
+ * Sets form as the request body of msg. Part headers are the only bytes
+ * generated, files are referenced by their mapping so the body is never
+ * assembled in memory, and its Content-Length is known before sending.
+ */
+void request_upload_set_form (SoupMessage * msg, SoupMultipart * form) {
+    g_return_if_fail (SOUP_IS_MESSAGE (msg));
+    g_return_if_fail (form != NULL);
+
+    soup_message_body_truncate (msg->request_body);
+    soup_multipart_to_message (form, msg->request_headers, msg->request_body);
+    soup_message_headers_set_content_length (msg->request_headers, msg->request_body->length);
+}
+
+/**
+ * Sets text, typed in the request view, as the request body of msg. Takes
+ * ownership of text. Empty texts leave msg without a body.
+ */
+void request_upload_set_text (SoupMessage * msg, gchar * text) {
+    g_return_if_fail (SOUP_IS_MESSAGE (msg));
+
+    if (text == NULL || *text == '\0') {
+        g_free (text);
+        return;
+    }
+
+    // Copied, soup_message_set_request frees the header before setting it back
+    gchar * content_type = g_strdup (soup_message_headers_get_one (msg->request_headers, "Content-Type"));
+    if (content_type == NULL) {
+        const gchar * start = text + strspn (text, " \t\r\n");
+        content_type = g_strdup (*start == '{' || *start == '[' ? "application/json" : "text/plain; charset=utf-8");
+    }
+
+    soup_message_set_request (msg, content_type, SOUP_MEMORY_TAKE, text, strlen (text));
+    g_free (content_type);
+}
@@ -0,0 +1,35 @@
+/* request-upload.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+typedef enum RequestUploadFraming {
+    UPLOAD_FRAMING_CONTENT_LENGTH,
+    UPLOAD_FRAMING_CHUNKED,
+} RequestUploadFraming;
+
+gboolean request_upload_set_file (SoupMessage * msg, const gchar * path, RequestUploadFraming framing, GError ** error);
+void request_upload_set_text (SoupMessage * msg, gchar * text);
+SoupMultipart * request_upload_form_new (void);
+gboolean request_upload_form_append (SoupMultipart * form, const gchar * name, const gchar * value, const gchar * directory, GError ** error);
+void request_upload_set_form (SoupMessage * msg, SoupMultipart * form);
+
+G_END_DECLS
@@ -17,11 +17,15 @@
 
 #include <gtk-4.0/gtk/gtk.h>
 #include <libsoup/soup.h>
-#include <uriparser/Uri.h>
 
 #include "request-url-bar.h"
-
-#define RANGE(x)  (int) ((x).afterLast - (x).first)
+#include "request-session.h"
+#include "request-settings.h"
+#include "request-prewarm.h"
+#include "request-url.h"
+#include "request-transfer.h"
+#include "request-load-test-popover.h"
+#include "request-mock-server.h"
 
 typedef struct _RequestURLBarPrivate RequestURLBarPrivate;
 
@@ -32,6 +36,10 @@ struct _RequestURLBar {
     GtkComboBoxText * http_verb_selector;
     GtkEntry * url_bar;
     GtkButton * send_button;
+    GtkToggleButton * preconnect_button;
+    GtkMenuButton * load_test_button;
+    RequestLoadTestPopover * load_test_popover;
+    GtkMenuButton * menu_button;
 
     RequestURLBarPrivate * priv;
 };
@@ -41,9 +49,14 @@ struct _RequestURLBarClass {
 };
 
 struct _RequestURLBarPrivate {
-    gint64 request_start_time;
+    RequestTransfer * transfer;
+    gboolean is_started;
+    guint prewarm_source_id;
+    RequestMockServer * mock_server;
 };
 
+#define PREWARM_DELAY 400 // ms without typing before warming up the connection
+
 // G_DEFINE_TYPE(RequestURLBar, request_url_bar, GTK_TYPE_BOX);
 G_DEFINE_TYPE_WITH_CODE (RequestURLBar, request_url_bar, GTK_TYPE_BOX, G_ADD_PRIVATE (RequestURLBar));
 
@@ -58,121 +71,293 @@ static void request_url_bar_on_request_start (SoupMessage * msg, gpointer data)
 
     RequestURLBarPrivate * priv = request_url_bar_get_instance_private (self);
 
-    if (priv->request_start_time != ((gint64) 0)) {
+    // A message restarted by a redirect starts again, and a replaced message
+    // may still start before being aborted: only the first start of the
+    // current message counts.
+    if (priv->is_started || priv->transfer == NULL || msg != request_transfer_get_message (priv->transfer)) {
         return;
     }
 
-    priv->request_start_time = g_get_real_time ();
+    priv->is_started = TRUE;
 
     g_signal_emit_by_name (self, REQUEST_STARTED_SIGNAL, msg);
 }
 
-static void request_url_bar_on_request_end (SoupMessage * msg, gpointer data) {
-    (void) msg;
+static void request_url_bar_on_response_headers (RequestTransfer * transfer, gpointer data) {
     RequestURLBar * self = data;
     g_return_if_fail (self != NULL);
 
-    RequestURLBarPrivate * priv = request_url_bar_get_instance_private (self);
+    // Responses served from the HTTP cache never emit "starting"
+    request_url_bar_on_request_start (request_transfer_get_message (transfer), self);
 
-    priv->request_start_time = (gint64) 0;
+    request_prewarm_claim (request_transfer_get_message (transfer));
 
-    g_signal_emit_by_name (self, REQUEST_COMPLETED_SIGNAL, msg);
+    g_signal_emit_by_name (self, REQUEST_HEADERS_SIGNAL, request_transfer_get_message (transfer));
 }
 
-static void request_url_bar_on_request_submitted (GtkWidget * widget, gpointer data) {
-    (void) widget;
+static void request_url_bar_on_response_chunk (RequestTransfer * transfer, GBytes * chunk, gpointer data) {
+    RequestURLBar * self = data;
+    g_return_if_fail (self != NULL);
 
-    GtkEntryBuffer * entry_buffer;
-    gchar * verb = NULL;
-    gchar * url = NULL;
+    g_signal_emit_by_name (self, REQUEST_CHUNK_SIGNAL, request_transfer_get_message (transfer), chunk);
+}
 
+static void request_url_bar_on_request_end (RequestTransfer * transfer, gpointer data) {
     RequestURLBar * self = data;
     g_return_if_fail (self != NULL);
 
-    entry_buffer = gtk_entry_get_buffer (self->url_bar);
+    RequestURLBarPrivate * priv = request_url_bar_get_instance_private (self);
+
+    const GError * error = request_transfer_get_error (transfer);
+    if (error != NULL) {
+        g_info ("Request failed: %s\n", error->message);
+    }
+
+    g_signal_emit_by_name (self, REQUEST_COMPLETED_SIGNAL, request_transfer_get_message (transfer));
+
+    if (priv->transfer == transfer) {
+        g_clear_object (&priv->transfer);
+        priv->is_started = FALSE;
+    }
+}
+
+/**
+ * Drops the request in flight without notifying the handlers of the bar.
+ */
+static void request_url_bar_abort (RequestURLBar * self) {
+    RequestURLBarPrivate * priv = request_url_bar_get_instance_private (self);
+
+    if (priv->transfer != NULL) {
+        g_signal_handlers_disconnect_by_data (priv->transfer, self);
+        request_transfer_cancel (priv->transfer);
+        g_clear_object (&priv->transfer);
+    }
+
+    priv->is_started = FALSE;
+}
+
+/**
+ * Returns the URL typed in the bar, prefixed with http:// when it has no
+ * scheme, or NULL when it is not a valid HTTP(S) URL. The bar is then marked
+ * as invalid, with the reason as tooltip.
+ */
+static gchar * request_url_bar_get_url (RequestURLBar * self) {
+    GtkEntryBuffer * entry_buffer = gtk_entry_get_buffer (self->url_bar);
     if (gtk_entry_buffer_get_length (entry_buffer) == 0)
-        return;
+        return NULL;
 
     const gchar * buffer_text = gtk_entry_buffer_get_text (entry_buffer);
     if (buffer_text == NULL)
-        return; // FIXME: Crash, this is not normal to have a buffer with a length, but not getting any text
+        return NULL; // FIXME: Crash, this is not normal to have a buffer with a length, but not getting any text
+
+    GError * error = NULL;
+    gchar * url = request_url_normalize (buffer_text, &error);
+    if (url == NULL) {
+        // Cleared as soon as the URL is edited
+        gtk_widget_add_css_class (GTK_WIDGET (self->url_bar), "error");
+        gtk_widget_set_tooltip_text (GTK_WIDGET (self->url_bar), error->message);
+        g_error_free (error);
+    }
 
-    url = g_strdup (buffer_text);
+    return url;
+}
 
-    // FIXME: Remove whitespace before and after URL
+static gchar * request_url_bar_get_verb (RequestURLBar * self) {
+    gchar * verb = gtk_combo_box_text_get_active_text (self->http_verb_selector);
+    if (verb == NULL || strlen (verb) == (size_t) 0) {
+        g_free (verb);
+        verb = g_strdup ("GET");
+    }
 
-    UriUriA uri;
-    const char * errorPos;
-    if (uriParseSingleUriA (&uri, url, &errorPos) != URI_SUCCESS) {
-        printf ("Error position: %s\n", errorPos);
-        return;
+    return verb;
+}
+
+/**
+ * Returns the message for the request in the bar, with its body attached by
+ * the REQUEST_PREPARE_SIGNAL handlers, or NULL when the URL is invalid or a
+ * handler aborted the request.
+ */
+static SoupMessage * request_url_bar_create_message (RequestURLBar * self) {
+    gchar * url = request_url_bar_get_url (self);
+    if (url == NULL)
+        return NULL;
+
+    gchar * verb = request_url_bar_get_verb (self);
+    SoupMessage * message = soup_message_new (verb, url);
+
+    g_free (verb);
+    g_free (url);
+
+    // Lets the body be attached, a handler returning TRUE aborts the request
+    gboolean is_aborted = FALSE;
+    g_signal_emit_by_name (self, REQUEST_PREPARE_SIGNAL, message, &is_aborted);
+    if (is_aborted) {
+        g_object_unref (message);
+        return NULL;
     }
 
-    gchar * scheme;
-    if (RANGE (uri.scheme) == '\0') { // FIXME: prefixing with only "//"" or "/"" will result in an invalid URL.
-        g_info ("No scheme found, autoprefixing with http.\n");
+    return message;
+}
 
-        const char * prefix = "http://";
-        gchar * prefixed_url = g_strconcat (prefix, url, NULL);
+static void request_url_bar_on_request_submitted (GtkWidget * widget, gpointer data) {
+    (void) widget;
 
-        g_free (url);
-        url = prefixed_url;
-        scheme = "http"; // FIXME: Use an Enum or a const
-    } else {
-        gchar extracted_scheme[RANGE (uri.scheme) + 1];
-        memcpy (extracted_scheme, url, RANGE (uri.scheme));
-        extracted_scheme[RANGE (uri.scheme)] = '\0';
+    RequestURLBar * self = data;
+    g_return_if_fail (self != NULL);
+
+    SoupMessage * message = request_url_bar_create_message (self);
+    if (message == NULL)
+        return;
+
+    SoupSession * session = request_session_get_default ();
+
+    g_signal_connect_object (message, "starting", G_CALLBACK (request_url_bar_on_request_start), self, 0);
+
+    RequestURLBarPrivate * priv = request_url_bar_get_instance_private (self);
+
+    // Only one response can be shown at a time per bar, abort the previous one
+    // so its chunks don't get mixed with the new response. Requests of other
+    // tabs have their own bar and keep running.
+    request_url_bar_abort (self);
+
+    priv->transfer = request_transfer_new (session, message);
+    g_object_unref (message);
 
-        scheme = extracted_scheme;
+    g_signal_connect_object (priv->transfer, TRANSFER_HEADERS_SIGNAL, G_CALLBACK (request_url_bar_on_response_headers), self, 0);
+    g_signal_connect_object (priv->transfer, TRANSFER_CHUNK_SIGNAL, G_CALLBACK (request_url_bar_on_response_chunk), self, 0);
+    g_signal_connect_object (priv->transfer, TRANSFER_COMPLETED_SIGNAL, G_CALLBACK (request_url_bar_on_request_end), self, 0);
 
-        // printf("Extracted: %s\n", extracted_scheme);
-        printf ("Detected Scheme: %s\n", scheme); // FIXME: Why in hell is scheme empty outside of condition when we don't print it first???
+    request_transfer_start (priv->transfer);
+}
+
+static gboolean request_url_bar_prewarm (gpointer data) {
+    RequestURLBar * self = data;
+    RequestURLBarPrivate * priv = request_url_bar_get_instance_private (self);
+
+    priv->prewarm_source_id = 0;
+
+    const gchar * text = gtk_editable_get_text (GTK_EDITABLE (self->url_bar));
+    gchar * url = request_url_normalize (text, NULL); // Errors are expected while typing
+    if (url != NULL) {
+        request_prewarm_url (request_session_get_default (), url, gtk_toggle_button_get_active (self->preconnect_button));
+        g_free (url);
     }
 
-    if (strcmp (scheme, "http") != 0 && strcmp (scheme, "https") != 0) {
-        printf ("Invalid scheme: %s\n", scheme);
-        // TODO: Return error to the view
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * Warms up the connection once the user stopped typing for a while, so that
+ * each keystroke does not trigger a lookup.
+ */
+static void request_url_bar_on_url_changed (GtkEditable * editable, gpointer data) {
+    (void) editable;
+    RequestURLBar * self = data;
+    g_return_if_fail (self != NULL);
+
+    RequestURLBarPrivate * priv = request_url_bar_get_instance_private (self);
+
+    gtk_widget_remove_css_class (GTK_WIDGET (self->url_bar), "error");
+    gtk_widget_set_tooltip_text (GTK_WIDGET (self->url_bar), NULL);
+
+    g_clear_handle_id (&priv->prewarm_source_id, g_source_remove);
+    priv->prewarm_source_id = g_timeout_add (PREWARM_DELAY, request_url_bar_prewarm, self);
+}
+
+static void request_url_bar_on_load_test_requested (RequestLoadTestPopover * popover, gpointer data) {
+    RequestURLBar * self = data;
+    g_return_if_fail (self != NULL);
+
+    // Every request of the test is a copy of this one, body included
+    SoupMessage * message = request_url_bar_create_message (self);
+    if (message == NULL)
+        return;
+
+    request_load_test_popover_run (popover, message);
+    g_object_unref (message);
+}
+
+/**
+ * Starts or stops the local mock server. Once started, its URL is put in the
+ * bar when the bar is empty.
+ */
+static void request_url_bar_on_mock_server_changed (GSimpleAction * action, GVariant * state, gpointer data) {
+    RequestURLBar * self = data;
+    g_return_if_fail (self != NULL);
+
+    RequestURLBarPrivate * priv = request_url_bar_get_instance_private (self);
+
+    if (!g_variant_get_boolean (state)) {
+        request_mock_server_stop (priv->mock_server);
+        g_simple_action_set_state (action, state);
         return;
     }
 
-    verb = gtk_combo_box_text_get_active_text (self->http_verb_selector);
-    if (strlen (verb) == (size_t) 0)
-        verb = "GET";
+    GError * error = NULL;
+    request_mock_server_set_latency (priv->mock_server, (guint) MAX (request_settings_get_int ("mock-latency", 0), 0));
+    request_mock_server_set_bandwidth (priv->mock_server, (guint64) MAX (request_settings_get_int ("mock-bandwidth", 0), 0) * 1024);
 
-    SoupURI * request_uri = soup_uri_new (url);
-    if (!SOUP_URI_VALID_FOR_HTTP (request_uri)) {
-        printf ("Invalid URI\n");
-        // TODO: Return error to the view
+    if (!request_mock_server_start (priv->mock_server, 0, &error)) {
+        g_warning ("Could not start the mock server: %s", error->message);
+        g_error_free (error);
         return;
     }
 
-    SoupSession * session = soup_session_new (); // FIXME: Make me available in the struct
-    SoupMessage * message = soup_message_new (verb, url);
+    g_simple_action_set_state (action, state);
 
-    SoupLogger * logger = soup_logger_new (SOUP_LOGGER_LOG_HEADERS, -1); // FIXME: Init logger at widget init
-    soup_session_add_feature (session, SOUP_SESSION_FEATURE (logger));
-    g_object_unref (logger);
+    if (gtk_entry_buffer_get_length (gtk_entry_get_buffer (self->url_bar)) == 0) {
+        gtk_editable_set_text (GTK_EDITABLE (self->url_bar), request_mock_server_get_url (priv->mock_server));
+    }
+}
 
-    g_signal_connect_object (message, "starting", G_CALLBACK (request_url_bar_on_request_start), self, 0);
-    g_signal_connect_object (message, "finished", G_CALLBACK (request_url_bar_on_request_end), self, 0);
+/**
+ * Aborts the request in flight, if any. It completes right away with a
+ * cancellation error and its resources are released.
+ */
+void request_url_bar_cancel (RequestURLBar * self) {
+    g_return_if_fail (REQUEST_IS_URL_BAR (self));
 
-    soup_session_queue_message (session, message, NULL, NULL);
+    RequestURLBarPrivate * priv = request_url_bar_get_instance_private (self);
+    if (priv->transfer != NULL) {
+        request_transfer_cancel (priv->transfer);
+    }
+}
 
-    uriFreeUriMembersA (&uri);
-    g_free (verb);
-    g_free (url);
+static void request_url_bar_dispose (GObject * object) {
+    RequestURLBar * self = REQUEST_URL_BAR (object);
+    RequestURLBarPrivate * priv = request_url_bar_get_instance_private (self);
+
+    g_clear_handle_id (&priv->prewarm_source_id, g_source_remove);
+    g_clear_object (&priv->mock_server);
+
+    // The tab of the bar was closed
+    request_url_bar_abort (self);
+
+    G_OBJECT_CLASS (request_url_bar_parent_class)->dispose (object);
 }
 
 static void request_url_bar_class_init (RequestURLBarClass * klass) {
+    GObjectClass * object_class = G_OBJECT_CLASS (klass);
     GtkWidgetClass * widget_class = GTK_WIDGET_CLASS (klass);
 
+    object_class->dispose = request_url_bar_dispose;
+
+    g_type_ensure (REQUEST_TYPE_LOAD_TEST_POPOVER); // ensure popover type is known before instanciating the template
+
     gtk_widget_class_set_template_from_resource (widget_class, "/com/github/guillotjulien/request/resources/ui/request-url-bar.ui");
     gtk_widget_class_bind_template_child (widget_class, RequestURLBar, http_verb_selector);
     gtk_widget_class_bind_template_child (widget_class, RequestURLBar, url_bar);
     gtk_widget_class_bind_template_child (widget_class, RequestURLBar, send_button);
+    gtk_widget_class_bind_template_child (widget_class, RequestURLBar, preconnect_button);
+    gtk_widget_class_bind_template_child (widget_class, RequestURLBar, load_test_button);
+    gtk_widget_class_bind_template_child (widget_class, RequestURLBar, load_test_popover);
+    gtk_widget_class_bind_template_child (widget_class, RequestURLBar, menu_button);
 
     // Declare our own signals
+    g_signal_new (REQUEST_PREPARE_SIGNAL, REQUEST_TYPE_URL_BAR, G_SIGNAL_RUN_LAST, 0, g_signal_accumulator_true_handled, NULL, NULL, G_TYPE_BOOLEAN, 1, soup_message_get_type ());
     g_signal_new (REQUEST_STARTED_SIGNAL, REQUEST_TYPE_URL_BAR, G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT, G_TYPE_NONE, 1, soup_message_get_type ());
+    g_signal_new (REQUEST_HEADERS_SIGNAL, REQUEST_TYPE_URL_BAR, G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT, G_TYPE_NONE, 1, soup_message_get_type ());
+    g_signal_new (REQUEST_CHUNK_SIGNAL, REQUEST_TYPE_URL_BAR, G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 2, soup_message_get_type (), G_TYPE_BYTES);
     g_signal_new (REQUEST_COMPLETED_SIGNAL, REQUEST_TYPE_URL_BAR, G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT, G_TYPE_NONE, 1, soup_message_get_type ());
 }
 
@@ -183,8 +368,30 @@ static void request_url_bar_init (RequestURLBar * self) {
     g_return_if_fail (GTK_IS_WIDGET (self->http_verb_selector));
     g_return_if_fail (GTK_IS_WIDGET (self->url_bar));
     g_return_if_fail (GTK_IS_WIDGET (self->send_button));
+    g_return_if_fail (GTK_IS_WIDGET (self->preconnect_button));
+    g_return_if_fail (GTK_IS_WIDGET (self->load_test_button));
+    g_return_if_fail (GTK_IS_WIDGET (self->load_test_popover));
+    g_return_if_fail (GTK_IS_WIDGET (self->menu_button));
+
+    RequestURLBarPrivate * priv = request_url_bar_get_instance_private (self);
+    priv->mock_server = request_mock_server_new ();
+
+    // Actions of the menu
+    GSimpleActionGroup * actions = g_simple_action_group_new ();
+    GSimpleAction * mock_server_action = g_simple_action_new_stateful ("mock-server", NULL, g_variant_new_boolean (FALSE));
+
+    g_signal_connect (mock_server_action, "change-state", G_CALLBACK (request_url_bar_on_mock_server_changed), self);
+    g_action_map_add_action (G_ACTION_MAP (actions), G_ACTION (mock_server_action));
+    gtk_widget_insert_action_group (GTK_WIDGET (self), "url-bar", G_ACTION_GROUP (actions));
+
+    g_object_unref (mock_server_action);
+    g_object_unref (actions);
+
+    request_settings_bind ("preconnect", self->preconnect_button, "active");
 
     // Connect widgets signals
     g_signal_connect (self->send_button, "clicked", G_CALLBACK (request_url_bar_on_request_submitted), self);
     g_signal_connect (self->url_bar, "activate", G_CALLBACK (request_url_bar_on_request_submitted), self);
+    g_signal_connect (self->url_bar, "changed", G_CALLBACK (request_url_bar_on_url_changed), self);
+    g_signal_connect (self->load_test_popover, LOAD_TEST_REQUESTED_SIGNAL, G_CALLBACK (request_url_bar_on_load_test_requested), self);
 }
@@ -25,9 +25,13 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (RequestURLBar, request_url_bar, REQUEST, URL_BAR, GtkBox)
 
+#define REQUEST_PREPARE_SIGNAL "request-prepare"
 #define REQUEST_STARTED_SIGNAL "request-started"
+#define REQUEST_HEADERS_SIGNAL "request-headers"
+#define REQUEST_CHUNK_SIGNAL "request-chunk"
 #define REQUEST_COMPLETED_SIGNAL "request-completed"
 
 RequestURLBar * request_url_bar_new (void);
+void request_url_bar_cancel (RequestURLBar * self);
 
 G_END_DECLS
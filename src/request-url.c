@@ -0,0 +1,87 @@
+/* request-url.c
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <libsoup/soup.h>
+#include <uriparser/Uri.h>
+#include <string.h>
+
+#include "request-url.h"
+
+#define RANGE(x)  (int) ((x).afterLast - (x).first)
+
+G_DEFINE_QUARK (request-url-error-quark, request_url_error)
+
+/**
+ * Returns text as an URL libsoup can send, prefixed with http:// when it has no
+ * scheme, or NULL when it is not a valid HTTP(S) URL.
+ *
+ * Shared by the URL bar and the headless runner, nothing here touches GTK.
+ */
+gchar * request_url_normalize (const gchar * text, GError ** error) {
+    g_return_val_if_fail (text != NULL, NULL);
+
+    gchar * url = g_strdup (text);
+
+    // FIXME: Remove whitespace before and after URL
+
+    UriUriA uri;
+    const char * errorPos;
+    if (uriParseSingleUriA (&uri, url, &errorPos) != URI_SUCCESS) {
+        g_set_error (error, REQUEST_URL_ERROR, REQUEST_URL_ERROR_INVALID, "Invalid URL at position %d", (int) (errorPos - url));
+        g_free (url);
+        return NULL;
+    }
+
+    gchar * scheme;
+    if (RANGE (uri.scheme) == '\0') { // FIXME: prefixing with only "//"" or "/"" will result in an invalid URL.
+        g_info ("No scheme found, autoprefixing with http.\n");
+
+        const char * prefix = "http://";
+        gchar * prefixed_url = g_strconcat (prefix, url, NULL);
+
+        g_free (url);
+        url = prefixed_url;
+        scheme = g_strdup ("http"); // FIXME: Use an Enum or a const
+    } else {
+        scheme = g_strndup (uri.scheme.first, RANGE (uri.scheme));
+    }
+
+    uriFreeUriMembersA (&uri);
+
+    if (strcmp (scheme, "http") != 0 && strcmp (scheme, "https") != 0) {
+        g_set_error (error, REQUEST_URL_ERROR, REQUEST_URL_ERROR_UNSUPPORTED_SCHEME, "Unsupported scheme: %s", scheme);
+        g_free (scheme);
+        g_free (url);
+        return NULL;
+    }
+
+    g_free (scheme);
+
+    SoupURI * request_uri = soup_uri_new (url);
+    gboolean is_valid = SOUP_URI_VALID_FOR_HTTP (request_uri);
+    if (request_uri != NULL) {
+        soup_uri_free (request_uri);
+    }
+
+    if (!is_valid) {
+        g_set_error (error, REQUEST_URL_ERROR, REQUEST_URL_ERROR_INVALID, "Invalid URL: %s", url);
+        g_free (url);
+        return NULL;
+    }
+
+    return url;
+}
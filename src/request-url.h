@@ -0,0 +1,34 @@
+/* request-url.h
+ *
+ * Copyright 2021 Julien Guillot
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define REQUEST_URL_ERROR (request_url_error_quark ())
+
+typedef enum RequestUrlError {
+    REQUEST_URL_ERROR_INVALID,
+    REQUEST_URL_ERROR_UNSUPPORTED_SCHEME,
+} RequestUrlError;
+
+GQuark request_url_error_quark (void);
+gchar * request_url_normalize (const gchar * text, GError ** error);
+
+G_END_DECLS
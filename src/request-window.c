@@ -16,145 +16,131 @@
  */
 
 #include <gtk-4.0/gdk/x11/gdkx.h>
-#include <libsoup/soup.h>
 
 #include "request-config.h"
 #include "request-window.h"
-#include "request-url-bar.h"
-#include "request-response-bar.h"
-#include "request-double-entry.h"
-#include "request-header-list.h"
-#include "request-response-panel.h"
-#include "request-source-view.h"
+#include "request-document.h"
 
 struct _RequestWindow {
     GtkApplicationWindow parent_instance;
 
     /* Template widgets */
-    GtkPaned * main_grid;
-    GtkWidget * loading_overlay;
-
-    /* Custom widgets */
-    RequestURLBar * request_url_bar;
-    RequestResponseBar * request_response_bar;
-    RequestResponsePanel * response_panel;
-    RequestHeaderList * response_header_list;
-    RequestSourceView * request_source_view;
-    RequestSourceView * response_source_view;
+    GtkNotebook * notebook;
 };
 
 G_DEFINE_TYPE (RequestWindow, request_window, GTK_TYPE_APPLICATION_WINDOW)
 
-static gchar * request_window_get_utf8_encoded_body_data (SoupMessage * msg) {
-    GError * conversion_error = NULL;
-    GMatchInfo * match_info = NULL;
+static void request_window_on_document_state_changed (RequestDocument * document, gpointer data) {
+    RequestWindow * self = data;
+    g_return_if_fail (self != NULL);
+
+    // spinner, title, close button
+    GtkWidget * tab_label = gtk_notebook_get_tab_label (self->notebook, GTK_WIDGET (document));
+    GtkWidget * spinner = gtk_widget_get_first_child (tab_label);
+    GtkWidget * title_label = gtk_widget_get_next_sibling (spinner);
+    gboolean is_loading = request_document_is_loading (document);
 
-    const gchar * content_type = soup_message_headers_get_one (msg->response_headers, "Content-Type");
-    const gchar * body_data = msg->response_body->data;
-    const gchar * pattern = "charset=(?<charset>.+)";
-    const GRegex * regex = g_regex_new (pattern, G_REGEX_CASELESS, G_REGEX_MATCH_NOTEMPTY, NULL);
+    gtk_spinner_set_spinning (GTK_SPINNER (spinner), is_loading);
+    gtk_widget_set_visible (spinner, is_loading);
+    gtk_label_set_text (GTK_LABEL (title_label), request_document_get_title (document));
+    gtk_widget_set_tooltip_text (title_label, request_document_get_title (document));
+}
 
-    gboolean match = g_regex_match (regex, content_type, G_REGEX_MATCH_NOTEMPTY, &match_info);
-    g_return_if_fail (match == TRUE);
+/**
+ * Closes the tab of document, aborting its request. The window always keeps
+ * a tab open.
+ */
+static void request_window_close_document (RequestWindow * self, GtkWidget * document) {
+    gint page = gtk_notebook_page_num (self->notebook, document);
+    g_return_if_fail (page >= 0);
 
-    const gchar * charset = g_match_info_fetch_named (match_info, "charset");
-    const gchar * encoded_text = g_convert (body_data, strlen (body_data), "UTF-8", charset, NULL, NULL, &conversion_error);
-    g_return_if_fail (conversion_error == 0x0);
+    request_document_cancel (REQUEST_DOCUMENT (document));
+    gtk_notebook_remove_page (self->notebook, page);
 
-    return (gchar *) encoded_text;
+    if (gtk_notebook_get_n_pages (self->notebook) == 0) {
+        request_window_add_document (self);
+    }
 }
 
-static void on_request_start (RequestWindow * sender, SoupMessage * msg, gpointer data) {
-    (void) sender; // We don't use sender directly as it doesn't contain a reference to the widgets of request_response_bar...
-    RequestWindow * self = data;
+static void request_window_on_close_clicked (GtkButton * button, gpointer data) {
+    RequestWindow * self = REQUEST_WINDOW (gtk_widget_get_root (GTK_WIDGET (button)));
 
-    g_return_if_fail (self != NULL);
-    g_return_if_fail (msg != NULL);
-    g_return_if_fail (SOUP_IS_MESSAGE (msg));
+    request_window_close_document (self, data);
+}
+
+static GtkWidget * request_window_create_tab_label (RequestDocument * document) {
+    GtkWidget * spinner = gtk_spinner_new ();
+    gtk_widget_set_visible (spinner, FALSE);
 
-    const gchar * text = request_source_view_get_text (self->request_source_view);
+    GtkWidget * title_label = gtk_label_new (request_document_get_title (document));
+    gtk_label_set_ellipsize (GTK_LABEL (title_label), PANGO_ELLIPSIZE_MIDDLE);
+    gtk_label_set_max_width_chars (GTK_LABEL (title_label), 24);
+    gtk_widget_set_hexpand (title_label, TRUE);
 
-    printf ("Text: %s\n", text);
+    GtkWidget * close_button = gtk_button_new_from_icon_name ("window-close-symbolic");
+    gtk_button_set_has_frame (GTK_BUTTON (close_button), FALSE);
+    gtk_widget_set_tooltip_text (close_button, "Close the tab"); // FIXME: Handle translations
+    g_signal_connect (close_button, "clicked", G_CALLBACK (request_window_on_close_clicked), document);
 
-    gtk_widget_set_opacity (self->loading_overlay, 1);
-    gtk_widget_set_can_target (self->loading_overlay, TRUE);
-    request_response_bar_on_message_begin (msg, self->request_response_bar);
+    GtkWidget * box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_box_append (GTK_BOX (box), spinner);
+    gtk_box_append (GTK_BOX (box), title_label);
+    gtk_box_append (GTK_BOX (box), close_button);
+
+    return box;
 }
 
-static void on_request_complete (RequestWindow * sender, SoupMessage * msg, gpointer data) {
-    (void) sender; // We don't use sender directly as it doesn't contain a reference to the widgets of request_response_bar...
-    RequestWindow * self = data;
+/**
+ * Opens a new tab with an empty request and switches to it.
+ */
+RequestDocument * request_window_add_document (RequestWindow * self) {
+    g_return_val_if_fail (REQUEST_IS_WINDOW (self), NULL);
 
-    g_return_if_fail (self != NULL);
-    g_return_if_fail (msg != NULL);
-    g_return_if_fail (SOUP_IS_MESSAGE (msg));
-    g_return_if_fail (GTK_IS_WIDGET (self->request_response_bar));
-
-    gtk_widget_set_opacity (self->loading_overlay, 0);
-    gtk_widget_set_can_target (self->loading_overlay, FALSE);
-    request_response_bar_on_message_received (msg, self->request_response_bar);
-
-    SoupMessageHeadersIter iter;
-    soup_message_headers_iter_init (&iter, msg->response_headers);
-
-    GSList * l = NULL;
-    const char * header_name;
-    const char * header_value;
-    while (soup_message_headers_iter_next (&iter, &header_name, &header_value)) {
-        RequestHeaderListRow * row = request_header_list_row_new (self->response_header_list, (gchar *) header_name, (gchar *) header_value, TRUE);
-        l = g_slist_append (l, row);
-    }
+    RequestDocument * document = request_document_new ();
+    GtkWidget * tab_label = request_window_create_tab_label (document);
 
-    request_response_panel_set_headers (self->response_panel, l);
+    gint page = gtk_notebook_append_page (self->notebook, GTK_WIDGET (document), tab_label);
+    gtk_notebook_set_tab_reorderable (self->notebook, GTK_WIDGET (document), TRUE);
+    gtk_notebook_set_current_page (self->notebook, page);
 
-    const gchar * body_data = request_window_get_utf8_encoded_body_data (msg);
-    g_return_if_fail (body_data != NULL);
+    g_signal_connect (document, DOCUMENT_STATE_CHANGED_SIGNAL, G_CALLBACK (request_window_on_document_state_changed), self);
 
-    request_source_view_set_text (self->response_source_view, (gchar *) body_data);
+    return document;
 }
 
-static GtkWidget * request_window_build_overlay () {
-    GtkWidget * loading_overlay = gtk_overlay_new ();
-    gtk_widget_set_hexpand (loading_overlay, TRUE);
-    gtk_widget_set_vexpand (loading_overlay, TRUE);
-    gtk_widget_set_halign (loading_overlay, GTK_ALIGN_FILL);
-    gtk_widget_set_valign (loading_overlay, GTK_ALIGN_FILL);
-    gtk_widget_set_opacity (loading_overlay, 0);
-    gtk_widget_set_can_target (loading_overlay, FALSE);
+static void request_window_on_new_clicked (GtkButton * button, gpointer data) {
+    (void) button;
 
-    GtkWidget * overlay_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 25);
-    gtk_widget_set_halign (overlay_box, GTK_ALIGN_CENTER);
-    gtk_widget_set_valign (overlay_box, GTK_ALIGN_CENTER);
+    request_window_add_document (data);
+}
 
-    gtk_overlay_set_child (GTK_OVERLAY (loading_overlay), overlay_box);
+static gboolean request_window_on_new_shortcut (GtkWidget * widget, GVariant * args, gpointer data) {
+    (void) widget;
+    (void) args;
 
-    GtkWidget * spinner = gtk_spinner_new ();
-    gtk_widget_set_size_request (spinner, 100, 100);
-    gtk_widget_set_halign (spinner, GTK_ALIGN_CENTER);
-    gtk_widget_set_valign (spinner, GTK_ALIGN_CENTER);
-    gtk_spinner_set_spinning (GTK_SPINNER (spinner), TRUE);
+    request_window_add_document (data);
 
-    GtkWidget * cancel = gtk_button_new ();
-    gtk_widget_set_halign (cancel, GTK_ALIGN_CENTER);
-    gtk_widget_set_valign (cancel, GTK_ALIGN_CENTER);
-    gtk_widget_set_hexpand (cancel, FALSE);
-    gtk_widget_set_vexpand (cancel, FALSE);
-    gtk_button_set_label (GTK_BUTTON (cancel), "Cancel Request");
+    return TRUE;
+}
 
-    GtkStyleContext * context = gtk_widget_get_style_context (cancel);
-    gtk_style_context_add_class (context, "flat");
+static gboolean request_window_on_close_shortcut (GtkWidget * widget, GVariant * args, gpointer data) {
+    (void) widget;
+    (void) args;
+    RequestWindow * self = data;
 
-    gtk_box_append (GTK_BOX (overlay_box), spinner);
-    gtk_box_append (GTK_BOX (overlay_box), cancel);
+    gint page = gtk_notebook_get_current_page (self->notebook);
+    if (page >= 0) {
+        request_window_close_document (self, gtk_notebook_get_nth_page (self->notebook, page));
+    }
 
-    return loading_overlay;
+    return TRUE;
 }
 
 static void request_window_class_init (RequestWindowClass * klass) {
     GtkWidgetClass * widget_class = GTK_WIDGET_CLASS (klass);
 
     gtk_widget_class_set_template_from_resource (widget_class, "/com/github/guillotjulien/request/resources/ui/window.ui");
-    gtk_widget_class_bind_template_child (widget_class, RequestWindow, main_grid);
+    gtk_widget_class_bind_template_child (widget_class, RequestWindow, notebook);
 }
 
 static void request_window_init (RequestWindow * self) {
@@ -164,62 +150,22 @@ static void request_window_init (RequestWindow * self) {
 
     gtk_widget_init_template (GTK_WIDGET (self));
 
-    request_window_set_paned_view_size (self);
-
-    GtkWidget * left = gtk_grid_new ();
-    GtkWidget * right = gtk_grid_new ();
-
-    gtk_paned_set_start_child (self->main_grid, left);
-    gtk_paned_set_end_child (self->main_grid, right);
-
-    // Prevent widgets in paned view from shrinking too much
-    gtk_paned_set_shrink_start_child (self->main_grid, FALSE);
-    gtk_paned_set_shrink_end_child (self->main_grid, FALSE);
-
-    /* BUILD LEFT PANEL */
-
-    self->request_url_bar = request_url_bar_new ();
-    g_return_if_fail (self->request_url_bar != NULL);
-
-    gtk_grid_attach (GTK_GRID (left), GTK_WIDGET (self->request_url_bar), 0, 0, 1, 1);
-
-    g_signal_connect (self->request_url_bar, REQUEST_STARTED_SIGNAL, G_CALLBACK (on_request_start), self);
-    g_signal_connect (self->request_url_bar, REQUEST_COMPLETED_SIGNAL, G_CALLBACK (on_request_complete), self);
-
-    /* BUILD RIGHT PANEL */
-
-    self->request_response_bar = request_response_bar_new ();
-    g_return_if_fail (self->request_response_bar != NULL);
-
-    gtk_grid_attach (GTK_GRID (right), GTK_WIDGET (self->request_response_bar), 0, 0, 1, 1);
-
-    self->response_panel = request_response_panel_new ();
-    g_return_if_fail (self->response_panel != NULL);
-
-    self->response_header_list = request_response_panel_get_header_list_view (self->response_panel);
-    g_return_if_fail (self->response_header_list != NULL);
-
-    self->response_source_view = request_response_panel_get_source_view (self->response_panel);
-    g_return_if_fail (self->response_source_view != NULL);
-
-    gtk_grid_attach (GTK_GRID (right), request_response_panel_get_view (self->response_panel), 0, 1, 1, 1);
-
-    self->loading_overlay = request_window_build_overlay ();
-    g_return_if_fail (self->loading_overlay != NULL);
-
-    gtk_grid_attach (GTK_GRID (right), self->loading_overlay, 0, 0, 1, 2);
-
-    self->request_source_view = request_source_view_new (FALSE);
-    g_return_if_fail (self->request_source_view != NULL);
-
-    gtk_grid_attach (GTK_GRID (left), GTK_WIDGET (self->request_source_view), 0, 1, 1, 1);
-}
-
-void request_window_set_paned_view_size (RequestWindow * self) {
-    (void) self; // avoid unused parameter warning
-
-    // If we don't have a stored position for our panels, we set it to 50% of the current window size,
-    // else, we set it to the previously known position.
-
-    // TODO: Implement me
+    // Every tab sends its own requests, slow ones don't hold the others
+    GtkWidget * new_button = gtk_button_new_from_icon_name ("tab-new-symbolic");
+    gtk_button_set_has_frame (GTK_BUTTON (new_button), FALSE);
+    gtk_widget_set_tooltip_text (new_button, "New tab"); // FIXME: Handle translations
+    gtk_notebook_set_action_widget (self->notebook, new_button, GTK_PACK_END);
+    g_signal_connect (new_button, "clicked", G_CALLBACK (request_window_on_new_clicked), self);
+
+    GtkEventController * shortcuts = gtk_shortcut_controller_new ();
+    gtk_shortcut_controller_set_scope (GTK_SHORTCUT_CONTROLLER (shortcuts), GTK_SHORTCUT_SCOPE_GLOBAL);
+    gtk_shortcut_controller_add_shortcut (GTK_SHORTCUT_CONTROLLER (shortcuts),
+                                          gtk_shortcut_new (gtk_shortcut_trigger_parse_string ("<Control>t"),
+                                                            gtk_callback_action_new (request_window_on_new_shortcut, self, NULL)));
+    gtk_shortcut_controller_add_shortcut (GTK_SHORTCUT_CONTROLLER (shortcuts),
+                                          gtk_shortcut_new (gtk_shortcut_trigger_parse_string ("<Control>w"),
+                                                            gtk_callback_action_new (request_window_on_close_shortcut, self, NULL)));
+    gtk_widget_add_controller (GTK_WIDGET (self), shortcuts);
+
+    request_window_add_document (self);
 }
@@ -19,6 +19,8 @@
 
 #include <gtk-4.0/gtk/gtk.h>
 
+#include "request-document.h"
+
 G_BEGIN_DECLS
 
 #define REQUEST_TYPE_WINDOW (request_window_get_type ())
@@ -26,6 +28,6 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (RequestWindow, request_window, REQUEST, WINDOW, GtkApplicationWindow)
 
 void request_window_on_activate (GtkWidget * widget, gpointer user_data);
-void request_window_set_paned_view_size (RequestWindow * self);
+RequestDocument * request_window_add_document (RequestWindow * self);
 
 G_END_DECLS